@@ -12,6 +12,9 @@ Major fixes:
 8. Fixed game flow and turn management
 9. Added missing boundary checks
 10. Improved user input validation
+
+The rules themselves live in azul_rules.c, this file only handles the
+terminal: printing the boards and asking the players for their moves.
 */
 
 #include <stdio.h>
@@ -20,205 +23,86 @@ Major fixes:
 #include <time.h>
 #include <errno.h>
 #include <string.h>
-
-#define ALL_TILES 100
-#define SAME_COLOR_TILES 20
-#define HOW_MANY_TILES_TYPES 5
-#define HOW_MANY_TILES_ON_FACTORY 4
-#define MAX_NUMBER_OF_FACTORIES 9
-#define MAX_PLAYERS 4
-#define MAX_PLAYER_NAME 10
-#define MAX_PENALTIES 7
-#define BLUE 0
-#define RED 1
-#define BLACK 2
-#define YELLOW 3
-#define WHITE 4
-#define AVAILABLE -1
-#define BLOCKED -2
-
-/*
-    Color indices:
-    - 0 = BLUE
-    - 1 = RED
-    - 2 = BLACK
-    - 3 = YELLOW
-    - 4 = WHITE
-*/
-
-typedef struct
-{
-    unsigned int all_tiles[5];
-}Bag;
-
-typedef struct 
-{
-    int portugese_wall[5][5];
-    int pattern_lines[5][5];
-    unsigned int score;
-    int penalties[7];
-}Mat;
+#include <unistd.h>
+
+#include "azul_rules.h"
+#include "azul_archive.h"
+#include "azul_book.h"
+#include "azul_endgame.h"
+#include "azul_eval.h"
+#include "azul_input.h"
+#include "azul_lockstep.h"
+#include "azul_log.h"
+#include "azul_mcts.h"
+#include "azul_net.h"
+#include "azul_notation.h"
+#include "azul_render.h"
+#include "azul_selfplay.h"
+#include "azul_server.h"
+
+// Seat played from the keyboard, the other seats hold a bot type
+#define SEAT_HUMAN -1
+// Answer of a move question that was a whole move in game notation
+#define TYPED_MOVE -3
+
+#define FORMAT_TEXT 0
+#define FORMAT_CSV 1
+#define FORMAT_JSON 2
 
 typedef struct
 {
-    int all_factories[MAX_NUMBER_OF_FACTORIES][HOW_MANY_TILES_ON_FACTORY];
-}Factory_display;
-
-typedef struct
-{
-    int all_tiles[HOW_MANY_TILES_TYPES];
-    unsigned int is_token_present;    
-}Middle_pile;
-
-typedef struct 
-{
-    Mat mat;
-    unsigned int is_token_present;
-    char player_name[MAX_PLAYER_NAME];
-}Player;
-
-typedef struct 
-{
-    int availiability_of_pattern_lines[MAX_PLAYERS][HOW_MANY_TILES_TYPES];
-    int check_mid_pile_availiability;
-    int player_on_move;
-    int selected_tile;
-    int same_tile_type_on_factory;
-    int selected_factory;
-    int player_order[MAX_PLAYERS];
-    int selected_pattern_line;
-    int MidPile_or_factory_selector;
-    int selections_until_round_finish;
-}Gameflow;
-
-typedef struct 
-{
-    Bag bag;
-    Middle_pile middle_pile;
-    Player players[MAX_PLAYERS];
-    int no_of_players;
-    Factory_display factory_displays;
-    int no_of_factory_displays;
-    Gameflow flow;
-}Game;
-
-void fill_the_bag(Bag* bag)
-{
-    for(int idx = 0; idx < HOW_MANY_TILES_TYPES; idx++)
-    {
-        bag->all_tiles[idx] = SAME_COLOR_TILES;
-    }
-}
+    int no_of_players;                          // 0 = ask
+    int seats[MAX_PLAYERS];
+    int no_of_seats;                            // 0 = ask which seats are computers
+    char names[MAX_PLAYERS][MAX_PLAYER_NAME];
+    int no_of_names;                            // 0 = ask
+    long no_of_games;
+    int no_of_threads;                          // 0 = all cores
+    int format;
+    int is_batch;                               // every seat is a bot
+    uint64_t seed;
+    const char* archive_path;                   // batch games are appended here
+    const char* replay_path;                    // archive to check by replaying
+    const char* notation_path;                  // notation to check by replaying
+    const char* convert_path;                   // archive to print as notation
+    const char* record_path;                    // notation of the interactive game
+    int is_lockstep;                            // play the batch in lockstep blocks
+    const char* serve_address;                  // host games for network clients
+    double endgame_seconds;                     // time of the search seats' endgame solver
+}Options;
+
+// Full labels with their colors, built once instead of per call
+static const char* const tile_cover_labels[HOW_MANY_TILES_TYPES] = {
+    "\x1b[44m\x1b[97m[blue]\x1b[0m",   // White text on blue background
+    "\x1b[41m\x1b[97m[red]\x1b[0m",    // White text on red background
+    "\x1b[40m\x1b[97m[black]\x1b[0m",  // White text on black background (visible!)
+    "\x1b[43m\x1b[30m[yellow]\x1b[0m", // Black text on yellow background
+    "\x1b[47m\x1b[30m[white]\x1b[0m"   // Black text on white background
+};
+
+static const char* const tile_labels[HOW_MANY_TILES_TYPES] = {
+    "\x1b[34m\x1b[1m[BLUE]\x1b[0m",   // Bold blue text
+    "\x1b[31m\x1b[1m[RED]\x1b[0m",    // Bold red text
+    "\x1b[90m\x1b[1m[BLACK]\x1b[0m",  // Bold gray text (visible on black terminals!)
+    "\x1b[33m\x1b[1m[YELLOW]\x1b[0m", // Bold yellow text
+    "\x1b[37m\x1b[1m[WHITE]\x1b[0m"   // Bold white text
+};
 
 void print_tile_cover(int tileType){
-    const char* colors[HOW_MANY_TILES_TYPES] = {
-        "\x1b[44m\x1b[97m", // Blue - White text on blue background
-        "\x1b[41m\x1b[97m", // Red - White text on red background
-        "\x1b[40m\x1b[97m", // Black - White text on black background (visible!)
-        "\x1b[43m\x1b[30m", // Yellow - Black text on yellow background
-        "\x1b[47m\x1b[30m"  // White - Black text on white background
-    };
-    
     if(tileType >= 0 && tileType < HOW_MANY_TILES_TYPES){
-        if(tileType == 0){
-            printf("%s[blue]\x1b[0m", colors[tileType]); 
-        }
-        else if(tileType == 1){
-            printf("%s[red]\x1b[0m", colors[tileType]); 
-        }
-        else if(tileType == 2){
-            printf("%s[black]\x1b[0m", colors[tileType]); 
-        }
-        else if(tileType == 3){
-            printf("%s[yellow]\x1b[0m", colors[tileType]); 
-        }
-        else{
-            printf("%s[white]\x1b[0m", colors[tileType]); 
-        }
+        fputs(tile_cover_labels[tileType], stdout);
     }
     else{
-        printf("   ");
+        fputs("   ", stdout);
     }
 }
 
 void print_tile(int tileType){
-    const char* colors[HOW_MANY_TILES_TYPES] = {
-        "\x1b[34m\x1b[1m", // Blue - Bold blue text
-        "\x1b[31m\x1b[1m", // Red - Bold red text
-        "\x1b[90m\x1b[1m", // Black - Bold gray text (visible on black terminals!)
-        "\x1b[33m\x1b[1m", // Yellow - Bold yellow text
-        "\x1b[37m\x1b[1m"  // White - Bold white text
-    };
-    
     if(tileType >= 0 && tileType < HOW_MANY_TILES_TYPES){
-        if(tileType == 0){
-            printf("%s[BLUE]\x1b[0m", colors[tileType]); 
-        }
-        else if(tileType == 1){
-            printf("%s[RED]\x1b[0m", colors[tileType]); 
-        }
-        else if(tileType == 2){
-            printf("%s[BLACK]\x1b[0m", colors[tileType]); 
-        }
-        else if(tileType == 3){
-            printf("%s[YELLOW]\x1b[0m", colors[tileType]); 
-        }
-        else{
-            printf("%s[WHITE]\x1b[0m", colors[tileType]); 
-        }
+        fputs(tile_labels[tileType], stdout);
     }
     else{
-        printf("     ");
-    }
-}
-
-// Helper function to get the tile color at a specific Portuguese wall position
-int get_portugese_wall_color(int row, int col)
-{
-    // The Portuguese wall has a fixed pattern that rotates
-    // Each row shifts the pattern by one position
-    int pattern[5] = {BLUE, YELLOW, RED, BLACK, WHITE};
-    return pattern[(col - row + 5) % 5];
-}
-
-void initialise_mat(Game* info)
-{
-    for(int p = 0; p < info->no_of_players; p++)
-    {
-        // Initialize pattern lines
-        for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
-        {
-            for(int j = 0; j < HOW_MANY_TILES_TYPES; j++)
-            {
-                if(i + j >= HOW_MANY_TILES_TYPES - 1)
-                {
-                    info->players[p].mat.pattern_lines[i][j] = AVAILABLE;
-                }
-                else
-                {
-                    info->players[p].mat.pattern_lines[i][j] = BLOCKED;
-                }
-            }
-        }
-        
-        // Initialize Portuguese wall
-        for(int i = 0; i < 5; i++)
-        {
-            for(int j = 0; j < 5; j++)
-            {
-                info->players[p].mat.portugese_wall[i][j] = AVAILABLE;
-            }
-        }
-        
-        // Initialize floor line (FIXED: was using unsigned, now int)
-        for(int i = 0; i < MAX_PENALTIES; i++)
-        {
-            info->players[p].mat.penalties[i] = AVAILABLE;
-        }
-        
-        // Initialize score
-        info->players[p].mat.score = 0;
-        info->players[p].is_token_present = 0;
+        fputs("     ", stdout);
     }
 }
 
@@ -235,7 +119,7 @@ void print_players_boards(Game* info)
                 int expected_color = get_portugese_wall_color(i, j);
                 
                 // FIXED: Use if-else chain instead of multiple ifs
-                if(info->players[p].mat.portugese_wall[i][j] == BLOCKED)
+                if(info->players[p].mat.portugese_wall & WALL_BIT(i, j))
                 {
                     // Tile is placed
                     print_tile_cover(expected_color);
@@ -294,79 +178,8 @@ void print_players_boards(Game* info)
     }
 }
 
-void is_bag_empty(Game* info)
-{
-    int cnt = 0;
-    for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
-    {
-        if(info->bag.all_tiles[i] == 0)
-        {
-            cnt++;
-        }
-    }
-    if(cnt == HOW_MANY_TILES_TYPES)
-    {
-        printf("WARNING: Bag is empty! Game should end or refill from discard.\n");
-        // In real game, you'd refill from box lid (discard pile)
-    }
-}
-
-void set_the_no_of_factories(Game* info)
-{
-    if(info->no_of_players == 2)
-    {
-        info->no_of_factory_displays = 5;
-    }
-    else if(info->no_of_players == 3)
-    {
-        info->no_of_factory_displays = 7;
-    }
-    else if(info->no_of_players == 4)
-    {
-        info->no_of_factory_displays = 9;
-    }
-}
-
-void initialise_factory_displays(Game* info)
-{
-    for(int i = 0; i < info->no_of_factory_displays; i++)
-    {
-        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
-        {
-            info->factory_displays.all_factories[i][j] = AVAILABLE;
-        }
-    }
-}
-
-void amplasete_tiles_on_a_factory(Game* info)
+void print_filled_factories(Game* info)
 {
-    int random_tile_idx = 0;
-    for(int i = 0; i < info->no_of_factory_displays; i++)
-    {
-        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
-        {
-            random_tile_idx = rand() % HOW_MANY_TILES_TYPES;
-            is_bag_empty(info);
-            
-            // FIXED: Better handling when bag is low
-            int attempts = 0;
-            while(info->bag.all_tiles[random_tile_idx] == 0 && attempts < 100)
-            {
-                random_tile_idx = rand() % HOW_MANY_TILES_TYPES;
-                attempts++;
-            }
-            
-            if(attempts >= 100)
-            {
-                printf("Error: Cannot fill factories, bag is empty!\n");
-                return;
-            }
-        
-            info->bag.all_tiles[random_tile_idx]--;
-            info->factory_displays.all_factories[i][j] = random_tile_idx;
-        }
-    }
-    
     printf("ALL %d FACTORIES ARE FILLED\n", info->no_of_factory_displays);
     printf("\n\n");
     for(int fct = 0; fct < info->no_of_factory_displays; fct++)
@@ -382,23 +195,6 @@ void amplasete_tiles_on_a_factory(Game* info)
     printf("\n\n");
 }
 
-int check_factories(Game* info)
-{
-    int cnt = 0;
-    for(int i = 0; i < info->no_of_factory_displays; i++)
-    {
-        if(info->factory_displays.all_factories[i][0] == BLOCKED)
-        {
-            cnt++;
-        }
-    }
-    if(cnt == info->no_of_factory_displays)
-    {
-        return 1;
-    }
-    return 0;
-}
-
 void print_chosen_factory(Game* info, int no_of_factory)
 {
     printf("You chose Factory: %d\n", no_of_factory + 1);
@@ -410,15 +206,6 @@ void print_chosen_factory(Game* info, int no_of_factory)
     printf("\n");
 }
 
-void initialise_middle_pile(Game* info)
-{
-    for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
-    {
-        info->middle_pile.all_tiles[i] = 0;
-    }
-    info->middle_pile.is_token_present = 1;
-}
-
 void print_mid_pile(Game* info)
 {
     printf("\nMiddle pile tiles: ");
@@ -437,146 +224,125 @@ void print_mid_pile(Game* info)
     printf("\n");
 }
 
-int check_MidPile(Game* info)
+void print_player_on_move(Game* info)
 {
-    int cnt = 0;
-    for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
-    {
-        if(info->middle_pile.all_tiles[i] == 0)
-        {
-            cnt++;
-        }
-    }
-
-    if(cnt == HOW_MANY_TILES_TYPES)
-    {
-        return 1;
-    }
-    return 0;
+    int i = info->flow.player_on_move;
+    printf("\n>>> %s's turn (Player %d) <<<\n\n", info->players[i].player_name, i+1);
 }
 
-void set_gameflow_round(Game* info)
+// Ends the program if the player typed quit or there is no more input
+void leave_if_done(int status)
 {
-    for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
+    if(status == INPUT_QUIT)
     {
-        for(int j = 0; j < MAX_PLAYERS; j++)
-        {
-            info->flow.availiability_of_pattern_lines[j][i] = -1;
-        }
+        printf("\nGame abandoned.\n\n");
+        exit(EXIT_SUCCESS);
     }
-
-    for(int i = 0; i < MAX_PLAYERS; i++)
+    if(status == INPUT_EOF)
     {
-        info->flow.player_order[i] = 0;
+        printf("\nNo more input, game abandoned.\n\n");
+        exit(EXIT_FAILURE);
     }
-
-    info->flow.player_on_move = -1;
-    info->flow.selected_tile = -1;
-    info->flow.same_tile_type_on_factory = 0;
-    info->flow.selected_factory = -1;
-    info->flow.selected_pattern_line = -1;
-    info->flow.selections_until_round_finish = 0;
-    info->flow.MidPile_or_factory_selector = BLOCKED;
-    info->flow.check_mid_pile_availiability = BLOCKED;
 }
 
-void set_gameflow_turn(Game* info)
+int ask_number(const char* prompt, int low, int high)
 {
-    // Increment the current player's order (they just played)
-    info->flow.player_order[info->flow.player_on_move]++;
-    
-    // Reset turn-specific variables
-    info->flow.selected_tile = -1;
-    info->flow.same_tile_type_on_factory = 0;
-    info->flow.selected_factory = -1;
-    info->flow.selected_pattern_line = -1;
-    info->flow.selections_until_round_finish++;
-    info->flow.MidPile_or_factory_selector = BLOCKED;
+    int value = low;
+    leave_if_done(read_number(prompt, low, high, &value));
+    return value;
 }
 
-void handdle_token(Game* info)
+// Asks one question of a move: returns a number from `low` to `high`, or
+// TYPED_MOVE if the answer was a whole legal move in game notation
+// ("F3 red L2"), which is put in `typed`. With `can_undo` "undo" is 0.
+int ask_move_question(Game* info, const char* prompt, int low, int high, int can_undo, Move* typed)
 {
-    for(int i = 0; i < info->no_of_players; i++)
+    Input_word word;
+    for(;;)
     {
-        if(info->players[i].is_token_present == 1)
+        leave_if_done(read_word(prompt, &word));
+        if(parse_move(word.text, (int)(input_line_end() - word.text), typed))
         {
-            info->flow.player_order[i]--;
+            skip_line();
+            if(is_move_legal(info, *typed))
+            {
+                return TYPED_MOVE;
+            }
+            printf("That move is not legal now. Try again.\n");
+            continue;
         }
-    }
-}
-
-void set_player_on_move(Game* info)
-{
-    int player_on_move = info->flow.player_order[0];
-
-    for(int i = 0; i < info->no_of_players; i++)
-    {
-        if(info->flow.player_order[i] < player_on_move)
+        if(can_undo && word_is(&word, "undo"))
         {
-            player_on_move = info->flow.player_order[i];
+            return 0;
         }
-    }
-
-    int i = 0;
-    while(info->flow.player_order[i] != player_on_move && i < info->no_of_players)
-    {
-        i++;
-    }
-    info->flow.player_on_move = i;
-    printf("\n>>> %s's turn (Player %d) <<<\n\n", info->players[i].player_name, i+1);
-}
-
-void check_availability_of_mid_pile(Game* info)
-{
-    info->flow.check_mid_pile_availiability = BLOCKED;
-    for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
-    {
-        if(info->middle_pile.all_tiles[i] != 0)
+        if(word.is_number && word.number >= low && word.number <= high)
         {
-            info->flow.check_mid_pile_availiability = AVAILABLE;
-            break;
+            return (int)word.number;
         }
+        printf("Please type a number from %d to %d, or a move like \"F1 red L2\".\n", low, high);
+        skip_line();
     }
 }
 
-void mid_pile_or_factory_selector(Game* info)
+// Returns 1 for the middle pile, 2 for a factory, 0 to undo the last move
+// or TYPED_MOVE
+int mid_pile_or_factory_selector(Game* info, int can_undo, Move* typed)
 {
-    check_availability_of_mid_pile(info);
+    int selector = BLOCKED;
     int factories_available = !check_factories(info); // check_factories returns 1 if all empty
-
-    int mid_available = (info->flow.check_mid_pile_availiability != BLOCKED);
+    int mid_available = !check_MidPile(info);
     
-    // Both available - let player choose
-    if(mid_available && factories_available)
+    // Undo possible - always ask so the player can choose it
+    if(can_undo || (mid_available && factories_available))
     {
+        char prompt[96];
+        int length = snprintf(prompt, sizeof(prompt), "Type %s", can_undo ? "0 to undo the last move, " : "");
+        if(mid_available)
+        {
+            length += snprintf(prompt + length, sizeof(prompt) - length, "1 for middle pile%s",
+                               factories_available ? " or " : "");
+        }
+        if(factories_available)
+        {
+            length += snprintf(prompt + length, sizeof(prompt) - length, "2 for factory");
+        }
+        snprintf(prompt + length, sizeof(prompt) - length, ": ");
+
         do
         {
-            printf("Type 1 for middle pile or 2 for factory: ");
-            scanf("%d", &info->flow.MidPile_or_factory_selector);
-        } while (info->flow.MidPile_or_factory_selector != 1 && info->flow.MidPile_or_factory_selector != 2);   
+            selector = ask_move_question(info, prompt, can_undo ? 0 : 1, 2, can_undo, typed);
+            if((selector == 1 && !mid_available) || (selector == 2 && !factories_available))
+            {
+                printf("Nothing to take there. Try again.\n");
+                skip_line();
+                selector = BLOCKED;
+            }
+        } while (selector == BLOCKED);
     }
     // Only middle pile available
     else if(mid_available && !factories_available)
     {
         printf("All factories empty, taking from middle pile\n\n");
-        info->flow.MidPile_or_factory_selector = 1;
+        selector = 1;
     }
     // Only factories available
     else if(!mid_available && factories_available)
     {
         printf("Middle pile is empty, selecting from factory\n\n");
-        info->flow.MidPile_or_factory_selector = 2;
+        selector = 2;
     }
     // Neither available - this shouldn't happen, but handle it
     else
     {
         printf("ERROR: Nothing to select from! Round should have ended.\n");
-        info->flow.MidPile_or_factory_selector = BLOCKED;
     }
+    return selector;
 }
 
-void select_from_middle_pile(Game* info)
+// Returns the selected color or TYPED_MOVE
+int select_from_middle_pile(Game* info, Move* typed)
 {
+    int selected_tile = -1;
     printf("\nAvailable tiles in middle pile:\n");
     for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
     {
@@ -588,837 +354,1218 @@ void select_from_middle_pile(Game* info)
         }
     }
     
-    // FIXED: Logic was inverted
-    do
-    {
-        printf("Select tile color (0-4): ");
-        scanf("%d", &info->flow.selected_tile);
-    } while (info->flow.selected_tile < 0 || 
-             info->flow.selected_tile >= HOW_MANY_TILES_TYPES || 
-             info->middle_pile.all_tiles[info->flow.selected_tile] == 0);
+    for(;;)
+    {
+        selected_tile = ask_move_question(info, "Select tile color (0-4): ", 0, HOW_MANY_TILES_TYPES - 1, 0, typed);
+        if(selected_tile == TYPED_MOVE || count_tiles_in_source(info, MIDDLE_PILE, selected_tile) > 0)
+        {
+            break;
+        }
+        printf("Tile not available in the middle pile. Try again.\n");
+        skip_line();
+    }
     
-    info->flow.same_tile_type_on_factory = info->middle_pile.all_tiles[info->flow.selected_tile];
+    return selected_tile;
 }
 
 int check_availiability_of_factory(Game* info, int selected_factory)
 {
-    // FIXED: Initialize cnt
-    int cnt = 0;
     for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
     {
         if(info->factory_displays.all_factories[selected_factory][j] != BLOCKED)
         {
-            cnt++;
+            return 1;
         }
     }
-    if (cnt > 0) // FIXED: Should be > 0, not == 4
-    {
-        return 1;
-    }
-    else
-    {
-        return 0;
-    }
-}
-
-void select_factory(Game* info)
-{
-    // FIXED: Logic operators (should be OR, not AND)
-    do{
-        printf("Select a factory (1-%d): ", info->no_of_factory_displays);  
-        scanf("%d", &info->flow.selected_factory);
-    }while(info->flow.selected_factory < 1 || 
-           info->flow.selected_factory > info->no_of_factory_displays || 
-           !check_availiability_of_factory(info, info->flow.selected_factory - 1));
-    
-    info->flow.selected_factory = info->flow.selected_factory - 1;
-    print_chosen_factory(info, info->flow.selected_factory);
+    return 0;
 }
 
-int is_tile_on_factory(Game* info, int selected_tile, int selected_factory)
+// Returns the 0-based index of the selected factory or TYPED_MOVE
+int select_factory(Game* info, Move* typed)
 {
-    for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+    int selected_factory = -1;
+    char prompt[32];
+    snprintf(prompt, sizeof(prompt), "Select a factory (1-%d): ", info->no_of_factory_displays);
+    for(;;)
     {
-        if(info->factory_displays.all_factories[selected_factory][i] == selected_tile)
+        selected_factory = ask_move_question(info, prompt, 1, info->no_of_factory_displays, 0, typed);
+        if(selected_factory == TYPED_MOVE)
         {
-            return 1;
+            return TYPED_MOVE;
         }
+        if(check_availiability_of_factory(info, selected_factory - 1))
+        {
+            break;
+        }
+        printf("Factory %d is empty. Try again.\n", selected_factory);
+        skip_line();
     }
-    return 0;
+    
+    selected_factory = selected_factory - 1;
+    print_chosen_factory(info, selected_factory);
+    return selected_factory;
 }
 
-void select_wanted_tile_from_factory(Game* info) 
+// Returns the selected color or TYPED_MOVE
+int select_wanted_tile_from_factory(Game* info, int selected_factory, Move* typed) 
 {   
-    select_factory(info);
-    do {
-        printf("Select tile color (0=BLUE, 1=RED, 2=BLACK, 3=YELLOW, 4=WHITE): ");
-        scanf("%d", &info->flow.selected_tile);
-
-        if (!is_tile_on_factory(info, info->flow.selected_tile, info->flow.selected_factory)) 
+    int selected_tile = -1;
+    for(;;)
+    {
+        selected_tile = ask_move_question(info, "Select tile color (0=BLUE, 1=RED, 2=BLACK, 3=YELLOW, 4=WHITE): ",
+                                          0, HOW_MANY_TILES_TYPES - 1, 0, typed);
+        if (selected_tile == TYPED_MOVE)
         {
-            printf("Tile not available on this factory. Try again.\n");
+            return TYPED_MOVE;
         }
-    } while (info->flow.selected_tile < 0 || 
-             info->flow.selected_tile >= HOW_MANY_TILES_TYPES || 
-             !is_tile_on_factory(info, info->flow.selected_tile, info->flow.selected_factory));
-
-    printf("You selected: ");
-    print_tile(info->flow.selected_tile);
-    printf("\n");
-}
-
-void how_many_same_tile_type_on_factory(Game* info)
-{
-    int all_same_tiles = 0;
-    int selected_factory = info->flow.selected_factory;
-    for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
-    {
-        if(info->factory_displays.all_factories[selected_factory][i] == info->flow.selected_tile)
+        if (count_tiles_in_source(info, selected_factory, selected_tile) > 0) 
         {
-            all_same_tiles++;
+            break;
         }
+        printf("Tile not available on this factory. Try again.\n");
+        skip_line();
     }
-    info->flow.same_tile_type_on_factory = all_same_tiles;
-    printf("Tiles of this color on factory: %d\n\n", info->flow.same_tile_type_on_factory);
+
+    printf("You selected: ");
+    print_tile(selected_tile);
+    printf("\n");
+    printf("Tiles of this color on factory: %d\n\n", count_tiles_in_source(info, selected_factory, selected_tile));
+    return selected_tile;
 }
 
-void what_pattern_line_are_avalibel_and_free_spaces(Game* info) 
+// Free spaces of every pattern line the selected tiles may go to, BLOCKED otherwise
+void what_pattern_line_are_avalibel_and_free_spaces(Game* info, Move move, int availability[HOW_MANY_TILES_TYPES]) 
 {
+    Mat* mat = &info->players[info->flow.player_on_move].mat;
     for (int i = 0; i < HOW_MANY_TILES_TYPES; i++) 
     {   
-        int free_cnt = 0;
-
-        for (int j = 0; j < HOW_MANY_TILES_TYPES; j++) 
+        move.pattern_line = i;
+        if (is_move_legal(info, move)) 
         {
-            if (i + j >= HOW_MANY_TILES_TYPES - 1) 
-            {
-                if (info->players[info->flow.player_on_move].mat.pattern_lines[i][j] == AVAILABLE) 
-                {
-                    free_cnt++;
-                }
-            }
-        }
-        
-        if (free_cnt > 0) 
-        {
-            info->flow.availiability_of_pattern_lines[info->flow.player_on_move][i] = free_cnt;
+            availability[i] = i + 1 - pattern_line_count(mat, i);
         } 
         else 
         {
-            info->flow.availiability_of_pattern_lines[info->flow.player_on_move][i] = BLOCKED;
+            availability[i] = BLOCKED;
         }
     }
 
     printf("Pattern line availability (spaces): ");
     for (int i = 0; i < HOW_MANY_TILES_TYPES; i++) 
     {
-        printf("L%d:%d ", i, info->flow.availiability_of_pattern_lines[info->flow.player_on_move][i]);
+        printf("L%d:%d ", i, availability[i]);
     }
     printf("\n\n");
 }
 
-void select_patern_line(Game* info)
+// Returns the selected pattern line, FLOOR_LINE or TYPED_MOVE
+int select_patern_line(Game* info, int availability[HOW_MANY_TILES_TYPES], Move* typed)
 {
     int wanted_line = -1;
-    // FIXED: Logic operators (should be OR)
-    do
+    for(;;)
     {
-        printf("Select pattern line (0-4, or -1 for floor): ");
-        scanf("%d", &wanted_line);
-    } while ((wanted_line < -1 || wanted_line > 4) || 
-             (wanted_line >= 0 && info->flow.availiability_of_pattern_lines[info->flow.player_on_move][wanted_line] == BLOCKED));
+        wanted_line = ask_move_question(info, "Select pattern line (0-4, or -1 for floor): ",
+                                        FLOOR_LINE, HOW_MANY_TILES_TYPES - 1, 0, typed);
+        if(wanted_line == TYPED_MOVE)
+        {
+            return TYPED_MOVE;
+        }
+        if(wanted_line == FLOOR_LINE || availability[wanted_line] != BLOCKED)
+        {
+            break;
+        }
+        printf("Pattern line %d cannot take these tiles. Try again.\n", wanted_line);
+        skip_line();
+    }
 
-    info->flow.selected_pattern_line = wanted_line;
     if(wanted_line >= 0)
     {
-        printf("Selected pattern line %d\n\n", info->flow.selected_pattern_line);
+        printf("Selected pattern line %d\n\n", wanted_line);
     }
     else
     {
         printf("Tiles will go to floor line\n\n");
     }
+    return wanted_line;
 }
 
-void put_on_available_floorline_slot(Game* info)
+// Asks the player on move for a complete, legal move.
+// Returns 0 instead if the player asked to undo the last move.
+int read_move(Game* info, Move* selected, int can_undo)
 {
-    for(int i = 0; i < MAX_PENALTIES; i++)
+    Move move;
+    Move typed;
+    int availability[HOW_MANY_TILES_TYPES];
+    int selector = mid_pile_or_factory_selector(info, can_undo, &typed);
+
+    // A whole move typed at any of the questions replaces the answers so far
+    if(selector == 0)
     {
-        if(info->players[info->flow.player_on_move].mat.penalties[i] == AVAILABLE && 
-           info->flow.same_tile_type_on_factory > 0)
-        {
-            info->players[info->flow.player_on_move].mat.penalties[i] = info->flow.selected_tile;
-            info->flow.same_tile_type_on_factory--;
-        }
-        if(info->flow.same_tile_type_on_factory == 0)
-        {
-            break;
-        }
+        return 0;
     }
-    
-    // Excess tiles go back to bag
-    while(info->flow.same_tile_type_on_factory > 0)
+    if(selector == 1)
+    {
+        move.source = MIDDLE_PILE;
+        move.color = select_from_middle_pile(info, &typed);
+    }
+    else if(selector == 2 && (move.source = select_factory(info, &typed)) != TYPED_MOVE)
+    {
+        move.color = select_wanted_tile_from_factory(info, move.source, &typed);
+    }
+    if(selector == TYPED_MOVE || move.source == TYPED_MOVE || move.color == TYPED_MOVE)
     {
-        info->bag.all_tiles[info->flow.selected_tile]++;
-        info->flow.same_tile_type_on_factory--;
+        *selected = typed;
+        return 1;
     }
+
+    what_pattern_line_are_avalibel_and_free_spaces(info, move, availability);
+    move.pattern_line = select_patern_line(info, availability, &typed);
+    *selected = move.pattern_line == TYPED_MOVE ? typed : move;
+    return 1;
 }
 
-void amplasate_from_middle_pile_on_pattern_lines(Game* info)
+void print_factories(Game* info)
 {
-    select_from_middle_pile(info);
-    
-    // Take the token if present
-    if(info->middle_pile.is_token_present)
+    printf("\n--- FACTORIES ---\n");
+    for(int i = 0; i < info->no_of_factory_displays; i++)
     {
-        info->players[info->flow.player_on_move].is_token_present = 1;
-        info->middle_pile.is_token_present = 0;
-        
-        // Put token on first available floor slot
-        for(int i = 0; i < MAX_PENALTIES; i++)
+        printf("Factory %d: ", i+1);
+        int empty = 1;
+        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
         {
-            if(info->players[info->flow.player_on_move].mat.penalties[i] == AVAILABLE)
+            if(info->factory_displays.all_factories[i][j] != BLOCKED)
             {
-                info->players[info->flow.player_on_move].mat.penalties[i] = -3; // Token marker
-                break;
+                print_tile(info->factory_displays.all_factories[i][j]);
+                printf(" ");
+                empty = 0;
             }
         }
-        printf("You took the first player token! (-1 point)\n");
+        if(empty)
+        {
+            printf("[EMPTY]");
+        }
+        printf("\n");
     }
-    
-    select_patern_line(info);
-
-    int player_idx = info->flow.player_on_move;
-    int wanted_line = info->flow.selected_pattern_line;
-    
-    // Floor line selected
-    if(wanted_line == -1)
+    print_mid_pile(info);
+    printf("\n");
+}
+
+void print_round_report(Game* info, Round_report* report)
+{
+    printf("\n=== PROCESSING END OF ROUND ===\n\n");
+
+    for(int p = 0; p < info->no_of_players; p++)
     {
-        put_on_available_floorline_slot(info);
-        info->middle_pile.all_tiles[info->flow.selected_tile] = 0;
-        print_players_boards(info);
-        print_mid_pile(info);
-        return;
+        printf("Processing %s's board:\n", info->players[p].player_name);
+        for(int i = 0; i < report->no_of_placements[p]; i++)
+        {
+            Wall_placement* placed = &report->placements[p][i];
+            printf("  Row %d complete with color %d\n", placed->row, placed->color);
+            printf("    Placed at wall[%d][%d], scored %d points\n", placed->row, placed->wall_col, placed->score);
+        }
+        printf("  Penalty points: %d\n", report->penalty_points[p]);
+        printf("  Round score: %+d, Total score: %d\n\n", report->round_score[p], info->players[p].mat.score);
     }
-    
-    int col_idx = HOW_MANY_TILES_TYPES - 1;
-    
-    // Check if pattern line already has different color
-    for(int j = 0; j < HOW_MANY_TILES_TYPES; j++)
+}
+
+void print_bonus_report(Game* info, Bonus_report* report)
+{
+    printf("\n=== CALCULATING FINAL BONUSES ===\n\n");
+
+    const char* color_names[] = {"Blue", "Red", "Black", "Yellow", "White"};
+    for(int p = 0; p < info->no_of_players; p++)
     {
-        if(info->players[player_idx].mat.pattern_lines[wanted_line][j] >= 0 &&
-           info->players[player_idx].mat.pattern_lines[wanted_line][j] < HOW_MANY_TILES_TYPES)
+        printf("%s's bonuses:\n", info->players[p].player_name);
+        if(report->complete_rows[p] > 0)
+        {
+            printf("  %d complete row(s): +%d points\n", report->complete_rows[p], report->complete_rows[p] * 2);
+        }
+        if(report->complete_cols[p] > 0)
         {
-            if(info->players[player_idx].mat.pattern_lines[wanted_line][j] != info->flow.selected_tile)
+            printf("  %d complete column(s): +%d points\n", report->complete_cols[p], report->complete_cols[p] * 7);
+        }
+        for(int color = 0; color < 5; color++)
+        {
+            if(report->complete_colors[p][color])
             {
-                printf("Pattern line already has different color! Tiles go to floor.\n");
-                put_on_available_floorline_slot(info);
-                info->middle_pile.all_tiles[info->flow.selected_tile] = 0;
-                print_players_boards(info);
-                print_mid_pile(info);
-                return;
+                printf("  Complete %s set: +10 points\n", color_names[color]);
             }
         }
+        printf("  Total bonus: +%d points\n", report->bonus_points[p]);
+        printf("  Final score: %d\n\n", info->players[p].mat.score);
     }
+}
+
+void determine_winner(Game* info)
+{
+    printf("\n=== FINAL RESULTS ===\n\n");
     
-    // Place tiles on pattern line
-    while(col_idx >= 0 && 
-          col_idx + wanted_line >= HOW_MANY_TILES_TYPES - 1 && 
-          info->flow.same_tile_type_on_factory > 0)
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        printf("%s: %u points\n", info->players[p].player_name, info->players[p].mat.score);
+    }
+
+    int winner_idx = find_winner(info);
+    if(winner_idx == -1)
+    {
+        printf("\nIt's a tie! Tiebreaker on complete rows could not separate the players.\n");
+    }
+    else
+    {
+        printf("\n🎉 %s WINS with %u points! 🎉\n", 
+               info->players[winner_idx].player_name, info->players[winner_idx].mat.score);
+    }
+}
+
+void set_players_name(Game* info)
+{
+    if(info->no_of_players > 1 && info->no_of_players < 5)
     {
-        if(info->players[player_idx].mat.pattern_lines[wanted_line][col_idx] == AVAILABLE)
+        printf("GOOD! Now set player names:\n");
+        int i = 0;
+        while(i < info->no_of_players)
         {
-            info->players[player_idx].mat.pattern_lines[wanted_line][col_idx] = info->flow.selected_tile;
-            info->flow.availiability_of_pattern_lines[player_idx][wanted_line]--;
-            info->flow.same_tile_type_on_factory--;
+            char prompt[32];
+            snprintf(prompt, sizeof(prompt), "Name for Player %d: ", i+1);
+            leave_if_done(read_name(prompt, info->players[i].player_name, MAX_PLAYER_NAME));
+            i++;
         }
-        col_idx--;
     }
-    
-    // Remaining tiles to floor
-    if(info->flow.same_tile_type_on_factory > 0)
+    else
     {
-        put_on_available_floorline_slot(info);
+        printf("Invalid number of players! Must be 2-4.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Asks which seats the computer plays (with the search), fills `seats`
+void set_computer_players(Game* info, int seats[MAX_PLAYERS])
+{
+    for(int i = 0; i < info->no_of_players; i++)
+    {
+        char prompt[64];
+        snprintf(prompt, sizeof(prompt), "Is %s played by the computer? (1 = yes, 0 = no): ",
+                 info->players[i].player_name);
+        int is_computer = ask_number(prompt, 0, 1);
+        seats[i] = is_computer ? BOT_SEARCH : SEAT_HUMAN;
+    }
+}
+
+void print_move_taken(Game* info, Move move)
+{
+    printf("%s takes ", info->players[info->flow.player_on_move].player_name);
+    print_tile(move.color);
+    if(move.source == MIDDLE_PILE)
+    {
+        printf(" from the middle pile");
+    }
+    else
+    {
+        printf(" from factory %d", move.source + 1);
+    }
+    if(move.pattern_line == FLOOR_LINE)
+    {
+        printf(" to the floor line\n");
+    }
+    else
+    {
+        printf(" to pattern line %d\n", move.pattern_line);
     }
-    
-    info->middle_pile.all_tiles[info->flow.selected_tile] = 0;
-    
-    printf("Tiles placed!\n\n");
-    print_players_boards(info);
-    print_mid_pile(info);
 }
 
-void amplasate_on_pattern_line_or_mid_pile(Game* info)
+// Lets the bot of the seat pick the move of the player on move, the
+// search seat uses the full multithreaded MCTS, and the endgame solver
+// for up to `endgame_seconds` once the game ends with this round. The
+// first move of the game comes from the book if there is one. If the
+// solver fails MCTS moves, if MCTS fails the seat's bot moves as in a
+// batch.
+Move computer_move(Game* info, int seat, Rng* rng, double endgame_seconds)
 {
-    select_wanted_tile_from_factory(info);
-    how_many_same_tile_type_on_factory(info);
-    select_patern_line(info);
+    Move move;
+    int found = 0;
 
-    int selected_factory = info->flow.selected_factory;
-    int player_idx = info->flow.player_on_move;
-    int wanted_line = info->flow.selected_pattern_line;
-    
-    // Floor line selected
-    if(wanted_line == -1)
+    if((seat == BOT_SEARCH || seat == BOT_EXPECTIMAX) && default_book != NULL &&
+       book_lookup(default_book, info, &move))
     {
-        // Put selected tiles on floor
-        put_on_available_floorline_slot(info);
-        
-        // Move other tiles to middle
-        for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+        found = 1;
+        print_move_taken(info, move);
+        LOG(LOG_VERBOSE, "(from the opening book)\n");
+    }
+    if(!found && seat == BOT_SEARCH && is_final_round(info))
+    {
+        Endgame_config endgame_config;
+        Endgame_result endgame;
+
+        endgame_default_config(&endgame_config);
+        endgame_config.max_seconds = endgame_seconds;
+        LOG(LOG_NORMAL, "%s is solving the endgame...\n", info->players[info->flow.player_on_move].player_name);
+        found = endgame_solve(info, &endgame_config, &endgame);
+        if(found)
         {
-            if(info->factory_displays.all_factories[selected_factory][i] != info->flow.selected_tile &&
-               info->factory_displays.all_factories[selected_factory][i] != BLOCKED)
-            {
-                int other_tile = info->factory_displays.all_factories[selected_factory][i];
-                info->middle_pile.all_tiles[other_tile]++;
-            }
-            info->factory_displays.all_factories[selected_factory][i] = BLOCKED;
+            move = endgame.best_move;
+            print_move_taken(info, move);
+            LOG(LOG_VERBOSE, "(%s %+d after %d plies, %ld nodes in %.2fs: %.0f nodes/sec)\n",
+                endgame.is_exact ? "final lead" : "expected lead", endgame.value, endgame.depth,
+                endgame.nodes, endgame.seconds, endgame.nodes_per_second);
         }
-        
-        printf("Tiles placed on floor line!\n\n");
-        print_players_boards(info);
-        print_mid_pile(info);
-        return;
     }
+    if(!found && seat == BOT_SEARCH)
+    {
+        Mcts_config config;
+        Mcts_result result;
+
+        mcts_default_config(&config);
+        config.seed = derive_seed(info->hash, info->flow.round_number);
+        LOG(LOG_NORMAL, "%s is thinking...\n", info->players[info->flow.player_on_move].player_name);
+        found = mcts_search(info, &config, &result);
+        if(found)
+        {
+            move = result.best_move;
+            print_move_taken(info, move);
+            LOG(LOG_VERBOSE, "(%ld iterations, %d nodes in %.2fs: %.0f iterations/sec, %.0f nodes/sec)\n",
+                result.iterations, result.nodes, result.seconds,
+                result.iterations_per_second, result.nodes_per_second);
+        }
+    }
+    if(!found)
+    {
+        Bot bot;
+        default_bot(&bot, seat);
+        bot.endgame_nodes = 0;    // the solver has failed already
+        move = choose_bot_move(info, &bot, rng);
+        print_move_taken(info, move);
+    }
+    printf("\n");
+    return move;
+}
+
+void print_title() 
+{  
+    printf("\n\n\n");                                         
+    printf(" @@@@@@   @@@@@@@@  @@@  @@@  @@@       \n");
+    printf("@@@@@@@@  @@@@@@@@  @@@  @@@  @@@       \n");
+    printf("@@!  @@@       @@!  @@!  @@@  @@!       \n");
+    printf("!@!  @!@      !@!   !@!  @!@  !@!       \n");
+    printf("@!@!@!@!     @!!    @!@  !@!  @!!       \n");
+    printf("!!!@!!!!    !!!     !@!  !!!  !!!       \n");
+    printf("!!:  !!!   !!:      !!:  !!!  !!:       \n");
+    printf(":!:  !:!  :!:       :!:  !:!   :!:      \n");
+    printf("::   :::   :: ::::  ::::: ::   :: ::::  \n");
+    printf(" :   : :  : :: : :   : :  :   : :: : :  \n");
+    printf("\n\n\n");  
+}
+
+// Redraws the whole table in place, only the changed cells are sent.
+// Returns 0 if the table does not fit the terminal.
+int draw_table(Renderer* renderer, Game* info)
+{
+    static Frame frame;
+    char status_line[FRAME_COLS];
+
+    snprintf(status_line, sizeof(status_line), ">>> %s's turn (round %d)",
+             info->players[info->flow.player_on_move].player_name, info->flow.round_number);
+    frame_draw_game(&frame, info, status_line);
+    return render_frame(renderer, &frame);
+}
+
+// Returns the number of moves of `history` left once the last human move
+// and the bot moves after it are taken back, or -1 if no human has moved
+int moves_before_last_human(const Undo_record history[], int no_of_moves, const int seats[MAX_PLAYERS])
+{
+    for(int i = no_of_moves - 1; i >= 0; i--)
+    {
+        if(seats[history[i].player_idx] == SEAT_HUMAN)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// With a renderer (stdout is a terminal) the table is redrawn in place
+// every turn, otherwise, or while the terminal is too small for it, the
+// boards are printed after each move. The fill
+// and the moves that were not taken back go to `record` unless it is NULL.
+// Undo takes back the last human move, and the bot replies after it.
+void handle_round(Game* info, const int seats[MAX_PLAYERS], Rng* bot_rng, Renderer* renderer, FILE* record,
+                  double endgame_seconds)
+{
+    LOG(LOG_NORMAL, "\n=== STARTING NEW ROUND ===\n\n");
     
-    int col_idx = HOW_MANY_TILES_TYPES - 1;
-    
-    // Check if pattern line has different color tiles
-    for(int j = 0; j < HOW_MANY_TILES_TYPES; j++)
+    // Moves of this round, so they can be taken back
+    Undo_record history[MAX_MOVES_PER_ROUND];
+    int no_of_moves = 0;
+
+    start_round(info);
+    if(record != NULL)
     {
-        if(info->players[player_idx].mat.pattern_lines[wanted_line][j] >= 0 &&
-           info->players[player_idx].mat.pattern_lines[wanted_line][j] < HOW_MANY_TILES_TYPES &&
-           info->players[player_idx].mat.pattern_lines[wanted_line][j] != info->flow.selected_tile)
+        notation_write_fill(record, info);
+    }
+    if(renderer == NULL)
+    {
+        print_filled_factories(info);
+    }
+
+    while (!is_round_over(info))
+    {
+        int is_drawn = renderer != NULL && draw_table(renderer, info);
+        if(!is_drawn)
+        {
+            print_player_on_move(info);
+            print_factories(info);
+        }
+        
+        Move move;
+        int seat = seats[info->flow.player_on_move];
+        if(seat != SEAT_HUMAN)
         {
-            printf("Pattern line has different color! All tiles go to floor.\n");
-            put_on_available_floorline_slot(info);
-            
-            for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+            move = computer_move(info, seat, bot_rng, endgame_seconds);
+        }
+        else if(!read_move(info, &move, moves_before_last_human(history, no_of_moves, seats) >= 0))
+        {
+            int keep = moves_before_last_human(history, no_of_moves, seats);
+            while(no_of_moves > keep)
             {
-                if(info->factory_displays.all_factories[selected_factory][i] != info->flow.selected_tile &&
-                   info->factory_displays.all_factories[selected_factory][i] != BLOCKED)
-                {
-                    int other_tile = info->factory_displays.all_factories[selected_factory][i];
-                    info->middle_pile.all_tiles[other_tile]++;
-                }
-                info->factory_displays.all_factories[selected_factory][i] = BLOCKED;
+                undo_move(info, &history[--no_of_moves]);
+            }
+            printf("Last move undone!\n\n");
+            if(!is_drawn)
+            {
+                print_players_boards(info);
             }
-            
+            continue;
+        }
+
+        if(move.source == MIDDLE_PILE && info->middle_pile.is_token_present)
+        {
+            LOG(LOG_NORMAL, "You took the first player token! (-1 point)\n");
+        }
+
+        apply_move_with_undo(info, move, &history[no_of_moves++]);
+
+        if(move.pattern_line == FLOOR_LINE)
+        {
+            LOG(LOG_NORMAL, "Tiles placed on floor line!\n\n");
+        }
+        else
+        {
+            LOG(LOG_NORMAL, "Tiles placed!\n\n");
+        }
+        if(!is_drawn)
+        {
             print_players_boards(info);
             print_mid_pile(info);
-            return;
         }
     }
-    
-    // Place tiles on pattern line
-    while(col_idx >= 0 && 
-          col_idx + wanted_line >= HOW_MANY_TILES_TYPES - 1 && 
-          info->flow.same_tile_type_on_factory > 0)
+
+    if(record != NULL)
     {
-        if(info->players[player_idx].mat.pattern_lines[wanted_line][col_idx] == AVAILABLE)
+        for(int i = 0; i < no_of_moves; i++)
         {
-            info->players[player_idx].mat.pattern_lines[wanted_line][col_idx] = info->flow.selected_tile;
-            info->flow.availiability_of_pattern_lines[player_idx][wanted_line]--;
-            info->flow.same_tile_type_on_factory--;
+            notation_write_move(record, history[i].move);
         }
-        col_idx--;
+        fflush(record);
     }
-    
-    // Remaining tiles to floor
-    if(info->flow.same_tile_type_on_factory > 0)
+    LOG(LOG_NORMAL, "\n=== ROUND COMPLETE ===\n");
+}
+
+void print_usage(const char* program)
+{
+    printf("Usage: %s [options]\n", program);
+    printf("  --players <2-4>           number of players\n");
+    printf("  --seats <seat,seat,...>   human, random, greedy, search or expectimax, one per player\n");
+    printf("  --names <name,name,...>   player names (at most %d characters)\n", MAX_PLAYER_NAME - 1);
+    printf("  --seed <n>                same seed, same factory fills and bot moves\n");
+    printf("  --games <n>               games to play, every seat must be a bot\n");
+    printf("  --threads <n>             threads of a batch (default: all cores)\n");
+    printf("  --format <text|csv|json>  batch output: summary, or one line per game\n");
+    printf("  --quiet, --verbose        less or more play-by-play text\n");
+    printf("  --archive <file>          append the batch games to a binary archive\n");
+    printf("  --lockstep                play a batch of random bots in lockstep blocks\n");
+    printf("  --replay-archive <file>   replay every game of an archive and check it\n");
+    printf("  --archive-to-notation <file>  print every game of an archive as notation\n");
+    printf("  --replay-notation <file>  replay a notation file (- for stdin) and check it\n");
+    printf("  --record <file>           write the game being played as notation\n");
+    printf("  --serve <address>         host games over a socket: <port>, <host>:<port> or unix:<path>\n");
+    printf("  --weights <file>          evaluation weights of the expectimax seats (tools/azul_tune.c)\n");
+    printf("  --net <file>              network the expectimax seats evaluate with (tools/azul_net_train.c)\n");
+    printf("  --book <file>             first moves of the search and expectimax seats (tools/azul_book.c)\n");
+    printf("  --endgame-time <seconds>  time of a search seat's move once the game ends with the round (default 2)\n");
+    printf("  --selfplay <games> <bot> <bot> [<bot> <bot>]  same as --games with --seats\n");
+    printf("With a bot on every seat nothing is asked and --games defaults to 1.\n");
+}
+
+// Splits a comma separated list, returns the number of items or -1 if
+// there are more than MAX_PLAYERS
+int split_list(char* list, char* items[MAX_PLAYERS])
+{
+    int no_of_items = 0;
+    for(char* item = strtok(list, ","); item != NULL; item = strtok(NULL, ","))
     {
-        put_on_available_floorline_slot(info);
+        if(no_of_items == MAX_PLAYERS)
+        {
+            return -1;
+        }
+        items[no_of_items++] = item;
     }
-    
-    // Move other colored tiles to middle
-    for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+    return no_of_items;
+}
+
+int parse_seats(char* list, Options* options)
+{
+    char* items[MAX_PLAYERS];
+    int no_of_items = split_list(list, items);
+    if(no_of_items < 2)
+    {
+        return 0;
+    }
+    for(int p = 0; p < no_of_items; p++)
     {
-        if(info->factory_displays.all_factories[selected_factory][i] != info->flow.selected_tile &&
-           info->factory_displays.all_factories[selected_factory][i] != BLOCKED)
+        options->seats[p] = strcmp(items[p], "human") == 0 ? SEAT_HUMAN : bot_type_from_name(items[p]);
+        if(options->seats[p] == -1 && strcmp(items[p], "human") != 0)
         {
-            int other_tile = info->factory_displays.all_factories[selected_factory][i];
-            info->middle_pile.all_tiles[other_tile]++;
+            printf("Unknown seat: %s\n", items[p]);
+            return 0;
         }
-        info->factory_displays.all_factories[selected_factory][i] = BLOCKED;
     }
+    options->no_of_seats = no_of_items;
+    return 1;
+}
 
-    printf("Tiles placed!\n\n");
-
-    print_players_boards(info);
-    print_mid_pile(info);
+int parse_names(char* list, Options* options)
+{
+    char* items[MAX_PLAYERS];
+    int no_of_items = split_list(list, items);
+    if(no_of_items < 2)
+    {
+        return 0;
+    }
+    for(int p = 0; p < no_of_items; p++)
+    {
+        snprintf(options->names[p], MAX_PLAYER_NAME, "%s", items[p]);
+    }
+    options->no_of_names = no_of_items;
+    return 1;
 }
 
-void print_factories(Game* info)
+static const char* const value_options[] = {
+    "--players", "--seats", "--names", "--seed", "--games", "--threads", "--format", "--selfplay",
+    "--archive", "--replay-archive", "--archive-to-notation", "--replay-notation", "--record", "--serve",
+    "--endgame-time", "--weights", "--net", "--book"
+};
+
+int is_value_option(const char* option)
 {
-    printf("\n--- FACTORIES ---\n");
-    for(int i = 0; i < info->no_of_factory_displays; i++)
+    for(size_t i = 0; i < sizeof(value_options) / sizeof(value_options[0]); i++)
     {
-        printf("Factory %d: ", i+1);
-        int empty = 1;
-        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+        if(strcmp(option, value_options[i]) == 0)
         {
-            if(info->factory_displays.all_factories[i][j] != BLOCKED)
-            {
-                print_tile(info->factory_displays.all_factories[i][j]);
-                printf(" ");
-                empty = 0;
-            }
-        }
-        if(empty)
-        {
-            printf("[EMPTY]");
+            return 1;
         }
-        printf("\n");
     }
-    print_mid_pile(info);
-    printf("\n");
+    return 0;
 }
 
-void process_end_of_round(Game* info)
+// Returns 0 (after printing why) if the command line is not valid
+int parse_options(int argc, char* argv[], Options* options)
 {
-    printf("\n=== PROCESSING END OF ROUND ===\n\n");
-    
-    int penalties[] = {-1, -1, -2, -2, -2, -3, -3};
-    
-    for(int p = 0; p < info->no_of_players; p++)
+    memset(options, 0, sizeof(*options));
+    options->seed = time(NULL);
+    options->format = FORMAT_TEXT;
+    options->endgame_seconds = 2.0;
+
+    for(int i = 1; i < argc; i++)
     {
-        printf("Processing %s's board:\n", info->players[p].player_name);
-        int round_score = 0;
-        
-        // Check each pattern line
-        for(int row = 0; row < 5; row++)
-        {
-            // Check if pattern line is complete
-            int line_complete = 1;
-            int tile_color = -1;
-            
-            // Find what color tiles are on this line
-            for(int col = 4; col >= 0; col--)
-            {
-                if(row + col >= 4) // Valid position for this row
-                {
-                    if(info->players[p].mat.pattern_lines[row][col] == AVAILABLE)
-                    {
-                        line_complete = 0;
-                        break;
-                    }
-                    else if(info->players[p].mat.pattern_lines[row][col] >= 0 && 
-                            info->players[p].mat.pattern_lines[row][col] < 5)
-                    {
-                        tile_color = info->players[p].mat.pattern_lines[row][col];
-                    }
-                }
-            }
-            
-            // If line is complete, move one tile to wall
-            if(line_complete && tile_color >= 0)
+        const char* option = argv[i];
+        char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        int used_value = 1;
+
+        if(strcmp(option, "--quiet") == 0)
+        {
+            log_verbosity = LOG_QUIET;
+            used_value = 0;
+        }
+        else if(strcmp(option, "--verbose") == 0)
+        {
+            log_verbosity = LOG_VERBOSE;
+            used_value = 0;
+        }
+        else if(strcmp(option, "--lockstep") == 0)
+        {
+            options->is_lockstep = 1;
+            used_value = 0;
+        }
+        else if(!is_value_option(option))
+        {
+            printf("Unknown option: %s\n", option);
+            return 0;
+        }
+        else if(value == NULL)
+        {
+            printf("Missing value of %s\n", option);
+            return 0;
+        }
+        else if(strcmp(option, "--players") == 0)
+        {
+            options->no_of_players = atoi(value);
+        }
+        else if(strcmp(option, "--seats") == 0)
+        {
+            if(!parse_seats(value, options))
             {
-                printf("  Row %d complete with color %d\n", row, tile_color);
-                
-                // Find the correct column for this color on this row
-                int wall_col = -1;
-                for(int col = 0; col < 5; col++)
-                {
-                    if(get_portugese_wall_color(row, col) == tile_color)
-                    {
-                        wall_col = col;
-                        break;
-                    }
-                }
-                
-                if(wall_col >= 0)
-                {
-                    // Place tile on wall
-                    info->players[p].mat.portugese_wall[row][wall_col] = BLOCKED;
-                    
-                    // Calculate score for this tile
-                    int tile_score = 1;
-                    int horizontal_count = 1;
-                    int vertical_count = 1;
-                    
-                    // Count horizontally
-                    for(int left = wall_col - 1; left >= 0 && info->players[p].mat.portugese_wall[row][left] == BLOCKED; left--)
-                    {
-                        horizontal_count++;
-                    }
-                    for(int right = wall_col + 1; right < 5 && info->players[p].mat.portugese_wall[row][right] == BLOCKED; right++)
-                    {
-                        horizontal_count++;
-                    }
-                    
-                    // Count vertically
-                    for(int up = row - 1; up >= 0 && info->players[p].mat.portugese_wall[up][wall_col] == BLOCKED; up--)
-                    {
-                        vertical_count++;
-                    }
-                    for(int down = row + 1; down < 5 && info->players[p].mat.portugese_wall[down][wall_col] == BLOCKED; down++)
-                    {
-                        vertical_count++;
-                    }
-                    
-                    // Add points
-                    if(horizontal_count > 1)
-                    {
-                        tile_score += horizontal_count - 1;
-                    }
-                    if(vertical_count > 1)
-                    {
-                        tile_score += vertical_count - 1;
-                    }
-                    
-                    round_score += tile_score;
-                    printf("    Placed at wall[%d][%d], scored %d points\n", row, wall_col, tile_score);
-                }
-                
-                // Clear the pattern line and return extra tiles to bag
-                for(int col = 0; col < 5; col++)
-                {
-                    if(row + col >= 4)
-                    {
-                        if(info->players[p].mat.pattern_lines[row][col] >= 0 && 
-                           info->players[p].mat.pattern_lines[row][col] < 5)
-                        {
-                            // First tile goes to wall, rest go back to bag
-                            if(col != 4) // Don't return the tile we just placed
-                            {
-                                info->bag.all_tiles[tile_color]++;
-                            }
-                        }
-                        info->players[p].mat.pattern_lines[row][col] = AVAILABLE;
-                    }
-                }
+                printf("--seats needs 2-4 seats\n");
+                return 0;
             }
         }
-        
-        // Process floor line penalties
-        int penalty_score = 0;
-        for(int i = 0; i < MAX_PENALTIES; i++)
+        else if(strcmp(option, "--names") == 0)
         {
-            if(info->players[p].mat.penalties[i] != AVAILABLE)
+            if(!parse_names(value, options))
             {
-                penalty_score += penalties[i];
-                // Return tiles to bag (except token marker -3)
-                if(info->players[p].mat.penalties[i] >= 0 && info->players[p].mat.penalties[i] < 5)
-                {
-                    info->bag.all_tiles[info->players[p].mat.penalties[i]]++;
-                }
-                info->players[p].mat.penalties[i] = AVAILABLE;
+                printf("--names needs 2-4 names\n");
+                return 0;
             }
         }
-        
-        printf("  Penalty points: %d\n", penalty_score);
-        round_score += penalty_score;
-        
-        // Update score (can't go below 0)
-        int new_score = info->players[p].mat.score + round_score;
-        if(new_score < 0) new_score = 0;
-        info->players[p].mat.score = new_score;
-        
-        printf("  Round score: %+d, Total score: %d\n\n", round_score, info->players[p].mat.score);
-    }
-}
-
-int check_game_end(Game* info)
-{
-    // Game ends when any player completes a horizontal row
-    for(int p = 0; p < info->no_of_players; p++)
-    {
-        for(int row = 0; row < 5; row++)
+        else if(strcmp(option, "--seed") == 0)
+        {
+            options->seed = strtoull(value, NULL, 10);
+        }
+        else if(strcmp(option, "--games") == 0)
+        {
+            options->no_of_games = atol(value);
+        }
+        else if(strcmp(option, "--archive") == 0)
+        {
+            options->archive_path = value;
+        }
+        else if(strcmp(option, "--replay-archive") == 0)
+        {
+            options->replay_path = value;
+        }
+        else if(strcmp(option, "--archive-to-notation") == 0)
+        {
+            options->convert_path = value;
+        }
+        else if(strcmp(option, "--replay-notation") == 0)
+        {
+            options->notation_path = value;
+        }
+        else if(strcmp(option, "--record") == 0)
+        {
+            options->record_path = value;
+        }
+        else if(strcmp(option, "--serve") == 0)
+        {
+            options->serve_address = value;
+        }
+        else if(strcmp(option, "--weights") == 0)
         {
-            int row_complete = 1;
-            for(int col = 0; col < 5; col++)
+            if(!load_eval_weights(value, &default_eval_weights))
             {
-                if(info->players[p].mat.portugese_wall[row][col] != BLOCKED)
-                {
-                    row_complete = 0;
-                    break;
-                }
+                printf("Cannot read the weights in %s\n", value);
+                return 0;
             }
-            if(row_complete)
+        }
+        else if(strcmp(option, "--net") == 0)
+        {
+            static Net net;
+            if(!net_load(&net, value, NET_KERNELS_AUTO))
             {
-                printf("\n%s completed a row! Game ends after this round.\n", info->players[p].player_name);
-                return 1;
+                printf("Cannot read the network in %s\n", value);
+                return 0;
             }
+            default_net = &net;
         }
-    }
-    return 0;
-}
-
-void calculate_final_bonuses(Game* info)
-{
-    printf("\n=== CALCULATING FINAL BONUSES ===\n\n");
-    
-    for(int p = 0; p < info->no_of_players; p++)
-    {
-        int bonus_points = 0;
-        printf("%s's bonuses:\n", info->players[p].player_name);
-        
-        // Bonus for complete horizontal rows (2 points each)
-        int complete_rows = 0;
-        for(int row = 0; row < 5; row++)
+        else if(strcmp(option, "--book") == 0)
         {
-            int row_complete = 1;
-            for(int col = 0; col < 5; col++)
+            static Book book;
+            if(!book_open(&book, value))
             {
-                if(info->players[p].mat.portugese_wall[row][col] != BLOCKED)
-                {
-                    row_complete = 0;
-                    break;
-                }
+                printf("Cannot read the book in %s\n", value);
+                return 0;
             }
-            if(row_complete)
+            default_book = &book;
+        }
+        else if(strcmp(option, "--endgame-time") == 0)
+        {
+            options->endgame_seconds = atof(value);
+            if(options->endgame_seconds <= 0)
             {
-                complete_rows++;
-                bonus_points += 2;
+                printf("--endgame-time needs a number of seconds\n");
+                return 0;
             }
         }
-        if(complete_rows > 0)
+        else if(strcmp(option, "--threads") == 0)
         {
-            printf("  %d complete row(s): +%d points\n", complete_rows, complete_rows * 2);
+            options->no_of_threads = atoi(value);
         }
-        
-        // Bonus for complete vertical columns (7 points each)
-        int complete_cols = 0;
-        for(int col = 0; col < 5; col++)
+        else if(strcmp(option, "--format") == 0)
+        {
+            if(strcmp(value, "text") == 0) options->format = FORMAT_TEXT;
+            else if(strcmp(value, "csv") == 0) options->format = FORMAT_CSV;
+            else if(strcmp(value, "json") == 0) options->format = FORMAT_JSON;
+            else
+            {
+                printf("Unknown format: %s\n", value);
+                return 0;
+            }
+        }
+        else if(strcmp(option, "--selfplay") == 0)
         {
-            int col_complete = 1;
-            for(int row = 0; row < 5; row++)
+            // --selfplay <games> followed by the bots up to the next option
+            options->no_of_games = atol(value);
+            options->no_of_seats = 0;
+            while(i + 2 < argc && strncmp(argv[i + 2], "--", 2) != 0 && options->no_of_seats < MAX_PLAYERS)
             {
-                if(info->players[p].mat.portugese_wall[row][col] != BLOCKED)
+                int type = bot_type_from_name(argv[i + 2]);
+                if(type == -1)
                 {
-                    col_complete = 0;
-                    break;
+                    printf("Unknown bot: %s\n", argv[i + 2]);
+                    return 0;
                 }
+                options->seats[options->no_of_seats++] = type;
+                i++;
             }
-            if(col_complete)
+        }
+        i += used_value;
+    }
+
+    if(options->no_of_seats > 0)
+    {
+        if(options->no_of_players == 0)
+        {
+            options->no_of_players = options->no_of_seats;
+        }
+        if(options->no_of_players != options->no_of_seats)
+        {
+            printf("--players and --seats disagree\n");
+            return 0;
+        }
+    }
+    if(options->no_of_names > 0 && options->no_of_players == 0)
+    {
+        options->no_of_players = options->no_of_names;
+    }
+    if(options->no_of_players != 0 && (options->no_of_players < 2 || options->no_of_players > MAX_PLAYERS))
+    {
+        printf("Invalid number of players! Must be 2-4.\n");
+        return 0;
+    }
+    if(options->no_of_names > 0 && options->no_of_names != options->no_of_players)
+    {
+        printf("--names needs one name per player\n");
+        return 0;
+    }
+
+    options->is_batch = options->no_of_seats > 0;
+    for(int p = 0; p < options->no_of_seats; p++)
+    {
+        if(options->seats[p] == SEAT_HUMAN)
+        {
+            options->is_batch = 0;
+        }
+    }
+    if(options->no_of_games != 0 && !options->is_batch)
+    {
+        printf("--games needs a bot on every seat\n");
+        return 0;
+    }
+    if(options->no_of_games < 0)
+    {
+        printf("--games must be positive\n");
+        return 0;
+    }
+    if(options->is_batch && options->no_of_games == 0)
+    {
+        options->no_of_games = 1;
+    }
+    if(options->archive_path != NULL && !options->is_batch)
+    {
+        printf("--archive needs a bot on every seat\n");
+        return 0;
+    }
+    if(options->is_lockstep)
+    {
+        for(int p = 0; p < options->no_of_seats; p++)
+        {
+            if(options->seats[p] != BOT_RANDOM)
             {
-                complete_cols++;
-                bonus_points += 7;
+                printf("--lockstep plays random bots only\n");
+                return 0;
             }
         }
-        if(complete_cols > 0)
+        if(!options->is_batch)
         {
-            printf("  %d complete column(s): +%d points\n", complete_cols, complete_cols * 7);
+            printf("--lockstep needs --seats with a random bot on every seat\n");
+            return 0;
         }
-        
-        // Bonus for complete colors (10 points each)
-        // Define where each color appears on the Portuguese wall
-        int color_positions[5][5][2] = {
-            {{0,0}, {1,1}, {2,2}, {3,3}, {4,4}}, // Blue diagonal
-            {{0,2}, {1,3}, {2,4}, {3,0}, {4,1}}, // Red
-            {{0,3}, {1,4}, {2,0}, {3,1}, {4,2}}, // Black  
-            {{0,1}, {1,2}, {2,3}, {3,4}, {4,0}}, // Yellow
-            {{0,4}, {1,0}, {2,1}, {3,2}, {4,3}}  // White
-        };
-        
-        const char* color_names[] = {"Blue", "Red", "Black", "Yellow", "White"};
-        int complete_colors = 0;
-        
-        for(int color = 0; color < 5; color++)
+        if(options->archive_path != NULL)
+        {
+            printf("--lockstep keeps no moves to --archive\n");
+            return 0;
+        }
+    }
+    if(options->record_path != NULL && options->is_batch)
+    {
+        printf("--record is for games with a human seat, use --archive\n");
+        return 0;
+    }
+    return 1;
+}
+
+void print_game_results(const Options* options, const Game_result* results)
+{
+    if(options->format == FORMAT_CSV)
+    {
+        printf("game,seed,rounds,finished,winner");
+        for(int p = 0; p < options->no_of_players; p++)
         {
-            int color_complete = 1;
-            for(int i = 0; i < 5; i++)
+            printf(",score%d", p + 1);
+        }
+        printf("\n");
+    }
+
+    for(long i = 0; i < options->no_of_games; i++)
+    {
+        const Game_result* result = &results[i];
+        // Winners are numbered from 1 like the seats, 0 is a tie
+        if(options->format == FORMAT_CSV)
+        {
+            printf("%ld,%llu,%d,%d,%d", i, (unsigned long long)result->seed,
+                   result->rounds, result->finished, result->winner + 1);
+            for(int p = 0; p < options->no_of_players; p++)
             {
-                int row = color_positions[color][i][0];
-                int col = color_positions[color][i][1];
-                if(info->players[p].mat.portugese_wall[row][col] != BLOCKED)
-                {
-                    color_complete = 0;
-                    break;
-                }
+                printf(",%u", result->scores[p]);
             }
-            if(color_complete)
+            printf("\n");
+        }
+        else
+        {
+            printf("{\"game\":%ld,\"seed\":%llu,\"rounds\":%d,\"finished\":%s,\"winner\":%d,\"scores\":[",
+                   i, (unsigned long long)result->seed, result->rounds,
+                   result->finished ? "true" : "false", result->winner + 1);
+            for(int p = 0; p < options->no_of_players; p++)
             {
-                printf("  Complete %s set: +10 points\n", color_names[color]);
-                complete_colors++;
-                bonus_points += 10;
+                printf(p > 0 ? ",%u" : "%u", result->scores[p]);
             }
+            printf("]}\n");
         }
-        
-        info->players[p].mat.score += bonus_points;
-        printf("  Total bonus: +%d points\n", bonus_points);
-        printf("  Final score: %d\n\n", info->players[p].mat.score);
     }
 }
 
-void determine_winner(Game* info)
+// Plays every game between bots without asking anything
+int run_batch(const Options* options)
 {
-    printf("\n=== FINAL RESULTS ===\n\n");
-    
-    int highest_score = -1;
-    int winner_idx = -1;
-    int tie = 0;
-    
-    // Find highest score
-    for(int p = 0; p < info->no_of_players; p++)
+    Selfplay_config config;
+    Selfplay_stats stats;
+
+    config.no_of_players = options->no_of_players;
+    config.no_of_games = options->no_of_games;
+    config.no_of_threads = options->no_of_threads;
+    config.seed = options->seed;
+    config.results = NULL;
+    config.archive = NULL;
+    for(int p = 0; p < config.no_of_players; p++)
     {
-        printf("%s: %u points\n", info->players[p].player_name, info->players[p].mat.score);
-        
-        if(info->players[p].mat.score > highest_score)
+        default_bot(&config.seats[p], options->seats[p]);
+    }
+    if(options->format != FORMAT_TEXT)
+    {
+        config.results = malloc(sizeof(Game_result) * config.no_of_games);
+        if(config.results == NULL)
         {
-            highest_score = info->players[p].mat.score;
-            winner_idx = p;
-            tie = 0;
+            printf("Not enough memory for %ld game results\n", config.no_of_games);
+            return EXIT_FAILURE;
         }
-        else if(info->players[p].mat.score == highest_score)
+    }
+
+    Archive_writer archive;
+    if(options->archive_path != NULL)
+    {
+        if(!archive_open_writer(&archive, options->archive_path))
         {
-            tie = 1;
+            printf("Cannot append to the archive %s\n", options->archive_path);
+            free(config.results);
+            return EXIT_FAILURE;
         }
+        config.archive = &archive;
     }
-    
-    if(tie)
+
+    if(options->is_lockstep)
     {
-        printf("\nIt's a tie at %d points!\n", highest_score);
-        printf("Tiebreaker: Player with most complete rows wins.\n");
-        // In a full implementation, you'd count complete rows for tiebreaker
+        if(!run_lockstep_batch(&config, &stats))
+        {
+            printf("Not enough memory for the lockstep blocks\n");
+            free(config.results);
+            return EXIT_FAILURE;
+        }
+        if(options->format == FORMAT_TEXT)
+        {
+            printf("Lockstep blocks of %d games\n", LOCKSTEP_GAMES);
+        }
     }
     else
     {
-        printf("\n🎉 %s WINS with %d points! 🎉\n", 
-               info->players[winner_idx].player_name, highest_score);
+        run_selfplay_batch(&config, &stats);
     }
-}
-
-void set_players_name(Game* info)
-{
-    if(info->no_of_players > 1 && info->no_of_players < 5)
+    // A failed fwrite() rarely makes fclose() fail, so count the games
+    int archived = 1;
+    if(config.archive != NULL)
     {
-        printf("GOOD! Now set player names:\n");
-        int i = 0;
-        while(i < info->no_of_players)
+        long written = config.archive->games_written;
+        archived = archive_close_writer(config.archive) && written == stats.games && stats.unarchived_games == 0;
+        if(!archived)
         {
-            printf("Name for Player %d: ", i+1);
-            scanf("%s", info->players[i].player_name);
-            i++;
+            printf("Could not write every game to %s\n", options->archive_path);
         }
     }
+    if(options->format == FORMAT_TEXT)
+    {
+        print_selfplay_stats(stdout, &config, &stats);
+    }
     else
     {
-        printf("Invalid number of players! Must be 2-4.\n");
-        exit(EXIT_FAILURE);
+        print_game_results(options, config.results);
     }
+    free(config.results);
+    return archived ? 0 : EXIT_FAILURE;
 }
 
-void print_title() 
-{  
-    printf("\n\n\n");                                         
-    printf(" @@@@@@   @@@@@@@@  @@@  @@@  @@@       \n");
-    printf("@@@@@@@@  @@@@@@@@  @@@  @@@  @@@       \n");
-    printf("@@!  @@@       @@!  @@!  @@@  @@!       \n");
-    printf("!@!  @!@      !@!   !@!  @!@  !@!       \n");
-    printf("@!@!@!@!     @!!    @!@  !@!  @!!       \n");
-    printf("!!!@!!!!    !!!     !@!  !!!  !!!       \n");
-    printf("!!:  !!!   !!:      !!:  !!!  !!:       \n");
-    printf(":!:  !:!  :!:       :!:  !:!   :!:      \n");
-    printf("::   :::   :: ::::  ::::: ::   :: ::::  \n");
-    printf(" :   : :  : :: : :   : :  :   : :: : :  \n");
-    printf("\n\n\n");  
-}
-
-void handle_round(Game* info)
+// Replays every archived game through the rules and checks its scores
+int run_archive_replay(const char* path)
 {
-    printf("\n=== STARTING NEW ROUND ===\n\n");
-    
-    initialise_factory_displays(info);
-    amplasete_tiles_on_a_factory(info);
-    initialise_middle_pile(info);
-    set_gameflow_round(info);
+    Archive_reader reader;
+    Archive_record record;
+    Game info;
+    long games = 0, mismatches = 0, moves = 0;
 
-    while (1)
+    if(!archive_open_reader(&reader, path))
     {
-        set_player_on_move(info);
-        print_factories(info);
-        
-        mid_pile_or_factory_selector(info);
+        printf("Cannot read the archive %s\n", path);
+        return EXIT_FAILURE;
+    }
 
-        if(info->flow.MidPile_or_factory_selector == 1)
-        {
-            what_pattern_line_are_avalibel_and_free_spaces(info);
-            amplasate_from_middle_pile_on_pattern_lines(info);
-        }
-        else if(info->flow.MidPile_or_factory_selector == 2)
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(archive_next(&reader, &record))
+    {
+        games++;
+        moves += record.header->no_of_moves;
+        if(!archive_replay_game(&record, &info))
         {
-            what_pattern_line_are_avalibel_and_free_spaces(info);
-            amplasate_on_pattern_line_or_mid_pile(info);
+            mismatches++;
+            LOG(LOG_NORMAL, "Game %ld (seed %llu) does not replay\n", games - 1,
+                (unsigned long long)record.header->seed);
         }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    printf("Replayed %ld games, %ld moves, %ld mismatches", games, moves, mismatches);
+    printf(" in %.2fs (%.0f games/sec)\n", seconds, seconds > 0 ? games / seconds : 0.0);
+    if(reader.offset != reader.size)
+    {
+        printf("The archive is damaged after byte %zu\n", reader.offset);
+        mismatches++;
+    }
+    archive_close_reader(&reader);
+    return mismatches == 0 ? 0 : EXIT_FAILURE;
+}
+
+int run_archive_to_notation(const char* path)
+{
+    Archive_reader reader;
+    Archive_record record;
+    long games = 0;
 
-        if (check_factories(info) && check_MidPile(info))
+    if(!archive_open_reader(&reader, path))
+    {
+        fprintf(stderr, "Cannot read the archive %s\n", path);
+        return EXIT_FAILURE;
+    }
+    while(archive_next(&reader, &record))
+    {
+        printf("# archived game %ld\n", games++);
+        if(!notation_write_archived_game(stdout, &record))
         {
-            printf("\n=== ROUND COMPLETE ===\n");
-            break;
+            fprintf(stderr, "Archived game %ld does not replay\n", games - 1);
+            archive_close_reader(&reader);
+            return EXIT_FAILURE;
         }
+    }
+    archive_close_reader(&reader);
+    return 0;
+}
+
+int run_notation_replay(const char* path)
+{
+    Notation_replay replay;
+    FILE* in = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if(in == NULL)
+    {
+        printf("Cannot read %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int ok = notation_replay_stream(in, &replay);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    if(in != stdin)
+    {
+        fclose(in);
+    }
 
-        set_gameflow_turn(info);
+    printf("Replayed %ld games, %ld moves, %ld lines in %.2fs (%.1f MB/s)\n",
+           replay.games, replay.moves, replay.lines, seconds,
+           seconds > 0 ? replay.bytes / seconds / 1e6 : 0.0);
+    if(!ok)
+    {
+        printf("%s:%ld: %s\n", path, replay.error_line, replay.error);
+        return EXIT_FAILURE;
     }
+    return 0;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-    srand(time(NULL));
+    Options options;
+    if(!parse_options(argc, argv, &options))
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(options.replay_path != NULL)
+    {
+        return run_archive_replay(options.replay_path);
+    }
+    if(options.convert_path != NULL)
+    {
+        return run_archive_to_notation(options.convert_path);
+    }
+    if(options.notation_path != NULL)
+    {
+        return run_notation_replay(options.notation_path);
+    }
+    if(options.serve_address != NULL)
+    {
+        return run_server(options.serve_address, options.seed);
+    }
+    if(options.is_batch)
+    {
+        return run_batch(&options);
+    }
+
     Game info;
+    Round_report round_report;
+    Bonus_report bonus_report;
+    int seats[MAX_PLAYERS] = {SEAT_HUMAN, SEAT_HUMAN, SEAT_HUMAN, SEAT_HUMAN};
+    Rng bot_rng;
+    static Renderer renderer;
+    Renderer* table = NULL;
     
     print_title();
     
-    printf("Choose number of players (2-4): ");
-    scanf("%d", &info.no_of_players);
+    info.no_of_players = options.no_of_players;
+    if(info.no_of_players == 0)
+    {
+        info.no_of_players = ask_number("Choose number of players (2-4): ", 2, MAX_PLAYERS);
+    }
 
-    set_players_name(&info);
-    fill_the_bag(&info.bag);
-    set_the_no_of_factories(&info);
-    initialise_mat(&info);
+    if(options.no_of_names > 0)
+    {
+        for(int p = 0; p < info.no_of_players; p++)
+        {
+            memcpy(info.players[p].player_name, options.names[p], MAX_PLAYER_NAME);
+        }
+    }
+    else
+    {
+        set_players_name(&info);
+    }
+    if(options.no_of_seats > 0)
+    {
+        memcpy(seats, options.seats, sizeof(seats));
+    }
+    else
+    {
+        set_computer_players(&info, seats);
+    }
+    init_game(&info, info.no_of_players, options.seed);
+    FILE* record = NULL;
+    if(options.record_path != NULL)
+    {
+        record = fopen(options.record_path, "w");
+        if(record == NULL)
+        {
+            printf("Cannot write %s\n", options.record_path);
+            return EXIT_FAILURE;
+        }
+        notation_write_game(record, info.no_of_players, &options.seed);
+    }
+    rng_seed(&bot_rng, derive_seed(options.seed, 1));
+    if(isatty(STDOUT_FILENO))
+    {
+        renderer_init(&renderer, STDOUT_FILENO);
+        table = &renderer;
+    }
     
     print_players_boards(&info);
 
     // Play rounds until game ends
-    int round_number = 1;
     int game_ended = 0;
     
     while(!game_ended)
     {
-        printf("\n\n");
-        printf("╔════════════════════════════════════════╗\n");
-        printf("║         ROUND %d STARTING              ║\n", round_number);
-        printf("╔════════════════════════════════════════╗\n");
-        printf("\n");
+        LOG(LOG_NORMAL, "\n\n");
+        LOG(LOG_NORMAL, "╔════════════════════════════════════════╗\n");
+        LOG(LOG_NORMAL, "║         ROUND %d STARTING              ║\n", info.flow.round_number + 1);
+        LOG(LOG_NORMAL, "╔════════════════════════════════════════╗\n");
+        LOG(LOG_NORMAL, "\n");
         
         // Play one round
-        handle_round(&info);
+        handle_round(&info, seats, &bot_rng, table, record, options.endgame_seconds);
+        if(table != NULL)
+        {
+            // The reports below scroll the table away
+            renderer_invalidate(table);
+        }
         
         // Process end of round (move tiles, calculate scores)
-        process_end_of_round(&info);
+        process_end_of_round(&info, &round_report);
+        if(LOG_ENABLED(LOG_NORMAL))
+        {
+            print_round_report(&info, &round_report);
+        }
         
         // Show updated boards
         print_players_boards(&info);
         
         // Check if game should end
         game_ended = check_game_end(&info);
-        
-        if(!game_ended)
+        if(game_ended)
         {
-            // Set up for next round - player with token goes first
-            for(int p = 0; p < info.no_of_players; p++)
-            {
-                if(info.players[p].is_token_present)
-                {
-                    info.flow.player_order[p] = -1; // Goes first
-                    info.players[p].is_token_present = 0; // Reset token
-                }
-                else
-                {
-                    info.flow.player_order[p] = 0;
-                }
-            }
-            round_number++;
+            int p = find_player_with_complete_row(&info);
+            LOG(LOG_NORMAL, "\n%s completed a row! Game ends after this round.\n", info.players[p].player_name);
         }
     }
     
     // Calculate final bonuses
-    calculate_final_bonuses(&info);
+    calculate_final_bonuses(&info, &bonus_report);
+    if(LOG_ENABLED(LOG_NORMAL))
+    {
+        print_bonus_report(&info, &bonus_report);
+    }
     
     // Determine winner
     determine_winner(&info);
+    if(record != NULL)
+    {
+        notation_write_end(record, &info);
+        fclose(record);
+    }
     
     printf("\nThank you for playing AZUL!\n\n");
     
     return 0;
-}
\ No newline at end of file
+}
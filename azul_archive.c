@@ -0,0 +1,269 @@
+/*AZUL BOARD GAME - Binary game archive
+See azul_archive.h.
+*/
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "azul_archive.h"
+
+#define RECORD_ALIGNMENT 8
+
+// Returns the number of bytes written to `out` (1 or 2)
+int archive_pack_move(Move move, uint8_t* out)
+{
+    int index = move_to_index(move);
+    if(index < 0x80)
+    {
+        out[0] = (uint8_t)index;
+        return 1;
+    }
+    out[0] = (uint8_t)(0x80 | (index >> 8));
+    out[1] = (uint8_t)(index & 0xFF);
+    return 2;
+}
+
+// Reads one move and moves the cursor past it
+Move archive_unpack_move(const uint8_t** cursor)
+{
+    const uint8_t* in = *cursor;
+    int index;
+    if(in[0] < 0x80)
+    {
+        index = in[0];
+        *cursor = in + 1;
+    }
+    else
+    {
+        index = ((in[0] & 0x7F) << 8) | in[1];
+        *cursor = in + 2;
+    }
+    return move_from_index(index);
+}
+
+static void make_file_header(uint8_t header[ARCHIVE_HEADER_SIZE])
+{
+    uint32_t version = ARCHIVE_VERSION;
+    memset(header, 0, ARCHIVE_HEADER_SIZE);
+    memcpy(header, ARCHIVE_MAGIC, 8);
+    memcpy(header + 8, &version, sizeof(version));
+}
+
+// Opens `path` for appending, creating it if needed. Returns 0 if it
+// cannot be opened or is not an archive (or ends with a partial record).
+int archive_open_writer(Archive_writer* writer, const char* path)
+{
+    uint8_t expected[ARCHIVE_HEADER_SIZE];
+    uint8_t found[ARCHIVE_HEADER_SIZE];
+
+    make_file_header(expected);
+    writer->file = fopen(path, "a+b");
+    writer->games_written = 0;
+    if(writer->file == NULL)
+    {
+        return 0;
+    }
+
+    long size = fseek(writer->file, 0, SEEK_END) == 0 ? ftell(writer->file) : -1;
+    int is_archive;
+    if(size == 0)
+    {
+        is_archive = fwrite(expected, 1, ARCHIVE_HEADER_SIZE, writer->file) == ARCHIVE_HEADER_SIZE;
+    }
+    else
+    {
+        // A write may not follow a read without a seek in between
+        is_archive = size > 0 && size % RECORD_ALIGNMENT == 0 && fseek(writer->file, 0, SEEK_SET) == 0 &&
+                     fread(found, 1, ARCHIVE_HEADER_SIZE, writer->file) == ARCHIVE_HEADER_SIZE &&
+                     memcmp(found, expected, ARCHIVE_HEADER_SIZE) == 0 && fseek(writer->file, 0, SEEK_END) == 0;
+    }
+    if(!is_archive)
+    {
+        fclose(writer->file);
+        writer->file = NULL;
+        return 0;
+    }
+    pthread_mutex_init(&writer->lock, NULL);
+    return 1;
+}
+
+// Appends one game with a single fwrite(), safe to call from several
+// threads; records follow the order in which the games were written
+int archive_write_game(Archive_writer* writer, const Archive_game* game)
+{
+    if(game->no_of_moves > ARCHIVE_MAX_MOVES)
+    {
+        return 0;
+    }
+
+    size_t max_size = sizeof(Archive_record_header) + 2 * game->no_of_moves + RECORD_ALIGNMENT;
+    uint8_t* record = calloc(1, max_size);
+    if(record == NULL)
+    {
+        return 0;
+    }
+
+    uint8_t* moves = record + sizeof(Archive_record_header);
+    size_t moves_size = 0;
+    for(long i = 0; i < game->no_of_moves; i++)
+    {
+        moves_size += archive_pack_move(game->moves[i], moves + moves_size);
+    }
+
+    Archive_record_header header;
+    memset(&header, 0, sizeof(header));
+    header.seed = game->seed;
+    header.size = (uint32_t)((sizeof(header) + moves_size + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT);
+    header.no_of_moves = (uint16_t)game->no_of_moves;
+    header.moves_size = (uint16_t)moves_size;
+    header.no_of_players = (uint8_t)game->no_of_players;
+    header.rounds = (uint8_t)game->rounds;
+    header.finished = (uint8_t)game->finished;
+    for(int p = 0; p < game->no_of_players; p++)
+    {
+        header.scores[p] = (uint16_t)game->scores[p];
+        header.seats[p] = game->seats[p] < 0 ? ARCHIVE_SEAT_HUMAN : (uint8_t)game->seats[p];
+    }
+    memcpy(record, &header, sizeof(header));
+
+    pthread_mutex_lock(&writer->lock);
+    int written = fwrite(record, 1, header.size, writer->file) == header.size;
+    writer->games_written += written;
+    pthread_mutex_unlock(&writer->lock);
+
+    free(record);
+    return written;
+}
+
+// Returns 0 if the last records could not be written
+int archive_close_writer(Archive_writer* writer)
+{
+    int closed = fclose(writer->file) == 0;
+    writer->file = NULL;
+    pthread_mutex_destroy(&writer->lock);
+    return closed;
+}
+
+// Maps the whole archive read-only. Returns 0 if it cannot be mapped or
+// does not start with the archive header.
+int archive_open_reader(Archive_reader* reader, const char* path)
+{
+    uint8_t expected[ARCHIVE_HEADER_SIZE];
+    struct stat file_stat;
+
+    reader->data = NULL;
+    reader->size = 0;
+    reader->offset = ARCHIVE_HEADER_SIZE;
+
+    int fd = open(path, O_RDONLY);
+    if(fd == -1)
+    {
+        return 0;
+    }
+    if(fstat(fd, &file_stat) == -1 || file_stat.st_size < ARCHIVE_HEADER_SIZE)
+    {
+        close(fd);
+        return 0;
+    }
+
+    void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        return 0;
+    }
+    madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+    reader->data = data;
+    reader->size = file_stat.st_size;
+
+    make_file_header(expected);
+    if(memcmp(reader->data, expected, ARCHIVE_HEADER_SIZE) != 0)
+    {
+        archive_close_reader(reader);
+        return 0;
+    }
+    return 1;
+}
+
+// Points `record` at the next game. Returns 0 at the end of the archive
+// or at a damaged record.
+int archive_next(Archive_reader* reader, Archive_record* record)
+{
+    size_t left = reader->size - reader->offset;
+    if(left < sizeof(Archive_record_header))
+    {
+        return 0;
+    }
+
+    const Archive_record_header* header = (const Archive_record_header*)(reader->data + reader->offset);
+    if(header->size > left || header->size % RECORD_ALIGNMENT != 0 ||
+       header->size < sizeof(Archive_record_header) + header->moves_size ||
+       header->no_of_players < 2 || header->no_of_players > MAX_PLAYERS)
+    {
+        return 0;
+    }
+
+    record->header = header;
+    record->moves = (const uint8_t*)(header + 1);
+    reader->offset += header->size;
+    return 1;
+}
+
+void archive_close_reader(Archive_reader* reader)
+{
+    if(reader->data != NULL)
+    {
+        munmap((void*)reader->data, reader->size);
+    }
+    reader->data = NULL;
+    reader->size = 0;
+}
+
+// Plays the record again from its seed with the same round flow as
+// self-play. Returns 0 if a move is illegal, the moves do not match the
+// rounds or the final scores differ; `info` holds the final position.
+int archive_replay_game(const Archive_record* record, Game* info)
+{
+    const Archive_record_header* header = record->header;
+    const uint8_t* cursor = record->moves;
+    const uint8_t* end = record->moves + header->moves_size;
+    long moves_left = header->no_of_moves;
+
+    memset(info, 0, sizeof(*info));
+    init_game(info, header->no_of_players, header->seed);
+    for(int round = 0; round < header->rounds; round++)
+    {
+        start_round(info);
+        while(!is_round_over(info))
+        {
+            if(moves_left == 0 || cursor >= end || (cursor[0] >= 0x80 && cursor + 1 >= end))
+            {
+                return 0;
+            }
+            moves_left--;
+            if(!apply_move(info, archive_unpack_move(&cursor)))
+            {
+                return 0;
+            }
+        }
+        process_end_of_round(info, NULL);
+    }
+    if(moves_left != 0 || !check_game_end(info) != !header->finished)
+    {
+        return 0;
+    }
+    calculate_final_bonuses(info, NULL);
+
+    for(int p = 0; p < header->no_of_players; p++)
+    {
+        if(info->players[p].mat.score != header->scores[p])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,94 @@
+/*AZUL BOARD GAME - Binary game archive
+
+Finished games stored back to back in one append-only file. A record
+holds the game seed, the seats, the final scores and every move packed
+into one byte (move index below 128) or two. The seed fixes every
+factory fill, so replaying the moves with archive_replay_game() rebuilds
+the whole game.
+
+The reader maps the file and hands out records that point into the
+mapping, nothing is copied. Records start on 8-byte boundaries so their
+headers can be read in place. Numbers are stored in the byte order of
+the machine that wrote them (little endian on every target we use).
+*/
+
+#ifndef AZUL_ARCHIVE_H
+#define AZUL_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "azul_rules.h"
+
+#define ARCHIVE_MAGIC "AZULARC1"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE 16
+#define ARCHIVE_SEAT_HUMAN 255
+#define ARCHIVE_MAX_MOVES 65535
+
+typedef struct
+{
+    uint64_t seed;
+    uint32_t size;                  // bytes of the whole record, padding included
+    uint16_t no_of_moves;
+    uint16_t moves_size;            // bytes of the packed moves after the header
+    uint16_t scores[MAX_PLAYERS];
+    uint8_t no_of_players;
+    uint8_t seats[MAX_PLAYERS];     // bot type or ARCHIVE_SEAT_HUMAN
+    uint8_t rounds;
+    uint8_t finished;               // 0 if the game was stopped early
+    uint8_t reserved;
+}Archive_record_header;
+
+_Static_assert(sizeof(Archive_record_header) == 32, "archive record header must stay 32 bytes");
+
+// A game to write
+typedef struct
+{
+    uint64_t seed;
+    int no_of_players;
+    int seats[MAX_PLAYERS];
+    unsigned int scores[MAX_PLAYERS];
+    int rounds;
+    int finished;
+    const Move* moves;
+    long no_of_moves;
+}Archive_game;
+
+// A game read in place from the mapping
+typedef struct
+{
+    const Archive_record_header* header;
+    const uint8_t* moves;
+}Archive_record;
+
+typedef struct
+{
+    FILE* file;
+    pthread_mutex_t lock;           // games may be written from several threads
+    long games_written;
+}Archive_writer;
+
+typedef struct
+{
+    const uint8_t* data;
+    size_t size;
+    size_t offset;                  // of the next record
+}Archive_reader;
+
+int archive_pack_move(Move move, uint8_t* out);
+Move archive_unpack_move(const uint8_t** cursor);
+
+int archive_open_writer(Archive_writer* writer, const char* path);
+int archive_write_game(Archive_writer* writer, const Archive_game* game);
+int archive_close_writer(Archive_writer* writer);
+
+int archive_open_reader(Archive_reader* reader, const char* path);
+int archive_next(Archive_reader* reader, Archive_record* record);
+void archive_close_reader(Archive_reader* reader);
+
+int archive_replay_game(const Archive_record* record, Game* info);
+
+#endif
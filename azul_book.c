@@ -0,0 +1,211 @@
+/*AZUL BOARD GAME - Opening book
+See azul_book.h.
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "azul_book.h"
+
+const Book* default_book = NULL;
+
+// Returns 1 before the first move of the game
+int is_book_position(const Game* info)
+{
+    return info->flow.round_number == 1 && info->flow.selections_until_round_finish == 0;
+}
+
+// The tiles of a factory as one number, the same for any order
+static int factory_code(const Game* info, int factory)
+{
+    int code = 0;
+    for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+    {
+        int tile = info->factory_displays.all_factories[factory][j];
+        if(tile >= 0 && tile < HOW_MANY_TILES_TYPES)
+        {
+            code += 1 << (3 * tile);
+        }
+    }
+    return code;
+}
+
+// Fills `order` with the factories sorted by their tiles (ties by index)
+// and returns the key of that order
+uint64_t book_key(const Game* info, int order[MAX_NUMBER_OF_FACTORIES])
+{
+    int codes[MAX_NUMBER_OF_FACTORIES];
+    int n = info->no_of_factory_displays;
+
+    for(int f = 0; f < n; f++)
+    {
+        codes[f] = factory_code(info, f);
+        int i = f;
+        for(; i > 0 && codes[order[i - 1]] > codes[f]; i--)
+        {
+            order[i] = order[i - 1];
+        }
+        order[i] = f;
+    }
+
+    uint64_t key = derive_seed(BOOK_VERSION, info->no_of_players);
+    for(int i = 0; i < n; i++)
+    {
+        key = derive_seed(key, codes[order[i]]);
+    }
+    return key;
+}
+
+// Returns 0 unless `info` is a book position and `move` takes from a factory
+int book_make_entry(const Game* info, Move move, double value, Book_entry* entry)
+{
+    int order[MAX_NUMBER_OF_FACTORIES];
+    if(!is_book_position(info) || move.source < 0)
+    {
+        return 0;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    entry->key = book_key(info, order);
+    for(int i = 0; i < info->no_of_factory_displays; i++)
+    {
+        if(order[i] == move.source)
+        {
+            entry->factory = i;
+        }
+    }
+    double tenths = value * 10;
+    entry->value = tenths > 32767 ? 32767 : (tenths < -32767 ? -32767 : (int16_t)tenths);
+    entry->color = move.color;
+    entry->pattern_line = move.pattern_line;
+    return 1;
+}
+
+static int compare_entries(const void* a, const void* b)
+{
+    uint64_t key_a = ((const Book_entry*)a)->key;
+    uint64_t key_b = ((const Book_entry*)b)->key;
+    return key_a < key_b ? -1 : key_a > key_b;
+}
+
+// Sorts the entries and writes them, the first of equal keys is kept
+int book_write(const char* path, Book_entry* entries, long no_of_entries)
+{
+    uint8_t header[BOOK_HEADER_SIZE];
+    uint32_t version = BOOK_VERSION;
+    uint32_t count = 0;
+
+    qsort(entries, no_of_entries, sizeof(Book_entry), compare_entries);
+    for(long i = 0; i < no_of_entries; i++)
+    {
+        if(count == 0 || entries[i].key != entries[count - 1].key)
+        {
+            entries[count++] = entries[i];
+        }
+    }
+
+    FILE* out = fopen(path, "wb");
+    if(out == NULL)
+    {
+        return 0;
+    }
+    memcpy(header, BOOK_MAGIC, 8);
+    memcpy(header + 8, &version, sizeof(version));
+    memcpy(header + 12, &count, sizeof(count));
+    int ok = fwrite(header, 1, BOOK_HEADER_SIZE, out) == BOOK_HEADER_SIZE &&
+             fwrite(entries, sizeof(Book_entry), count, out) == count;
+    return fclose(out) == 0 && ok;
+}
+
+// Maps the whole book read-only. Returns 0 if it cannot be mapped or is
+// not a book.
+int book_open(Book* book, const char* path)
+{
+    struct stat file_stat;
+    uint32_t version, count;
+
+    memset(book, 0, sizeof(*book));
+    int fd = open(path, O_RDONLY);
+    if(fd == -1)
+    {
+        return 0;
+    }
+    if(fstat(fd, &file_stat) == -1 || file_stat.st_size < BOOK_HEADER_SIZE)
+    {
+        close(fd);
+        return 0;
+    }
+
+    void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        return 0;
+    }
+    madvise(data, file_stat.st_size, MADV_RANDOM);
+    book->data = data;
+    book->size = file_stat.st_size;
+
+    memcpy(&version, book->data + 8, sizeof(version));
+    memcpy(&count, book->data + 12, sizeof(count));
+    if(memcmp(book->data, BOOK_MAGIC, 8) != 0 || version != BOOK_VERSION ||
+       book->size != BOOK_HEADER_SIZE + (size_t)count * sizeof(Book_entry))
+    {
+        book_close(book);
+        return 0;
+    }
+    book->entries = (const Book_entry*)(book->data + BOOK_HEADER_SIZE);
+    book->no_of_entries = count;
+    return 1;
+}
+
+// Returns 0 if `info` is not the first move of a game, is not in the book
+// or the book move is not legal there
+int book_lookup(const Book* book, const Game* info, Move* move)
+{
+    int order[MAX_NUMBER_OF_FACTORIES];
+    if(!is_book_position(info))
+    {
+        return 0;
+    }
+
+    uint64_t key = book_key(info, order);
+    long low = 0, high = book->no_of_entries;
+    while(low < high)
+    {
+        long middle = low + (high - low) / 2;
+        if(book->entries[middle].key < key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    if(low == book->no_of_entries || book->entries[low].key != key ||
+       book->entries[low].factory >= info->no_of_factory_displays)
+    {
+        return 0;
+    }
+
+    const Book_entry* entry = &book->entries[low];
+    move->source = order[entry->factory];
+    move->color = entry->color;
+    move->pattern_line = entry->pattern_line;
+    return is_move_legal(info, *move);
+}
+
+void book_close(Book* book)
+{
+    if(book->data != NULL)
+    {
+        munmap((void*)book->data, book->size);
+    }
+    memset(book, 0, sizeof(*book));
+}
@@ -0,0 +1,66 @@
+/*AZUL BOARD GAME - Opening book
+
+Best first moves of the game, searched ahead of time. Every mat starts
+empty, the middle pile holds only the token and the bag holds what the
+factories did not take, so the first move of a game depends on nothing
+but the number of players and the tiles on the factories. Factories are
+interchangeable: a position is keyed by a hash of the player count and
+the factory contents in sorted order, and a book move names its factory
+by its place in that order. Factories with the same tiles are the same
+move.
+
+The book is a sorted array of entries after a 16-byte header ("AZULBOK1",
+version, number of entries), mapped read-only and binary searched, so
+any number of games and threads can share one mapping. Numbers are in
+the byte order of the machine that wrote the file.
+
+tools/azul_book.c searches the openings of chosen game seeds and writes
+the book. book_lookup() answers only the first move of a game, and only
+with a move that is legal there.
+*/
+
+#ifndef AZUL_BOOK_H
+#define AZUL_BOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "azul_rules.h"
+
+#define BOOK_MAGIC "AZULBOK1"
+#define BOOK_VERSION 1
+#define BOOK_HEADER_SIZE 16
+
+typedef struct
+{
+    uint64_t key;
+    int16_t value;          // search value of the move, tenths of a point
+    uint8_t factory;        // place of the source in the sorted factories
+    uint8_t color;
+    int8_t pattern_line;
+    uint8_t reserved[3];
+}Book_entry;
+
+_Static_assert(sizeof(Book_entry) == 16, "book entries must stay 16 bytes");
+
+typedef struct
+{
+    const uint8_t* data;
+    size_t size;
+    const Book_entry* entries;
+    long no_of_entries;
+}Book;
+
+// The book of the bots unless they are given another, NULL = none
+extern const Book* default_book;
+
+int is_book_position(const Game* info);
+uint64_t book_key(const Game* info, int order[MAX_NUMBER_OF_FACTORIES]);
+int book_make_entry(const Game* info, Move move, double value, Book_entry* entry);
+int book_write(const char* path, Book_entry* entries, long no_of_entries);
+
+int book_open(Book* book, const char* path);
+int book_lookup(const Book* book, const Game* info, Move* move);
+void book_close(Book* book);
+
+#endif
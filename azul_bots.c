@@ -0,0 +1,151 @@
+/*AZUL BOARD GAME - Computer players
+See azul_bots.h.
+*/
+
+#include <string.h>
+
+#include "azul_bots.h"
+#include "azul_endgame.h"
+#include "azul_expectimax.h"
+#include "azul_mcts.h"
+
+static const char* bot_names[NO_OF_BOT_TYPES] = {"random", "greedy", "search", "expectimax"};
+
+const char* bot_name(int type)
+{
+    if(type < 0 || type >= NO_OF_BOT_TYPES)
+    {
+        return "unknown";
+    }
+    return bot_names[type];
+}
+
+// Returns -1 for an unknown name
+int bot_type_from_name(const char* name)
+{
+    for(int type = 0; type < NO_OF_BOT_TYPES; type++)
+    {
+        if(strcmp(name, bot_names[type]) == 0)
+        {
+            return type;
+        }
+    }
+    return -1;
+}
+
+void default_bot(Bot* bot, int type)
+{
+    bot->type = type;
+    bot->search_iterations = 2000;
+    bot->search_threads = 1;
+    bot->endgame_nodes = 20000;
+    bot->expectimax_depth = 4;
+    bot->chance_samples = 4;
+    bot->eval_weights = NULL;
+    bot->net = default_net;
+    bot->book = default_book;
+}
+
+// Immediate worth of a move: tiles that land on the pattern line, a bonus
+// for finishing it, minus what falls on the floor
+int greedy_move_value(const Game* info, Move move)
+{
+    const Mat* mat = &info->players[info->flow.player_on_move].mat;
+    int taken = count_tiles_in_source(info, move.source, move.color);
+    int value = 0;
+
+    if(move.source == MIDDLE_PILE && info->middle_pile.is_token_present)
+    {
+        value -= 1;
+    }
+    if(move.pattern_line == FLOOR_LINE)
+    {
+        return value - 3 * taken;
+    }
+
+    int free_spaces = move.pattern_line + 1 - pattern_line_count(mat, move.pattern_line);
+    int placed = taken < free_spaces ? taken : free_spaces;
+    value += 2 * placed - 3 * (taken - placed);
+    if(placed == free_spaces)
+    {
+        value += 3;
+    }
+    return value;
+}
+
+Move choose_bot_move(const Game* info, const Bot* bot, Rng* rng)
+{
+    Move moves[MAX_LEGAL_MOVES];
+    int no_of_moves = generate_legal_moves(info, moves);
+    Move book_move;
+
+    if((bot->type == BOT_SEARCH || bot->type == BOT_EXPECTIMAX) && bot->book != NULL &&
+       book_lookup(bot->book, info, &book_move))
+    {
+        return book_move;
+    }
+    if(bot->type == BOT_SEARCH && bot->endgame_nodes > 0 && is_final_round(info))
+    {
+        Endgame_config config;
+        Endgame_result result;
+        endgame_default_config(&config);
+        config.max_nodes = bot->endgame_nodes;
+        if(endgame_solve(info, &config, &result))
+        {
+            return result.best_move;
+        }
+        // Without its table the solver fails, MCTS moves instead
+    }
+    if(bot->type == BOT_SEARCH)
+    {
+        Mcts_config config;
+        Mcts_result result;
+        mcts_default_config(&config);
+        config.no_of_threads = bot->search_threads;
+        config.max_iterations = bot->search_iterations;
+        config.seed = rng_next(rng);
+        if(mcts_search(info, &config, &result))
+        {
+            return result.best_move;
+        }
+    }
+    else if(bot->type == BOT_EXPECTIMAX)
+    {
+        Expectimax_config config;
+        Expectimax_result result;
+        expectimax_default_config(&config);
+        config.depth = bot->expectimax_depth;
+        config.chance_samples = bot->chance_samples;
+        config.weights = bot->eval_weights;
+        config.net = bot->net;
+        config.seed = rng_next(rng);
+        if(expectimax_search(info, &config, &result))
+        {
+            return result.best_move;
+        }
+    }
+    else if(bot->type == BOT_GREEDY)
+    {
+        // Best value, ties broken at random
+        int best_value = 0;
+        int no_of_best = 0;
+        Move best = moves[0];
+        for(int i = 0; i < no_of_moves; i++)
+        {
+            int value = greedy_move_value(info, moves[i]);
+            if(no_of_best == 0 || value > best_value)
+            {
+                best_value = value;
+                best = moves[i];
+                no_of_best = 1;
+            }
+            else if(value == best_value && rng_below(rng, ++no_of_best) == 0)
+            {
+                best = moves[i];
+            }
+        }
+        return best;
+    }
+
+    return moves[rng_below(rng, no_of_moves)];
+}
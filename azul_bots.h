@@ -0,0 +1,44 @@
+/*AZUL BOARD GAME - Computer players
+
+Bots pick a move for the player on move without any terminal I/O, so
+the same code drives computer seats in the game and in batch self-play.
+*/
+
+#ifndef AZUL_BOTS_H
+#define AZUL_BOTS_H
+
+#include <stdint.h>
+
+#include "azul_book.h"
+#include "azul_eval.h"
+#include "azul_net.h"
+#include "azul_rules.h"
+
+#define BOT_RANDOM 0
+#define BOT_GREEDY 1
+#define BOT_SEARCH 2
+#define BOT_EXPECTIMAX 3
+#define NO_OF_BOT_TYPES 4
+
+typedef struct
+{
+    int type;
+    long search_iterations;   // BOT_SEARCH only
+    int search_threads;       // BOT_SEARCH only, 0 = all cores, more than 1
+                              // makes its moves depend on thread timing
+    long endgame_nodes;       // BOT_SEARCH only, budget of the final round
+                              // solver (azul_endgame.h), 0 = tree search
+    int expectimax_depth;     // BOT_EXPECTIMAX only, plies (azul_expectimax.h)
+    int chance_samples;       // BOT_EXPECTIMAX only, fills drawn per round end
+    const Eval_weights* eval_weights;  // BOT_EXPECTIMAX only, NULL = defaults
+    const Net* net;           // BOT_EXPECTIMAX only, corrects the weights, NULL = none
+    const Book* book;         // BOT_SEARCH and BOT_EXPECTIMAX, first move of the game
+}Bot;
+
+const char* bot_name(int type);
+int bot_type_from_name(const char* name);
+void default_bot(Bot* bot, int type);
+int greedy_move_value(const Game* info, Move move);
+Move choose_bot_move(const Game* info, const Bot* bot, Rng* rng);
+
+#endif
@@ -0,0 +1,256 @@
+/*AZUL BOARD GAME - Endgame solver
+See azul_endgame.h.
+*/
+
+#include <time.h>
+
+#include "azul_bots.h"
+#include "azul_endgame.h"
+#include "azul_tt.h"
+
+#define VALUE_INFINITY 100000
+// Depth stored for a result that no depth limit cut short
+#define SOLVED_DEPTH 0xFF
+// Nodes between two looks at the clock
+#define CHECK_EVERY_NODES 1024
+// Sorts the move of the table in front of every greedy value
+#define TT_MOVE_PRIORITY 1000
+
+typedef struct
+{
+    Game state;                    // searched in place, moves are undone
+    int root_player;
+    const Endgame_config* config;
+    Transposition_table table;
+    double deadline;               // 0 = no time limit
+    long nodes;
+    int can_stop;                  // only once an iteration is complete
+    int stop;
+}Endgame_search;
+
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void endgame_default_config(Endgame_config* config)
+{
+    config->max_seconds = 0;
+    config->max_nodes = 0;
+    config->tt_size_mb = 16;
+}
+
+// 1 if some player's wall row lacks one tile and the full pattern line of
+// that row will put it there at the end of this round
+int is_final_round(const Game* info)
+{
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        const Mat* mat = &info->players[p].mat;
+        for(int row = 0; row < 5; row++)
+        {
+            if(__builtin_popcount(mat->portugese_wall & WALL_ROW_MASK(row)) == 4 &&
+               pattern_line_count(mat, row) == row + 1)
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Final score lead of the root player if the round ended now
+static int evaluate_round_end(const Endgame_search* search)
+{
+    Game end = search->state;
+    process_end_of_round(&end, NULL);
+    calculate_final_bonuses(&end, NULL);
+
+    int best_other = -VALUE_INFINITY;
+    for(int p = 0; p < end.no_of_players; p++)
+    {
+        if(p != search->root_player && (int)end.players[p].mat.score > best_other)
+        {
+            best_other = end.players[p].mat.score;
+        }
+    }
+    return (int)end.players[search->root_player].mat.score - best_other;
+}
+
+static void order_moves(const Game* state, Move moves[], int no_of_moves, const Tt_entry* entry)
+{
+    int keys[MAX_LEGAL_MOVES];
+    for(int i = 0; i < no_of_moves; i++)
+    {
+        keys[i] = greedy_move_value(state, moves[i]);
+        if(entry != NULL && entry->has_best_move && move_to_index(moves[i]) == move_to_index(entry->best_move))
+        {
+            keys[i] += TT_MOVE_PRIORITY;
+        }
+    }
+    // Insertion sort, best first: lists are short and mostly in order
+    for(int i = 1; i < no_of_moves; i++)
+    {
+        Move move = moves[i];
+        int key = keys[i];
+        int j = i;
+        for(; j > 0 && keys[j - 1] < key; j--)
+        {
+            moves[j] = moves[j - 1];
+            keys[j] = keys[j - 1];
+        }
+        moves[j] = move;
+        keys[j] = key;
+    }
+}
+
+static void check_limits(Endgame_search* search)
+{
+    if(!search->can_stop)
+    {
+        return;
+    }
+    if(search->config->max_nodes > 0 && search->nodes >= search->config->max_nodes)
+    {
+        search->stop = 1;
+    }
+    if(search->deadline > 0 && search->nodes % CHECK_EVERY_NODES == 0 && now_in_seconds() >= search->deadline)
+    {
+        search->stop = 1;
+    }
+}
+
+// Fail-soft alpha-beta of the root player's lead, `depth` plies deep.
+// Sets *solved if no line was cut at the depth limit, the value is then
+// valid at any depth. `best_move` may be NULL.
+static int search_node(Endgame_search* search, int depth, int alpha, int beta, int* solved, Move* best_move)
+{
+    Game* state = &search->state;
+    if(is_round_over(state))
+    {
+        *solved = 1;
+        return evaluate_round_end(search);
+    }
+    if(depth == 0)
+    {
+        *solved = 0;
+        return evaluate_round_end(search);
+    }
+    search->nodes++;
+    check_limits(search);
+    if(search->stop)
+    {
+        *solved = 0;
+        return 0;
+    }
+
+    Tt_entry entry;
+    int has_entry = tt_probe(&search->table, state->hash, &entry);
+    if(has_entry && best_move == NULL && entry.depth >= depth &&
+       (entry.bound == TT_BOUND_EXACT ||
+        (entry.bound == TT_BOUND_LOWER && entry.value >= beta) ||
+        (entry.bound == TT_BOUND_UPPER && entry.value <= alpha)))
+    {
+        *solved = entry.depth == SOLVED_DEPTH;
+        return entry.value;
+    }
+
+    Move moves[MAX_LEGAL_MOVES];
+    int no_of_moves = generate_legal_moves(state, moves);
+    order_moves(state, moves, no_of_moves, has_entry ? &entry : NULL);
+
+    int maximising = state->flow.player_on_move == search->root_player;
+    int original_alpha = alpha;
+    int original_beta = beta;
+    int best = maximising ? -VALUE_INFINITY : VALUE_INFINITY;
+    int all_solved = 1;
+    Move best_here = moves[0];
+    for(int i = 0; i < no_of_moves && alpha < beta; i++)
+    {
+        Undo_record undo;
+        int child_solved;
+        apply_move_with_undo(state, moves[i], &undo);
+        int value = search_node(search, depth - 1, alpha, beta, &child_solved, NULL);
+        undo_move(state, &undo);
+        if(search->stop)
+        {
+            *solved = 0;
+            return 0;
+        }
+
+        all_solved &= child_solved;
+        if(maximising ? value > best : value < best)
+        {
+            best = value;
+            best_here = moves[i];
+        }
+        if(maximising && best > alpha)
+        {
+            alpha = best;
+        }
+        if(!maximising && best < beta)
+        {
+            beta = best;
+        }
+    }
+
+    int bound = TT_BOUND_EXACT;
+    if(best <= original_alpha)
+    {
+        bound = TT_BOUND_UPPER;
+    }
+    else if(best >= original_beta)
+    {
+        bound = TT_BOUND_LOWER;
+    }
+    tt_store(&search->table, state->hash, best, all_solved ? SOLVED_DEPTH : depth, bound, &best_here);
+    if(best_move != NULL)
+    {
+        *best_move = best_here;
+    }
+    *solved = all_solved;
+    return best;
+}
+
+// Returns 0 if there is nothing to search (round over) or the table could
+// not be allocated
+int endgame_solve(const Game* info, const Endgame_config* config, Endgame_result* result)
+{
+    Endgame_search search = {0};
+    if(is_round_over(info) || !tt_init(&search.table, config->tt_size_mb))
+    {
+        return 0;
+    }
+
+    double start = now_in_seconds();
+    search.state = *info;
+    search.root_player = info->flow.player_on_move;
+    search.config = config;
+    search.deadline = config->max_seconds > 0 ? start + config->max_seconds : 0;
+
+    result->depth = 0;
+    result->is_exact = 0;
+    for(int depth = 1; depth <= MAX_MOVES_PER_ROUND && !result->is_exact; depth++)
+    {
+        Move best_move;
+        int solved;
+        int value = search_node(&search, depth, -VALUE_INFINITY, VALUE_INFINITY, &solved, &best_move);
+        if(search.stop)
+        {
+            break;
+        }
+        result->best_move = best_move;
+        result->value = value;
+        result->depth = depth;
+        result->is_exact = solved;
+        search.can_stop = 1;
+    }
+
+    result->nodes = search.nodes;
+    result->seconds = now_in_seconds() - start;
+    result->nodes_per_second = result->seconds > 0 ? result->nodes / result->seconds : 0;
+    tt_free(&search.table);
+    return 1;
+}
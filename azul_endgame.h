@@ -0,0 +1,46 @@
+/*AZUL BOARD GAME - Endgame solver
+
+Once the game is certain to end with the current round (is_final_round),
+no more tiles come out of the bag and the rest of the game is a perfect
+information tree. endgame_solve() searches it with alpha-beta to the end
+of the round, every leaf scored with process_end_of_round() and
+calculate_final_bonuses().
+
+The value is the final score of the player on move minus the best other
+final score. That player maximises it and every other player minimises
+it, which is exact play with 2 players and the safe ("paranoid") choice
+with more. Iterative deepening gives an answer within the budget even
+when the tree is too big: a line cut at the depth limit is scored as if
+the round ended there, and the result says whether the search reached
+the end everywhere. Moves are tried best first (move of the previous
+iteration from the transposition table, then greedy_move_value()).
+*/
+
+#ifndef AZUL_ENDGAME_H
+#define AZUL_ENDGAME_H
+
+#include "azul_rules.h"
+
+typedef struct
+{
+    double max_seconds;   // 0 = no limit
+    long max_nodes;       // 0 = no limit, a node budget answers the same on every run
+    int tt_size_mb;
+}Endgame_config;
+
+typedef struct
+{
+    Move best_move;
+    int value;            // final score lead of the player on move with best play
+    int depth;            // plies of the last completed iteration
+    int is_exact;         // 1 if that iteration reached the end of the round everywhere
+    long nodes;
+    double seconds;
+    double nodes_per_second;
+}Endgame_result;
+
+int is_final_round(const Game* info);
+void endgame_default_config(Endgame_config* config);
+int endgame_solve(const Game* info, const Endgame_config* config, Endgame_result* result);
+
+#endif
@@ -0,0 +1,150 @@
+/*AZUL BOARD GAME - Heuristic evaluation
+See azul_eval.h.
+
+Weight files hold one "<feature> <weight>" pair per line, features left
+out keep their value.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "azul_eval.h"
+
+// Tiles of the wall that have a right neighbour (column 4 has none)
+#define WALL_NOT_LAST_COL 0x0F7BDEFu
+
+static const char* const feature_names[NO_OF_EVAL_FEATURES] = {
+    "projected", "partial", "adjacency", "floor", "rows", "cols", "colors"
+};
+
+Eval_weights default_eval_weights = {{1.0, 0.5, 0.25, 1.0, 0.5, 0.5, 0.5}};
+
+const char* eval_feature_name(int feature)
+{
+    return feature >= 0 && feature < NO_OF_EVAL_FEATURES ? feature_names[feature] : "unknown";
+}
+
+// Bonus progress: `bonus` times the square of the fraction of `mask` filled
+static double bonus_progress(unsigned int wall, unsigned int mask, int bonus)
+{
+    int filled = __builtin_popcount(wall & mask);
+    return bonus * filled * filled / 25.0;
+}
+
+void eval_features(const Game* info, int player, double features[NO_OF_EVAL_FEATURES])
+{
+    const Mat* mat = &info->players[player].mat;
+    unsigned int wall = mat->portugese_wall;
+
+    memset(features, 0, sizeof(double) * NO_OF_EVAL_FEATURES);
+    for(int row = 0; row < 5; row++)
+    {
+        int count = pattern_line_count(mat, row);
+        if(count == row + 1)
+        {
+            int col = wall_col_table[row][pattern_line_color(mat, row)];
+            wall |= WALL_BIT(row, col);
+            features[EVAL_PROJECTED] += wall_placement_score(wall, row, col);
+        }
+    }
+    // Partial lines are scored against the projected wall
+    for(int row = 0; row < 5; row++)
+    {
+        int count = pattern_line_count(mat, row);
+        if(count > 0 && count < row + 1)
+        {
+            int col = wall_col_table[row][pattern_line_color(mat, row)];
+            features[EVAL_PARTIAL] += wall_placement_score(wall | WALL_BIT(row, col), row, col) * count / (row + 1.0);
+        }
+    }
+
+    features[EVAL_ADJACENCY] = __builtin_popcount(wall & (wall >> 1) & WALL_NOT_LAST_COL) +
+                               __builtin_popcount(wall & (wall >> 5));
+    for(int slot = 0; slot < MAX_PENALTIES; slot++)
+    {
+        if(mat->penalties[slot] != AVAILABLE)
+        {
+            features[EVAL_FLOOR] += floor_penalties[slot];
+        }
+    }
+    for(int i = 0; i < 5; i++)
+    {
+        features[EVAL_ROWS] += bonus_progress(wall, WALL_ROW_MASK(i), 2);
+        features[EVAL_COLS] += bonus_progress(wall, wall_col_masks[i], 7);
+        features[EVAL_COLORS] += bonus_progress(wall, wall_color_masks[i], 10);
+    }
+}
+
+double evaluate_player(const Game* info, int player, const Eval_weights* weights)
+{
+    double features[NO_OF_EVAL_FEATURES];
+    double value = info->players[player].mat.score;
+    eval_features(info, player, features);
+    for(int i = 0; i < NO_OF_EVAL_FEATURES; i++)
+    {
+        value += weights->weights[i] * features[i];
+    }
+    return value;
+}
+
+// Worth of `player` minus the best worth of the others
+double evaluate_lead(const Game* info, int player, const Eval_weights* weights)
+{
+    double best_other = -1e9;
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        double value;
+        if(p != player && (value = evaluate_player(info, p, weights)) > best_other)
+        {
+            best_other = value;
+        }
+    }
+    return evaluate_player(info, player, weights) - best_other;
+}
+
+// Returns 0 if the file cannot be read or holds an unknown feature
+int load_eval_weights(const char* path, Eval_weights* weights)
+{
+    FILE* in = fopen(path, "r");
+    if(in == NULL)
+    {
+        return 0;
+    }
+
+    char line[128];
+    char name[32];
+    double weight;
+    int ok = 1;
+    while(ok && fgets(line, sizeof(line), in) != NULL)
+    {
+        if(line[0] == '#' || sscanf(line, "%31s", name) != 1)
+        {
+            continue;
+        }
+        ok = 0;
+        for(int i = 0; i < NO_OF_EVAL_FEATURES; i++)
+        {
+            if(strcmp(name, feature_names[i]) == 0 && sscanf(line, "%*s %lf", &weight) == 1)
+            {
+                weights->weights[i] = weight;
+                ok = 1;
+            }
+        }
+    }
+    fclose(in);
+    return ok;
+}
+
+int save_eval_weights(const char* path, const Eval_weights* weights)
+{
+    FILE* out = fopen(path, "w");
+    if(out == NULL)
+    {
+        return 0;
+    }
+    for(int i = 0; i < NO_OF_EVAL_FEATURES; i++)
+    {
+        fprintf(out, "%s %.4f\n", feature_names[i], weights->weights[i]);
+    }
+    return fclose(out) == 0;
+}
@@ -0,0 +1,51 @@
+/*AZUL BOARD GAME - Heuristic evaluation
+
+Static worth of a position in the middle of a round, so a search can stop
+a line early instead of playing it to the end of the round. A player is
+worth their score plus a weighted sum of features of their mat:
+
+    projected     points of the full pattern lines, placed on the wall
+                  in row order as process_end_of_round() will
+    partial       for each line that is started but not full, the
+                  points its tile would score times how full it is
+    adjacency     pairs of neighbouring tiles on the projected wall
+    floor         the floor_penalties[] of the occupied floor slots
+    rows, cols,   progress toward the end of game bonuses: each bonus
+    colors        (2, 7, 10) times the square of the fraction of its
+                  five tiles on the projected wall
+
+The weights are doubles so they can be tuned (tools/azul_tune.c).
+default_eval_weights starts with hand-set values and is what the bots
+use unless they are given other weights, load_eval_weights() reads a
+file written by the tuner into it.
+*/
+
+#ifndef AZUL_EVAL_H
+#define AZUL_EVAL_H
+
+#include "azul_rules.h"
+
+#define EVAL_PROJECTED 0
+#define EVAL_PARTIAL 1
+#define EVAL_ADJACENCY 2
+#define EVAL_FLOOR 3
+#define EVAL_ROWS 4
+#define EVAL_COLS 5
+#define EVAL_COLORS 6
+#define NO_OF_EVAL_FEATURES 7
+
+typedef struct
+{
+    double weights[NO_OF_EVAL_FEATURES];
+}Eval_weights;
+
+extern Eval_weights default_eval_weights;
+
+const char* eval_feature_name(int feature);
+void eval_features(const Game* info, int player, double features[NO_OF_EVAL_FEATURES]);
+double evaluate_player(const Game* info, int player, const Eval_weights* weights);
+double evaluate_lead(const Game* info, int player, const Eval_weights* weights);
+int load_eval_weights(const char* path, Eval_weights* weights);
+int save_eval_weights(const char* path, const Eval_weights* weights);
+
+#endif
@@ -0,0 +1,289 @@
+/*AZUL BOARD GAME - Expectimax search across rounds
+See azul_expectimax.h.
+*/
+
+#include <time.h>
+
+#include "azul_bots.h"
+#include "azul_expectimax.h"
+
+#define VALUE_INFINITY 1e9
+
+typedef struct
+{
+    const Expectimax_config* config;
+    const Eval_weights* weights;
+    const Net* net;
+    int root_player;
+    long nodes;
+    long chance_nodes;
+    int can_stop;                  // only once an iteration is complete
+    int stop;
+}Expectimax_search;
+
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void expectimax_default_config(Expectimax_config* config)
+{
+    config->depth = 4;
+    config->chance_samples = 4;
+    config->move_width = 12;
+    config->max_nodes = 0;
+    config->seed = 1;
+    config->weights = NULL;
+    config->net = NULL;
+}
+
+static double lead_of(const Game* state, int player)
+{
+    int best_other = -1;
+    for(int p = 0; p < state->no_of_players; p++)
+    {
+        if(p != player && (int)state->players[p].mat.score > best_other)
+        {
+            best_other = state->players[p].mat.score;
+        }
+    }
+    return (int)state->players[player].mat.score - best_other;
+}
+
+// Scores the round of `end`, and the bonuses if that ends the game.
+// Returns 1 if it does.
+static int score_round(Game* end)
+{
+    process_end_of_round(end, NULL);
+    if(check_game_end(end))
+    {
+        calculate_final_bonuses(end, NULL);
+        return 1;
+    }
+    return 0;
+}
+
+// Expected lead of the root player where the search stops, the network
+// corrects the weighted features
+static double evaluate_leaf(const Expectimax_search* search, const Game* state)
+{
+    if(search->net != NULL)
+    {
+        return evaluate_lead(state, search->root_player, search->weights) +
+               net_evaluate(search->net, state, search->root_player);
+    }
+    return evaluate_lead(state, search->root_player, search->weights);
+}
+
+// The `width` best moves by greedy value come first, returns how many to search
+static int order_moves(const Game* state, Move moves[], int no_of_moves, int width)
+{
+    int keys[MAX_LEGAL_MOVES];
+    for(int i = 0; i < no_of_moves; i++)
+    {
+        keys[i] = greedy_move_value(state, moves[i]);
+    }
+    for(int i = 1; i < no_of_moves; i++)
+    {
+        Move move = moves[i];
+        int key = keys[i];
+        int j = i;
+        for(; j > 0 && keys[j - 1] < key; j--)
+        {
+            moves[j] = moves[j - 1];
+            keys[j] = keys[j - 1];
+        }
+        moves[j] = move;
+        keys[j] = key;
+    }
+    return width > 0 && width < no_of_moves ? width : no_of_moves;
+}
+
+static double search_node(Expectimax_search* search, Game* state, int depth, double alpha, double beta,
+                          Move* best_move);
+
+// Average over sampled fills of the next round, the round of `state` is over
+static double chance_node(Expectimax_search* search, const Game* state, int depth)
+{
+    Game scored = *state;
+    if(score_round(&scored))
+    {
+        return lead_of(&scored, search->root_player);
+    }
+    if(depth == 0 || search->config->chance_samples <= 0)
+    {
+        return evaluate_leaf(search, &scored);
+    }
+
+    // The same position draws the same samples in every iteration
+    search->chance_nodes++;
+    double sum = 0;
+    for(int k = 0; k < search->config->chance_samples; k++)
+    {
+        Game next = scored;
+        rng_seed(&next.rng, derive_seed(search->config->seed ^ scored.hash, k));
+        start_round(&next);
+        sum += search_node(search, &next, depth - 1, -VALUE_INFINITY, VALUE_INFINITY, NULL);
+        if(search->stop)
+        {
+            return 0;
+        }
+    }
+    return sum / search->config->chance_samples;
+}
+
+// Every child is a leaf: the network's corrections of those that go on
+// with the round are evaluated in one batch, the others are scored
+static double search_last_ply(Expectimax_search* search, Game* state, const Move moves[], int no_of_moves,
+                              Move* best_move)
+{
+    _Alignas(NET_ALIGN) uint8_t inputs[MAX_LEGAL_MOVES][NET_INPUTS];
+    float net_values[MAX_LEGAL_MOVES];
+    double values[MAX_LEGAL_MOVES];
+    int batched[MAX_LEGAL_MOVES];
+    int no_of_batched = 0;
+
+    for(int i = 0; i < no_of_moves; i++)
+    {
+        Undo_record undo;
+        apply_move_with_undo(state, moves[i], &undo);
+        if(is_round_over(state))
+        {
+            values[i] = chance_node(search, state, 0);
+        }
+        else
+        {
+            values[i] = evaluate_lead(state, search->root_player, search->weights);
+            net_encode(state, search->root_player, inputs[no_of_batched]);
+            batched[no_of_batched++] = i;
+        }
+        undo_move(state, &undo);
+    }
+    if(no_of_batched > 0)
+    {
+        net_evaluate_batch(search->net, inputs[0], no_of_batched, net_values);
+    }
+    for(int k = 0; k < no_of_batched; k++)
+    {
+        values[batched[k]] += net_values[k];
+    }
+
+    int maximising = state->flow.player_on_move == search->root_player;
+    double best = maximising ? -VALUE_INFINITY : VALUE_INFINITY;
+    for(int i = 0; i < no_of_moves; i++)
+    {
+        if(maximising ? values[i] > best : values[i] < best)
+        {
+            best = values[i];
+            if(best_move != NULL)
+            {
+                *best_move = moves[i];
+            }
+        }
+    }
+    return best;
+}
+
+// Alpha-beta of the root player's expected lead, `depth` plies deep.
+// `best_move` may be NULL.
+static double search_node(Expectimax_search* search, Game* state, int depth, double alpha, double beta,
+                          Move* best_move)
+{
+    if(is_round_over(state))
+    {
+        return chance_node(search, state, depth);
+    }
+    if(depth == 0)
+    {
+        return evaluate_leaf(search, state);
+    }
+    search->nodes++;
+    if(search->can_stop && search->config->max_nodes > 0 && search->nodes >= search->config->max_nodes)
+    {
+        search->stop = 1;
+    }
+    if(search->stop)
+    {
+        return 0;
+    }
+
+    Move moves[MAX_LEGAL_MOVES];
+    int no_of_moves = generate_legal_moves(state, moves);
+    no_of_moves = order_moves(state, moves, no_of_moves, search->config->move_width);
+
+    if(depth == 1 && search->net != NULL)
+    {
+        return search_last_ply(search, state, moves, no_of_moves, best_move);
+    }
+
+    int maximising = state->flow.player_on_move == search->root_player;
+    double best = maximising ? -VALUE_INFINITY : VALUE_INFINITY;
+    for(int i = 0; i < no_of_moves && alpha < beta; i++)
+    {
+        Undo_record undo;
+        apply_move_with_undo(state, moves[i], &undo);
+        double value = search_node(search, state, depth - 1, alpha, beta, NULL);
+        undo_move(state, &undo);
+        if(search->stop)
+        {
+            return 0;
+        }
+
+        if(maximising ? value > best : value < best)
+        {
+            best = value;
+            if(best_move != NULL)
+            {
+                *best_move = moves[i];
+            }
+        }
+        if(maximising && best > alpha)
+        {
+            alpha = best;
+        }
+        if(!maximising && best < beta)
+        {
+            beta = best;
+        }
+    }
+    return best;
+}
+
+// Returns 0 if there is nothing to search (round over)
+int expectimax_search(const Game* info, const Expectimax_config* config, Expectimax_result* result)
+{
+    if(is_round_over(info))
+    {
+        return 0;
+    }
+
+    Expectimax_search search = {0};
+    Game state = *info;
+    double start = now_in_seconds();
+    search.config = config;
+    search.weights = config->weights != NULL ? config->weights : &default_eval_weights;
+    search.net = config->net;
+    search.root_player = info->flow.player_on_move;
+
+    result->depth = 0;
+    for(int depth = 1; depth <= config->depth; depth++)
+    {
+        Move best_move;
+        double value = search_node(&search, &state, depth, -VALUE_INFINITY, VALUE_INFINITY, &best_move);
+        if(search.stop)
+        {
+            break;
+        }
+        result->best_move = best_move;
+        result->value = value;
+        result->depth = depth;
+        search.can_stop = 1;
+    }
+
+    result->nodes = search.nodes;
+    result->chance_nodes = search.chance_nodes;
+    result->seconds = now_in_seconds() - start;
+    return 1;
+}
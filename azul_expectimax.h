@@ -0,0 +1,55 @@
+/*AZUL BOARD GAME - Expectimax search across rounds
+
+The tree search and the endgame solver stop at the end of the round:
+what comes next depends on the tiles the next start_round() draws. This
+search goes past it. When a line ends the round (and not the game) it
+scores the round, then becomes a chance node: it draws `chance_samples`
+fills of the next round from the bag and the box lid as they are, with
+its own random stream (never the game's, which would know the real
+draw), and the node is worth the average of the sampled rounds searched
+on. The branching of a chance node is the number of samples, not the
+number of possible fills.
+
+Values are the lead of the player on move at the root: the final scores
+at the end of the game, evaluate_lead() (azul_eval.h) where a line is
+cut at the depth limit, plus the correction of the network (azul_net.h)
+if there is one. With a network the children of a node one ply above
+the limit are evaluated in one batch. The root player maximises, the others minimise
+as in azul_endgame.h, with alpha-beta between chance nodes. Only the
+`move_width` best moves of a node by greedy_move_value() are searched.
+*/
+
+#ifndef AZUL_EXPECTIMAX_H
+#define AZUL_EXPECTIMAX_H
+
+#include <stdint.h>
+
+#include "azul_eval.h"
+#include "azul_net.h"
+#include "azul_rules.h"
+
+typedef struct
+{
+    int depth;            // plies, the end of a round counts as one
+    int chance_samples;   // fills drawn at the end of a round, 0 = stop there
+    int move_width;       // moves searched per node, 0 = every legal move
+    long max_nodes;       // 0 = no limit, the deepest complete iteration answers
+    uint64_t seed;        // fill samples are drawn with derive_seed(seed, ...)
+    const Eval_weights* weights;   // NULL = default_eval_weights
+    const Net* net;                // corrects the weights' values, NULL = none
+}Expectimax_config;
+
+typedef struct
+{
+    Move best_move;
+    double value;         // expected lead of the player on move
+    int depth;            // plies of the last completed iteration
+    long nodes;
+    long chance_nodes;
+    double seconds;
+}Expectimax_result;
+
+void expectimax_default_config(Expectimax_config* config);
+int expectimax_search(const Game* info, const Expectimax_config* config, Expectimax_result* result);
+
+#endif
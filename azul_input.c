@@ -0,0 +1,139 @@
+/*AZUL BOARD GAME - Keyboard input
+See azul_input.h.
+*/
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "azul_input.h"
+
+static char line[INPUT_LINE_SIZE];
+static int line_length;
+static int cursor;
+
+// Reads the next line of stdin, returns 0 at its end
+static int read_line(void)
+{
+    cursor = 0;
+    line_length = 0;
+    if(fgets(line, sizeof(line), stdin) == NULL)
+    {
+        return 0;
+    }
+    line_length = (int)strlen(line);
+    if(line_length > 0 && line[line_length - 1] == '\n')
+    {
+        line_length--;
+    }
+    else
+    {
+        // Longer than the buffer, the rest is dropped
+        int c;
+        while((c = getchar()) != '\n' && c != EOF)
+        {
+        }
+    }
+    return 1;
+}
+
+// Takes the next word, printing `prompt` and reading lines until there is one
+int read_word(const char* prompt, Input_word* word)
+{
+    for(;;)
+    {
+        while(cursor < line_length && isspace((unsigned char)line[cursor]))
+        {
+            cursor++;
+        }
+        if(cursor < line_length)
+        {
+            break;
+        }
+        fputs(prompt, stdout);
+        fflush(stdout);
+        if(!read_line())
+        {
+            printf("\n");
+            return INPUT_EOF;
+        }
+    }
+
+    word->text = line + cursor;
+    while(cursor < line_length && !isspace((unsigned char)line[cursor]))
+    {
+        cursor++;
+    }
+    word->length = (int)(line + cursor - word->text);
+
+    char digits[INPUT_LINE_SIZE];
+    char* end;
+    memcpy(digits, word->text, word->length);
+    digits[word->length] = '\0';
+    errno = 0;
+    word->number = strtol(digits, &end, 10);
+    word->is_number = *end == '\0' && errno == 0;
+    return word_is(word, "quit") ? INPUT_QUIT : INPUT_OK;
+}
+
+// Asks until the answer is a number from `low` to `high`
+int read_number(const char* prompt, int low, int high, int* value)
+{
+    Input_word word;
+    for(;;)
+    {
+        int status = read_word(prompt, &word);
+        if(status != INPUT_OK)
+        {
+            return status;
+        }
+        if(word.is_number && word.number >= low && word.number <= high)
+        {
+            *value = (int)word.number;
+            return INPUT_OK;
+        }
+        printf("Please type a number from %d to %d.\n", low, high);
+        skip_line();
+    }
+}
+
+// Asks until the answer fits in `size` bytes with its '\0'
+int read_name(const char* prompt, char* name, int size)
+{
+    Input_word word;
+    for(;;)
+    {
+        int status = read_word(prompt, &word);
+        if(status != INPUT_OK)
+        {
+            return status;
+        }
+        if(word.length < size)
+        {
+            memcpy(name, word.text, word.length);
+            name[word.length] = '\0';
+            return INPUT_OK;
+        }
+        printf("Please type at most %d characters.\n", size - 1);
+        skip_line();
+    }
+}
+
+int word_is(const Input_word* word, const char* text)
+{
+    return (int)strlen(text) == word->length && memcmp(word->text, text, word->length) == 0;
+}
+
+// End of the current line, the words after the last one read run up to it
+const char* input_line_end(void)
+{
+    return line + line_length;
+}
+
+// Drops the words of the current line that were not read
+void skip_line(void)
+{
+    cursor = line_length;
+}
@@ -0,0 +1,40 @@
+/*AZUL BOARD GAME - Keyboard input
+
+The terminal game reads stdin one whole line at a time into a fixed
+buffer (the end of a longer line is dropped) and hands it out word by
+word. Every question takes the next word, so "1 3 0 2" answers four
+prompts at once; a line runs out before the next prompt is printed.
+An answer that does not fit the question drops the rest of its line
+and the question is asked again, nothing is ever left unread.
+
+"quit" answers any question with INPUT_QUIT, the end of stdin with
+INPUT_EOF, so a closed terminal ends the game instead of asking
+forever.
+*/
+
+#ifndef AZUL_INPUT_H
+#define AZUL_INPUT_H
+
+#define INPUT_LINE_SIZE 128
+
+#define INPUT_OK 1
+#define INPUT_QUIT 0         // the player typed quit
+#define INPUT_EOF -1         // stdin is closed
+
+// A word of the current line, valid until the next read
+typedef struct
+{
+    const char* text;        // not '\0' terminated
+    int length;
+    int is_number;
+    long number;
+}Input_word;
+
+int read_word(const char* prompt, Input_word* word);
+int read_number(const char* prompt, int low, int high, int* value);
+int read_name(const char* prompt, char* name, int size);
+int word_is(const Input_word* word, const char* text);
+const char* input_line_end(void);
+void skip_line(void);
+
+#endif
@@ -0,0 +1,500 @@
+/*AZUL BOARD GAME - Lockstep simulator
+See azul_lockstep.h.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "azul_lockstep.h"
+#include "azul_pool.h"
+
+// Every field holds one slot per game of the block, game g at [g]
+typedef struct
+{
+    int32_t bag[HOW_MANY_TILES_TYPES][LOCKSTEP_GAMES];
+    int32_t box_lid[HOW_MANY_TILES_TYPES][LOCKSTEP_GAMES];
+    int32_t factories[MAX_NUMBER_OF_FACTORIES][HOW_MANY_TILES_TYPES][LOCKSTEP_GAMES];
+    int32_t middle_pile[HOW_MANY_TILES_TYPES][LOCKSTEP_GAMES];
+    int32_t sources_with[HOW_MANY_TILES_TYPES][LOCKSTEP_GAMES];  // factories and middle holding a color
+    int32_t is_token_in_middle[LOCKSTEP_GAMES];
+    int32_t token_holder[LOCKSTEP_GAMES];                     // -1 if nobody took it
+    int32_t tiles_left[LOCKSTEP_GAMES];                       // on factories and middle pile
+    uint32_t walls[MAX_PLAYERS][LOCKSTEP_GAMES];
+    int32_t line_colors[MAX_PLAYERS][5][LOCKSTEP_GAMES];      // -1 on an empty line
+    int32_t line_counts[MAX_PLAYERS][5][LOCKSTEP_GAMES];
+    int32_t floor_counts[MAX_PLAYERS][LOCKSTEP_GAMES];        // slots taken, token included
+    int32_t floor_tiles[MAX_PLAYERS][HOW_MANY_TILES_TYPES][LOCKSTEP_GAMES];
+    int32_t scores[MAX_PLAYERS][LOCKSTEP_GAMES];
+    int32_t player_on_move[LOCKSTEP_GAMES];
+    int32_t rounds[LOCKSTEP_GAMES];
+    int32_t is_running[LOCKSTEP_GAMES];                       // 0 once over and for unused slots
+    int32_t has_ended[LOCKSTEP_GAMES];                        // a wall row is complete
+    int32_t moves[LOCKSTEP_GAMES];
+    Rng fill_rngs[LOCKSTEP_GAMES];
+    Rng bot_rngs[LOCKSTEP_GAMES];
+    uint64_t seeds[LOCKSTEP_GAMES];
+    int no_of_players;
+    int no_of_factories;
+}Lockstep_block;
+
+typedef struct
+{
+    const Selfplay_config* config;
+    Lockstep_block** blocks;           // one per worker
+    Selfplay_stats* worker_stats;      // one per worker, merged at the end
+}Lockstep_batch;
+
+// Penalty of a floor line with 0-7 slots taken
+static const int32_t floor_penalty_totals[MAX_PENALTIES + 1] = {0, -1, -2, -4, -6, -8, -11, -14};
+
+/* Phases that are the same arithmetic for every game of the block */
+
+static void score_round(Lockstep_block* block)
+{
+    for(int p = 0; p < block->no_of_players; p++)
+    {
+        for(int g = 0; g < LOCKSTEP_GAMES; g++)
+        {
+            int round_score = 0;
+            for(int row = 0; row < 5; row++)
+            {
+                if(block->line_counts[p][row][g] != row + 1)
+                {
+                    continue;
+                }
+                int color = block->line_colors[p][row][g];
+                int col = wall_col_table[row][color];
+                block->walls[p][g] |= WALL_BIT(row, col);
+                round_score += wall_placement_score(block->walls[p][g], row, col);
+                block->box_lid[color][g] += row;
+                block->line_counts[p][row][g] = 0;
+                block->line_colors[p][row][g] = -1;
+            }
+
+            round_score += floor_penalty_totals[block->floor_counts[p][g]];
+            for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+            {
+                block->box_lid[color][g] += block->floor_tiles[p][color][g];
+                block->floor_tiles[p][color][g] = 0;
+            }
+            block->floor_counts[p][g] = 0;
+
+            int score = block->scores[p][g] + round_score;
+            block->scores[p][g] = score < 0 ? 0 : score;
+        }
+    }
+}
+
+// Returns the games still running
+static int update_running(Lockstep_block* block)
+{
+    int no_of_running = 0;
+    for(int g = 0; g < LOCKSTEP_GAMES; g++)
+    {
+        int ended = 0;
+        for(int p = 0; p < block->no_of_players; p++)
+        {
+            for(int row = 0; row < 5; row++)
+            {
+                ended |= (block->walls[p][g] & WALL_ROW_MASK(row)) == WALL_ROW_MASK(row);
+            }
+        }
+        block->has_ended[g] = ended;
+        block->is_running[g] &= !ended && block->rounds[g] < MAX_ROUNDS;
+        no_of_running += block->is_running[g];
+    }
+    return no_of_running;
+}
+
+static void add_final_bonuses(Lockstep_block* block)
+{
+    for(int p = 0; p < block->no_of_players; p++)
+    {
+        for(int g = 0; g < LOCKSTEP_GAMES; g++)
+        {
+            uint32_t wall = block->walls[p][g];
+            int bonus_points = 0;
+            for(int i = 0; i < 5; i++)
+            {
+                bonus_points += (wall & WALL_ROW_MASK(i)) == WALL_ROW_MASK(i) ? 2 : 0;
+                bonus_points += (wall & wall_col_masks[i]) == wall_col_masks[i] ? 7 : 0;
+                bonus_points += (wall & wall_color_masks[i]) == wall_color_masks[i] ? 10 : 0;
+            }
+            block->scores[p][g] += bonus_points;
+        }
+    }
+}
+
+// The simulator plays random bots only and keeps no move history
+int is_lockstep_config(const Selfplay_config* config)
+{
+    for(int p = 0; p < config->no_of_players; p++)
+    {
+        if(config->seats[p].type != BOT_RANDOM)
+        {
+            return 0;
+        }
+    }
+    return config->archive == NULL;
+}
+
+/* Phases that stay one game at a time */
+
+// init_game() for slot g, unused slots never run
+static void init_game_slot(Lockstep_block* block, int g, uint64_t seed, int is_used)
+{
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        block->bag[color][g] = SAME_COLOR_TILES;
+        block->box_lid[color][g] = 0;
+        block->middle_pile[color][g] = 0;
+        block->sources_with[color][g] = 0;
+        for(int f = 0; f < MAX_NUMBER_OF_FACTORIES; f++)
+        {
+            block->factories[f][color][g] = 0;
+        }
+    }
+    for(int p = 0; p < MAX_PLAYERS; p++)
+    {
+        block->walls[p][g] = 0;
+        block->floor_counts[p][g] = 0;
+        block->scores[p][g] = 0;
+        for(int i = 0; i < 5; i++)
+        {
+            block->line_colors[p][i][g] = -1;
+            block->line_counts[p][i][g] = 0;
+            block->floor_tiles[p][i][g] = 0;
+        }
+    }
+    block->is_token_in_middle[g] = 0;
+    block->token_holder[g] = -1;
+    block->tiles_left[g] = 0;
+    block->player_on_move[g] = 0;
+    block->rounds[g] = 0;
+    block->is_running[g] = is_used;
+    block->has_ended[g] = 0;
+    block->moves[g] = 0;
+    block->seeds[g] = seed;
+    rng_seed(&block->fill_rngs[g], seed);
+    rng_seed(&block->bot_rngs[g], derive_seed(seed, 1));
+}
+
+// start_round() for game g, the draws are those of amplasete_tiles_on_a_factory()
+static void start_round_slot(Lockstep_block* block, int g)
+{
+    int tiles_in_bag = 0;
+
+    block->player_on_move[g] = block->token_holder[g] < 0 ? 0 : block->token_holder[g];
+    block->token_holder[g] = -1;
+    block->is_token_in_middle[g] = 1;
+    block->rounds[g]++;
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        tiles_in_bag += block->bag[color][g];
+    }
+
+    for(int f = 0; f < block->no_of_factories; f++)
+    {
+        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+        {
+            if(tiles_in_bag == 0)
+            {
+                for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+                {
+                    block->bag[color][g] += block->box_lid[color][g];
+                    tiles_in_bag += block->box_lid[color][g];
+                    block->box_lid[color][g] = 0;
+                }
+                if(tiles_in_bag == 0)
+                {
+                    return;
+                }
+            }
+
+            int pick = rng_below(&block->fill_rngs[g], tiles_in_bag);
+            int color = 0;
+            while(pick >= block->bag[color][g])
+            {
+                pick -= block->bag[color][g];
+                color++;
+            }
+            tiles_in_bag--;
+            block->bag[color][g]--;
+            block->sources_with[color][g] += block->factories[f][color][g] == 0;
+            block->factories[f][color][g]++;
+            block->tiles_left[g]++;
+        }
+    }
+}
+
+static inline int32_t* source_tiles(Lockstep_block* block, int source, int color)
+{
+    return source == block->no_of_factories ? block->middle_pile[color] : block->factories[source][color];
+}
+
+// choose_bot_move() of a random bot and apply_move() for game g: the move
+// is drawn from the moves in generate_legal_moves() order without listing them
+static void play_random_move(Lockstep_block* block, int g)
+{
+    int p = block->player_on_move[g];
+    uint32_t wall = block->walls[p][g];
+    int lines_for_color[HOW_MANY_TILES_TYPES] = {0};
+    int moves_per_color[HOW_MANY_TILES_TYPES];
+
+    for(int line = 0; line < 5; line++)
+    {
+        if(block->line_counts[p][line][g] == line + 1)
+        {
+            continue;
+        }
+        int line_color = block->line_colors[p][line][g];
+        for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+        {
+            if((line_color == -1 || line_color == color) &&
+               (wall & WALL_ROW_MASK(line) & wall_color_masks[color]) == 0)
+            {
+                lines_for_color[color] |= 1 << line;
+            }
+        }
+    }
+
+    int no_of_moves = 0;
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        moves_per_color[color] = __builtin_popcount(lines_for_color[color]) + 1;
+        no_of_moves += block->sources_with[color][g] * moves_per_color[color];
+    }
+
+    int pick = rng_below(&block->bot_rngs[g], no_of_moves);
+    int source = 0, color = 0;
+    for(;; source++)
+    {
+        for(color = 0; color < HOW_MANY_TILES_TYPES; color++)
+        {
+            if(source_tiles(block, source, color)[g] == 0)
+            {
+                continue;
+            }
+            if(pick < moves_per_color[color])
+            {
+                break;
+            }
+            pick -= moves_per_color[color];
+        }
+        if(color < HOW_MANY_TILES_TYPES)
+        {
+            break;
+        }
+    }
+    // The pick-th accepting pattern line, the floor after the last one
+    int line = FLOOR_LINE;
+    for(int bits = lines_for_color[color]; bits != 0 && line == FLOOR_LINE; bits &= bits - 1, pick--)
+    {
+        if(pick == 0)
+        {
+            line = __builtin_ctz(bits);
+        }
+    }
+
+    int taken;
+    if(source == block->no_of_factories)
+    {
+        taken = block->middle_pile[color][g];
+        block->middle_pile[color][g] = 0;
+        block->sources_with[color][g]--;
+        if(block->is_token_in_middle[g])
+        {
+            block->is_token_in_middle[g] = 0;
+            block->token_holder[g] = p;
+            if(block->floor_counts[p][g] < MAX_PENALTIES)
+            {
+                block->floor_counts[p][g]++;
+            }
+        }
+    }
+    else
+    {
+        taken = block->factories[source][color][g];
+        block->factories[source][color][g] = 0;
+        block->sources_with[color][g]--;
+        for(int other = 0; other < HOW_MANY_TILES_TYPES; other++)
+        {
+            int moved = block->factories[source][other][g];
+            if(moved > 0)
+            {
+                // Leaves the factory, joins the middle pile unless it is there already
+                block->sources_with[other][g] -= block->middle_pile[other][g] > 0;
+                block->middle_pile[other][g] += moved;
+                block->factories[source][other][g] = 0;
+            }
+        }
+    }
+    block->tiles_left[g] -= taken;
+
+    if(line != FLOOR_LINE)
+    {
+        int room = line + 1 - block->line_counts[p][line][g];
+        int placed = taken < room ? taken : room;
+        block->line_counts[p][line][g] += placed;
+        block->line_colors[p][line][g] = color;
+        taken -= placed;
+    }
+    if(taken > 0)
+    {
+        int room = MAX_PENALTIES - block->floor_counts[p][g];
+        int placed = taken < room ? taken : room;
+        block->floor_counts[p][g] += placed;
+        block->floor_tiles[p][color][g] += placed;
+        block->box_lid[color][g] += taken - placed;
+    }
+
+    block->player_on_move[g] = (p + 1) % block->no_of_players;
+    block->moves[g]++;
+}
+
+// find_winner() for game g
+static int find_slot_winner(const Lockstep_block* block, int g)
+{
+    int winner_idx = -1, winner_rows = 0, tie = 0;
+    for(int p = 0; p < block->no_of_players; p++)
+    {
+        int rows = 0;
+        for(int row = 0; row < 5; row++)
+        {
+            rows += (block->walls[p][g] & WALL_ROW_MASK(row)) == WALL_ROW_MASK(row);
+        }
+        if(winner_idx == -1 || block->scores[p][g] > block->scores[winner_idx][g] ||
+           (block->scores[p][g] == block->scores[winner_idx][g] && rows > winner_rows))
+        {
+            winner_idx = p;
+            winner_rows = rows;
+            tie = 0;
+        }
+        else if(block->scores[p][g] == block->scores[winner_idx][g] && rows == winner_rows)
+        {
+            tie = 1;
+        }
+    }
+    return tie ? -1 : winner_idx;
+}
+
+static void lockstep_task(long task_idx, int worker_idx, void* arg)
+{
+    Lockstep_batch* batch = arg;
+    const Selfplay_config* config = batch->config;
+    Lockstep_block* block = batch->blocks[worker_idx];
+    long first_game = task_idx * LOCKSTEP_GAMES;
+    long no_of_games = config->no_of_games - first_game;
+    if(no_of_games > LOCKSTEP_GAMES)
+    {
+        no_of_games = LOCKSTEP_GAMES;
+    }
+
+    block->no_of_players = config->no_of_players;
+    block->no_of_factories = 2 * config->no_of_players + 1;
+    for(int g = 0; g < LOCKSTEP_GAMES; g++)
+    {
+        init_game_slot(block, g, derive_seed(config->seed, first_game + g), g < no_of_games);
+    }
+
+    while(update_running(block) > 0)
+    {
+        for(int g = 0; g < LOCKSTEP_GAMES; g++)
+        {
+            if(block->is_running[g])
+            {
+                start_round_slot(block, g);
+            }
+        }
+        // One move of every game with tiles left until all rounds are over
+        int is_any_playing = 1;
+        while(is_any_playing)
+        {
+            is_any_playing = 0;
+            for(int g = 0; g < LOCKSTEP_GAMES; g++)
+            {
+                if(block->tiles_left[g] > 0)
+                {
+                    play_random_move(block, g);
+                    is_any_playing |= block->tiles_left[g] > 0;
+                }
+            }
+        }
+        score_round(block);
+    }
+    add_final_bonuses(block);
+
+    for(int g = 0; g < no_of_games; g++)
+    {
+        Game_result result;
+        memset(&result, 0, sizeof(result));
+        result.seed = block->seeds[g];
+        for(int p = 0; p < config->no_of_players; p++)
+        {
+            result.scores[p] = block->scores[p][g];
+        }
+        result.winner = find_slot_winner(block, g);
+        result.rounds = block->rounds[g];
+        result.finished = block->has_ended[g];
+        add_selfplay_result(&batch->worker_stats[worker_idx], &result, config->no_of_players, block->moves[g]);
+        if(config->results != NULL)
+        {
+            config->results[first_game + g] = result;
+        }
+    }
+}
+
+// Plays the batch as run_selfplay_batch() would, with the same results.
+// Returns 0 if the config has other bots than random ones or an archive,
+// or there is not enough memory for the blocks.
+int run_lockstep_batch(const Selfplay_config* config, Selfplay_stats* stats)
+{
+    int no_of_threads = config->no_of_threads > 0 ? config->no_of_threads : online_core_count();
+    long no_of_blocks = (config->no_of_games + LOCKSTEP_GAMES - 1) / LOCKSTEP_GAMES;
+    Lockstep_batch batch;
+
+    reset_selfplay_stats(stats);
+    if(!is_lockstep_config(config))
+    {
+        return 0;
+    }
+    batch.config = config;
+
+    // No more workers than blocks, each worker reuses one block
+    if(no_of_threads > no_of_blocks)
+    {
+        no_of_threads = no_of_blocks > 0 ? (int)no_of_blocks : 1;
+    }
+    batch.blocks = calloc(no_of_threads, sizeof(Lockstep_block*));
+    batch.worker_stats = malloc(sizeof(Selfplay_stats) * no_of_threads);
+    int has_memory = batch.blocks != NULL && batch.worker_stats != NULL;
+    for(int i = 0; has_memory && i < no_of_threads; i++)
+    {
+        batch.blocks[i] = malloc(sizeof(Lockstep_block));
+        has_memory = batch.blocks[i] != NULL;
+        reset_selfplay_stats(&batch.worker_stats[i]);
+    }
+
+    if(has_memory)
+    {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        run_parallel_tasks(no_of_blocks, no_of_threads, lockstep_task, &batch);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        for(int i = 0; i < no_of_threads; i++)
+        {
+            merge_selfplay_stats(stats, &batch.worker_stats[i]);
+        }
+        stats->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    }
+
+    for(int i = 0; batch.blocks != NULL && i < no_of_threads; i++)
+    {
+        free(batch.blocks[i]);
+    }
+    free(batch.blocks);
+    free(batch.worker_stats);
+    return has_memory;
+}
@@ -0,0 +1,33 @@
+/*AZUL BOARD GAME - Lockstep simulator
+
+Plays blocks of LOCKSTEP_GAMES games between random bots side by side.
+A block keeps every part of the state in structure-of-arrays form (bag
+counts, factory histograms, pattern lines, wall masks, scores, ...), one
+contiguous array per field with a slot per game, and advances all of its
+games one phase at a time: start the round, one move of every game until
+all rounds are over, score the round, check for the end of the game.
+
+Scoring the round, the game end check and the final bonuses are the same
+arithmetic for every game and run as loops over the whole block.
+Filling the factories and choosing the moves go one game at a time:
+they read each game's own random stream, so a game gets exactly the
+fills and moves it gets in run_selfplay_batch() and both give the same
+results. The gain over the plain batch comes from the layout, not from
+SIMD: AVX2 versions of the scoring phases were no faster, the time goes
+to the fills and moves.
+
+The blocks are spread over the thread pool like self-play games.
+*/
+
+#ifndef AZUL_LOCKSTEP_H
+#define AZUL_LOCKSTEP_H
+
+#include "azul_selfplay.h"
+
+// Games in one block
+#define LOCKSTEP_GAMES 256
+
+int is_lockstep_config(const Selfplay_config* config);
+int run_lockstep_batch(const Selfplay_config* config, Selfplay_stats* stats);
+
+#endif
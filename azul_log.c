@@ -0,0 +1,7 @@
+/*AZUL BOARD GAME - Logging levels
+See azul_log.h.
+*/
+
+#include "azul_log.h"
+
+int log_verbosity = LOG_NORMAL;
@@ -0,0 +1,38 @@
+/*AZUL BOARD GAME - Logging levels
+
+The play-by-play text of the terminal game (round banners, "Tiles
+placed!", end of round reports, search statistics) goes through LOG(),
+never through a bare printf(). A message is printed when its level is
+both compiled in (AZUL_LOG_LEVEL) and asked for at run time
+(log_verbosity, see --quiet/--verbose). Building with
+-DAZUL_LOG_LEVEL=0 turns every LOG() into dead code, so a quiet build
+does not even format the text. Prompts and final results are not logs.
+*/
+
+#ifndef AZUL_LOG_H
+#define AZUL_LOG_H
+
+#include <stdio.h>
+
+#define LOG_QUIET 0
+#define LOG_NORMAL 1     // what happens in the game
+#define LOG_VERBOSE 2    // how the computer got there
+
+#ifndef AZUL_LOG_LEVEL
+#define AZUL_LOG_LEVEL LOG_VERBOSE
+#endif
+
+extern int log_verbosity;
+
+#define LOG_ENABLED(level) (AZUL_LOG_LEVEL >= (level) && log_verbosity >= (level))
+
+#define LOG(level, ...)              \
+    do                               \
+    {                                \
+        if(LOG_ENABLED(level))       \
+        {                            \
+            printf(__VA_ARGS__);     \
+        }                            \
+    } while(0)
+
+#endif
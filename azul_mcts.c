@@ -0,0 +1,354 @@
+/*AZUL BOARD GAME - Monte Carlo Tree Search player
+See azul_mcts.h.
+*/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "azul_mcts.h"
+
+#define UNEXPANDED -1
+#define EXPANDING -2
+#define TREE_FULL -3
+
+#define VIRTUAL_LOSS 1
+#define VALUE_SCALE 65536
+// Score difference (after the round) worth a certain win
+#define REWARD_SCORE_RANGE 20.0
+
+typedef struct
+{
+    _Atomic int visits;
+    _Atomic int virtual_loss;
+    _Atomic long long value_sum;   // rewards of `player`, times VALUE_SCALE
+    _Atomic int first_child;
+    int no_of_children;
+    int player;                    // player who made `move`
+    Move move;
+}Mcts_node;
+
+typedef struct
+{
+    const Game* root_game;
+    const Mcts_config* config;
+    Mcts_node* nodes;
+    int capacity;
+    _Atomic int used;
+    _Atomic long iterations;
+    _Atomic int stop;
+}Mcts_tree;
+
+typedef struct
+{
+    Mcts_tree* tree;
+    Rng rng;
+}Mcts_worker;
+
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void mcts_default_config(Mcts_config* config)
+{
+    config->no_of_threads = 0;
+    config->max_iterations = 20000;
+    config->max_nodes = 1 << 20;
+    config->exploration = 1.0;
+    config->seed = 1;
+}
+
+static void init_node(Mcts_node* node, Move move, int player)
+{
+    atomic_init(&node->visits, 0);
+    atomic_init(&node->virtual_loss, 0);
+    atomic_init(&node->value_sum, 0);
+    atomic_init(&node->first_child, UNEXPANDED);
+    node->no_of_children = 0;
+    node->player = player;
+    node->move = move;
+}
+
+static int select_child(Mcts_tree* tree, Mcts_node* node)
+{
+    int first = atomic_load_explicit(&node->first_child, memory_order_acquire);
+    int parent_visits = atomic_load_explicit(&node->visits, memory_order_relaxed) + 1;
+    double log_parent = log((double)parent_visits);
+    double exploration = tree->config->exploration;
+
+    int best = first;
+    double best_score = -1.0;
+    for(int i = first; i < first + node->no_of_children; i++)
+    {
+        Mcts_node* child = &tree->nodes[i];
+        int visits = atomic_load_explicit(&child->visits, memory_order_relaxed);
+        int virtual_loss = atomic_load_explicit(&child->virtual_loss, memory_order_relaxed);
+        int effective = visits + virtual_loss;
+        if(effective == 0)
+        {
+            return i;
+        }
+        double value = (double)atomic_load_explicit(&child->value_sum, memory_order_relaxed) / VALUE_SCALE;
+        double score = value / effective + exploration * sqrt(log_parent / effective);
+        if(score > best_score)
+        {
+            best_score = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Creates the children of `node`, returns 0 if another thread got there
+// first or the tree is full
+static int expand_node(Mcts_tree* tree, Mcts_node* node, const Game* state)
+{
+    int expected = UNEXPANDED;
+    if(!atomic_compare_exchange_strong(&node->first_child, &expected, EXPANDING))
+    {
+        return 0;
+    }
+
+    Move moves[MAX_LEGAL_MOVES];
+    int no_of_moves = generate_legal_moves(state, moves);
+    int first = atomic_fetch_add(&tree->used, no_of_moves);
+    if(first + no_of_moves > tree->capacity)
+    {
+        atomic_store(&tree->stop, 1);
+        atomic_store_explicit(&node->first_child, TREE_FULL, memory_order_release);
+        return 0;
+    }
+
+    for(int i = 0; i < no_of_moves; i++)
+    {
+        init_node(&tree->nodes[first + i], moves[i], state->flow.player_on_move);
+    }
+    node->no_of_children = no_of_moves;
+    atomic_store_explicit(&node->first_child, first, memory_order_release);
+    return 1;
+}
+
+// Random playout that avoids dropping tiles on the floor when it can
+static void rollout(Game* state, Rng* rng)
+{
+    Move moves[MAX_LEGAL_MOVES];
+    Move clean_moves[MAX_LEGAL_MOVES];
+
+    while(!is_round_over(state))
+    {
+        int no_of_moves = generate_legal_moves(state, moves);
+        const Mat* mat = &state->players[state->flow.player_on_move].mat;
+        int no_of_clean = 0;
+        for(int i = 0; i < no_of_moves; i++)
+        {
+            int line = moves[i].pattern_line;
+            if(line != FLOOR_LINE &&
+               count_tiles_in_source(state, moves[i].source, moves[i].color) <= line + 1 - pattern_line_count(mat, line))
+            {
+                clean_moves[no_of_clean++] = moves[i];
+            }
+        }
+
+        if(no_of_clean > 0)
+        {
+            apply_move(state, clean_moves[rng_below(rng, no_of_clean)]);
+        }
+        else
+        {
+            apply_move(state, moves[rng_below(rng, no_of_moves)]);
+        }
+    }
+}
+
+// Reward in [0, 1] of every player, from the score lead after the round
+static void evaluate_round_end(Game* state, double rewards[MAX_PLAYERS])
+{
+    process_end_of_round(state, NULL);
+    if(check_game_end(state))
+    {
+        calculate_final_bonuses(state, NULL);
+    }
+
+    for(int p = 0; p < state->no_of_players; p++)
+    {
+        int best_other = -1;
+        for(int q = 0; q < state->no_of_players; q++)
+        {
+            if(q != p && (int)state->players[q].mat.score > best_other)
+            {
+                best_other = state->players[q].mat.score;
+            }
+        }
+        double lead = (int)state->players[p].mat.score - best_other;
+        double reward = 0.5 + lead / (2.0 * REWARD_SCORE_RANGE);
+        rewards[p] = reward < 0.0 ? 0.0 : (reward > 1.0 ? 1.0 : reward);
+    }
+}
+
+static void run_iteration(Mcts_worker* worker)
+{
+    Mcts_tree* tree = worker->tree;
+    Game state = *tree->root_game;
+    int path[MAX_MOVES_PER_ROUND + 2];
+    int depth = 0;
+
+    Mcts_node* node = &tree->nodes[0];
+    path[depth++] = 0;
+
+    // Selection
+    while(atomic_load_explicit(&node->first_child, memory_order_acquire) >= 0 && !is_round_over(&state))
+    {
+        int child = select_child(tree, node);
+        node = &tree->nodes[child];
+        atomic_fetch_add_explicit(&node->virtual_loss, VIRTUAL_LOSS, memory_order_relaxed);
+        apply_move(&state, node->move);
+        path[depth++] = child;
+    }
+
+    // Expansion
+    if(!is_round_over(&state) && expand_node(tree, node, &state))
+    {
+        int child = select_child(tree, node);
+        node = &tree->nodes[child];
+        atomic_fetch_add_explicit(&node->virtual_loss, VIRTUAL_LOSS, memory_order_relaxed);
+        apply_move(&state, node->move);
+        path[depth++] = child;
+    }
+
+    // Simulation
+    double rewards[MAX_PLAYERS];
+    rollout(&state, &worker->rng);
+    evaluate_round_end(&state, rewards);
+
+    // Backpropagation
+    for(int i = depth - 1; i >= 0; i--)
+    {
+        Mcts_node* visited = &tree->nodes[path[i]];
+        if(i > 0)
+        {
+            atomic_fetch_sub_explicit(&visited->virtual_loss, VIRTUAL_LOSS, memory_order_relaxed);
+            atomic_fetch_add_explicit(&visited->value_sum,
+                                      (long long)(rewards[visited->player] * VALUE_SCALE),
+                                      memory_order_relaxed);
+        }
+        atomic_fetch_add_explicit(&visited->visits, 1, memory_order_relaxed);
+    }
+}
+
+static void* worker_main(void* arg)
+{
+    Mcts_worker* worker = arg;
+    Mcts_tree* tree = worker->tree;
+    long max_iterations = tree->config->max_iterations;
+
+    while(!atomic_load_explicit(&tree->stop, memory_order_relaxed))
+    {
+        long done = atomic_fetch_add_explicit(&tree->iterations, 1, memory_order_relaxed);
+        if(max_iterations > 0 && done >= max_iterations)
+        {
+            atomic_fetch_sub_explicit(&tree->iterations, 1, memory_order_relaxed);
+            break;
+        }
+        run_iteration(worker);
+    }
+    return NULL;
+}
+
+// Returns 0 if there is nothing to search (round over) or the tree could
+// not be allocated. The best move is the most visited root child.
+int mcts_search(const Game* info, const Mcts_config* config, Mcts_result* result)
+{
+    Move moves[MAX_LEGAL_MOVES];
+    if(is_round_over(info) || generate_legal_moves(info, moves) == 0)
+    {
+        return 0;
+    }
+
+    Mcts_tree tree;
+    tree.root_game = info;
+    tree.config = config;
+    tree.capacity = config->max_nodes > MAX_LEGAL_MOVES ? config->max_nodes : MAX_LEGAL_MOVES + 1;
+    tree.nodes = malloc(sizeof(Mcts_node) * tree.capacity);
+    if(tree.nodes == NULL)
+    {
+        return 0;
+    }
+    atomic_init(&tree.used, 1);
+    atomic_init(&tree.iterations, 0);
+    atomic_init(&tree.stop, 0);
+    Move no_move = {0, 0, 0};
+    init_node(&tree.nodes[0], no_move, -1);
+
+    int no_of_threads = config->no_of_threads;
+    if(no_of_threads <= 0)
+    {
+        no_of_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if(no_of_threads <= 0)
+        {
+            no_of_threads = 1;
+        }
+    }
+
+    Mcts_worker* workers = malloc(sizeof(Mcts_worker) * no_of_threads);
+    pthread_t* threads = malloc(sizeof(pthread_t) * no_of_threads);
+    if(workers == NULL || threads == NULL)
+    {
+        free(workers);
+        free(threads);
+        free(tree.nodes);
+        return 0;
+    }
+
+    double start = now_in_seconds();
+    for(int t = 0; t < no_of_threads; t++)
+    {
+        workers[t].tree = &tree;
+        rng_seed(&workers[t].rng, derive_seed(config->seed, t));
+    }
+    // The calling thread is worker 0. A worker that cannot be started
+    // leaves its iterations to the others, they share the tree.
+    int no_of_started = 0;
+    for(int t = 1; t < no_of_threads; t++)
+    {
+        if(pthread_create(&threads[no_of_started], NULL, worker_main, &workers[t]) == 0)
+        {
+            no_of_started++;
+        }
+    }
+    worker_main(&workers[0]);
+    for(int t = 0; t < no_of_started; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    double seconds = now_in_seconds() - start;
+
+    Mcts_node* root = &tree.nodes[0];
+    int first = atomic_load(&root->first_child);
+    int best = first;
+    for(int i = first; first >= 0 && i < first + root->no_of_children; i++)
+    {
+        if(atomic_load(&tree.nodes[i].visits) > atomic_load(&tree.nodes[best].visits))
+        {
+            best = i;
+        }
+    }
+
+    int used = atomic_load(&tree.used);
+    result->best_move = first >= 0 ? tree.nodes[best].move : moves[0];
+    result->iterations = atomic_load(&tree.iterations);
+    result->nodes = used < tree.capacity ? used : tree.capacity;
+    result->seconds = seconds;
+    result->iterations_per_second = seconds > 0 ? result->iterations / seconds : 0;
+    result->nodes_per_second = seconds > 0 ? result->nodes / seconds : 0;
+
+    free(workers);
+    free(threads);
+    free(tree.nodes);
+    return 1;
+}
@@ -0,0 +1,39 @@
+/*AZUL BOARD GAME - Monte Carlo Tree Search player
+
+Searches the moves of the current round with UCT. All threads share one
+tree: a thread descending through a node adds a virtual loss to it so the
+others spread out, and a leaf is expanded by whichever thread wins a
+compare-and-swap on its child index, without any lock. Rollouts are
+played to the end of the round and scored with process_end_of_round().
+*/
+
+#ifndef AZUL_MCTS_H
+#define AZUL_MCTS_H
+
+#include <stdint.h>
+
+#include "azul_rules.h"
+
+typedef struct
+{
+    int no_of_threads;    // 0 = one per online core
+    long max_iterations;  // 0 = no limit (then max_nodes must be set)
+    int max_nodes;        // size of the tree, also a budget
+    double exploration;   // UCT constant
+    uint64_t seed;        // thread t rolls out with derive_seed(seed, t)
+}Mcts_config;
+
+typedef struct
+{
+    Move best_move;
+    long iterations;
+    int nodes;
+    double seconds;
+    double iterations_per_second;
+    double nodes_per_second;
+}Mcts_result;
+
+void mcts_default_config(Mcts_config* config);
+int mcts_search(const Game* info, const Mcts_config* config, Mcts_result* result);
+
+#endif
@@ -0,0 +1,409 @@
+/*AZUL BOARD GAME - Quantized network evaluator
+See azul_net.h.
+
+The file is read as it is laid out in memory, on little-endian hosts.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "azul_net.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_AVX2_KERNELS 1
+#else
+#define HAS_AVX2_KERNELS 0
+#endif
+
+// Positions of a batch that share the loads of a weight row
+#define ROW_SHARE 4
+#define MAX_LAYER_OUTPUTS NET_MAX_HIDDEN
+
+const Net* default_net = NULL;
+
+int net_kernels_supported(int kernels)
+{
+    if(kernels == NET_KERNELS_AVX2)
+    {
+#if HAS_AVX2_KERNELS
+        return __builtin_cpu_supports("avx2");
+#else
+        return 0;
+#endif
+    }
+    return kernels == NET_KERNELS_AUTO || kernels == NET_KERNELS_SCALAR;
+}
+
+/* Loading and saving */
+
+static int alloc_layer(Net_layer* layer, int inputs, int outputs)
+{
+    size_t size = ((size_t)inputs * outputs + NET_ALIGN - 1) / NET_ALIGN * NET_ALIGN;
+    memset(layer, 0, sizeof(*layer));
+    layer->inputs = inputs;
+    layer->outputs = outputs;
+    if(outputs == 0)
+    {
+        return 1;
+    }
+    layer->weights = aligned_alloc(NET_ALIGN, size);
+    layer->biases = calloc(outputs, sizeof(int32_t));
+    if(layer->weights == NULL || layer->biases == NULL)
+    {
+        return 0;
+    }
+    memset(layer->weights, 0, size);
+    return 1;
+}
+
+static void free_layer(Net_layer* layer)
+{
+    free(layer->weights);
+    free(layer->biases);
+    layer->weights = NULL;
+    layer->biases = NULL;
+}
+
+// Returns 0 unless the widths fit the kernels
+int net_alloc(Net* net, int hidden1, int hidden2)
+{
+    memset(net, 0, sizeof(*net));
+    net->kernels = NET_KERNELS_SCALAR;
+    if(hidden1 <= 0 || hidden1 > NET_MAX_HIDDEN || hidden1 % NET_ALIGN != 0 ||
+       hidden2 <= 0 || hidden2 > NET_MAX_HIDDEN || hidden2 % NET_ALIGN != 0)
+    {
+        return 0;
+    }
+    if(!alloc_layer(&net->hidden1, NET_INPUTS, hidden1) ||
+       !alloc_layer(&net->hidden2, hidden1, hidden2) ||
+       !alloc_layer(&net->value, hidden2, 1))
+    {
+        net_free(net);
+        return 0;
+    }
+    return 1;
+}
+
+void net_free(Net* net)
+{
+    free_layer(&net->hidden1);
+    free_layer(&net->hidden2);
+    free_layer(&net->value);
+}
+
+static int read_layer(FILE* in, Net_layer* layer, int is_head)
+{
+    size_t weights = (size_t)layer->inputs * layer->outputs;
+    if(fread(layer->weights, 1, weights, in) != weights ||
+       fread(layer->biases, sizeof(int32_t), layer->outputs, in) != (size_t)layer->outputs)
+    {
+        return 0;
+    }
+    return is_head ? fread(&layer->scale, sizeof(float), 1, in) == 1
+                   : fread(&layer->multiplier, sizeof(int32_t), 1, in) == 1;
+}
+
+static int write_layer(FILE* out, const Net_layer* layer, int is_head)
+{
+    size_t weights = (size_t)layer->inputs * layer->outputs;
+    if(fwrite(layer->weights, 1, weights, out) != weights ||
+       fwrite(layer->biases, sizeof(int32_t), layer->outputs, out) != (size_t)layer->outputs)
+    {
+        return 0;
+    }
+    return is_head ? fwrite(&layer->scale, sizeof(float), 1, out) == 1
+                   : fwrite(&layer->multiplier, sizeof(int32_t), 1, out) == 1;
+}
+
+// Returns 0 if the file is missing, damaged or made for other inputs, or
+// the kernels are not supported here
+int net_load(Net* net, const char* path, int kernels)
+{
+    uint32_t header[5];
+    FILE* in = fopen(path, "rb");
+    if(in == NULL || !net_kernels_supported(kernels))
+    {
+        if(in != NULL)
+        {
+            fclose(in);
+        }
+        return 0;
+    }
+    if(fread(header, sizeof(uint32_t), 5, in) != 5 || header[0] != NET_MAGIC || header[1] != NET_VERSION ||
+       header[2] != NET_INPUTS || !net_alloc(net, (int)header[3], (int)header[4]))
+    {
+        fclose(in);
+        return 0;
+    }
+
+    int ok = read_layer(in, &net->hidden1, 0) && read_layer(in, &net->hidden2, 0) &&
+             read_layer(in, &net->value, 1);
+    fclose(in);
+    if(!ok)
+    {
+        net_free(net);
+        return 0;
+    }
+    if(kernels == NET_KERNELS_AUTO)
+    {
+        kernels = net_kernels_supported(NET_KERNELS_AVX2) ? NET_KERNELS_AVX2 : NET_KERNELS_SCALAR;
+    }
+    net->kernels = kernels;
+    return 1;
+}
+
+int net_save(const Net* net, const char* path)
+{
+    uint32_t header[5] = {NET_MAGIC, NET_VERSION, NET_INPUTS, (uint32_t)net->hidden1.outputs,
+                          (uint32_t)net->hidden2.outputs};
+    FILE* out = fopen(path, "wb");
+    if(out == NULL)
+    {
+        return 0;
+    }
+    int ok = fwrite(header, sizeof(uint32_t), 5, out) == 5 &&
+             write_layer(out, &net->hidden1, 0) && write_layer(out, &net->hidden2, 0) &&
+             write_layer(out, &net->value, 1);
+    return fclose(out) == 0 && ok;
+}
+
+/* Encoding */
+
+static uint8_t clamp_input(unsigned int value)
+{
+    return value > 127 ? 127 : (uint8_t)value;
+}
+
+void net_encode(const Game* info, int player, uint8_t inputs[NET_INPUTS])
+{
+    int n = info->no_of_players;
+    uint8_t* at = inputs;
+
+    memset(inputs, 0, NET_INPUTS);
+    for(int k = 0; k < MAX_PLAYERS; k++, at += NET_PLAYER_INPUTS)
+    {
+        if(k >= n)
+        {
+            continue;
+        }
+        int p = (player + k) % n;
+        const Mat* mat = &info->players[p].mat;
+        for(int cell = 0; cell < 25; cell++)
+        {
+            at[cell] = (mat->portugese_wall >> cell) & 1;
+        }
+        for(int row = 0; row < 5; row++)
+        {
+            int count = pattern_line_count(mat, row);
+            if(count > 0)
+            {
+                at[25 + row * 5 + pattern_line_color(mat, row)] = count;
+            }
+        }
+        for(int slot = 0; slot < MAX_PENALTIES; slot++)
+        {
+            at[50] += mat->penalties[slot] != AVAILABLE;
+        }
+        at[51] = clamp_input(mat->score);
+        at[52] = info->players[p].is_token_present != 0;
+    }
+
+    for(int f = 0; f < info->no_of_factory_displays; f++)
+    {
+        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+        {
+            int tile = info->factory_displays.all_factories[f][j];
+            if(tile >= 0 && tile < HOW_MANY_TILES_TYPES)
+            {
+                at[f * HOW_MANY_TILES_TYPES + tile]++;
+            }
+        }
+    }
+    at += MAX_NUMBER_OF_FACTORIES * HOW_MANY_TILES_TYPES;
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        at[color] = clamp_input(info->middle_pile.all_tiles[color]);
+        at[HOW_MANY_TILES_TYPES + color] = clamp_input(info->bag.all_tiles[color]);
+        at[2 * HOW_MANY_TILES_TYPES + color] = clamp_input(info->box_lid.all_tiles[color]);
+    }
+    at += 3 * HOW_MANY_TILES_TYPES;
+    *at++ = info->middle_pile.is_token_present != 0;
+    at[(info->flow.player_on_move - player + n) % n] = 1;
+}
+
+/* Layer kernels: sums[b][o] = biases[o] + weights[o] . in[b] */
+
+static void layer_sums_scalar(const Net_layer* layer, const uint8_t* in, int no_of_positions, int32_t* sums)
+{
+    for(int o = 0; o < layer->outputs; o++)
+    {
+        const int8_t* row = layer->weights + (size_t)o * layer->inputs;
+        for(int b = 0; b < no_of_positions; b++)
+        {
+            const uint8_t* x = in + (size_t)b * layer->inputs;
+            int32_t sum = layer->biases[o];
+            for(int i = 0; i < layer->inputs; i++)
+            {
+                sum += x[i] * row[i];
+            }
+            sums[b * layer->outputs + o] = sum;
+        }
+    }
+}
+
+#if HAS_AVX2_KERNELS
+
+__attribute__((target("avx2")))
+static inline int32_t horizontal_sum(__m256i v)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i dot_chunk(__m256i acc, __m256i x, const int8_t* row, __m256i ones)
+{
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(x, _mm256_load_si256((const __m256i*)row)),
+                                                   ones));
+}
+
+// The 8 sums of 8 accumulators, in order
+__attribute__((target("avx2")))
+static inline __m256i sum_eight(__m256i a0, __m256i a1, __m256i a2, __m256i a3,
+                                __m256i a4, __m256i a5, __m256i a6, __m256i a7)
+{
+    __m256i low = _mm256_hadd_epi32(_mm256_hadd_epi32(a0, a1), _mm256_hadd_epi32(a2, a3));
+    __m256i high = _mm256_hadd_epi32(_mm256_hadd_epi32(a4, a5), _mm256_hadd_epi32(a6, a7));
+    return _mm256_add_epi32(_mm256_permute2x128_si256(low, high, 0x20), _mm256_permute2x128_si256(low, high, 0x31));
+}
+
+// Activations are at most 127, so vpmaddubsw (u8 x s8, pairs summed to
+// 16 bits) cannot saturate: 2 * 127 * 128 < 32768. Outputs go 8 rows at
+// a time, each input chunk is loaded once for the 8 rows and the 8 sums
+// are reduced together; the rows left over (heads) go one at a time with
+// ROW_SHARE positions per weight load.
+__attribute__((target("avx2")))
+static void layer_sums_avx2(const Net_layer* layer, const uint8_t* in, int no_of_positions, int32_t* sums)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    int n = layer->inputs;
+    int o = 0;
+
+    for(; o + 8 <= layer->outputs; o += 8)
+    {
+        const int8_t* rows = layer->weights + (size_t)o * n;
+        __m256i biases = _mm256_loadu_si256((const __m256i*)(layer->biases + o));
+        for(int b = 0; b < no_of_positions; b++)
+        {
+            const uint8_t* x = in + (size_t)b * n;
+            __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0, a4 = a0, a5 = a0, a6 = a0, a7 = a0;
+            for(int i = 0; i < n; i += NET_ALIGN)
+            {
+                __m256i chunk = _mm256_loadu_si256((const __m256i*)(x + i));
+                a0 = dot_chunk(a0, chunk, rows + i, ones);
+                a1 = dot_chunk(a1, chunk, rows + n + i, ones);
+                a2 = dot_chunk(a2, chunk, rows + 2 * n + i, ones);
+                a3 = dot_chunk(a3, chunk, rows + 3 * n + i, ones);
+                a4 = dot_chunk(a4, chunk, rows + 4 * n + i, ones);
+                a5 = dot_chunk(a5, chunk, rows + 5 * n + i, ones);
+                a6 = dot_chunk(a6, chunk, rows + 6 * n + i, ones);
+                a7 = dot_chunk(a7, chunk, rows + 7 * n + i, ones);
+            }
+            _mm256_storeu_si256((__m256i*)(sums + (size_t)b * layer->outputs + o),
+                                _mm256_add_epi32(biases, sum_eight(a0, a1, a2, a3, a4, a5, a6, a7)));
+        }
+    }
+
+    for(; o < layer->outputs; o++)
+    {
+        const int8_t* row = layer->weights + (size_t)o * n;
+        int b = 0;
+        for(; b + ROW_SHARE <= no_of_positions; b += ROW_SHARE)
+        {
+            const uint8_t* x = in + (size_t)b * n;
+            __m256i acc0 = _mm256_setzero_si256(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+            for(int i = 0; i < n; i += NET_ALIGN)
+            {
+                acc0 = dot_chunk(acc0, _mm256_loadu_si256((const __m256i*)(x + i)), row + i, ones);
+                acc1 = dot_chunk(acc1, _mm256_loadu_si256((const __m256i*)(x + n + i)), row + i, ones);
+                acc2 = dot_chunk(acc2, _mm256_loadu_si256((const __m256i*)(x + 2 * n + i)), row + i, ones);
+                acc3 = dot_chunk(acc3, _mm256_loadu_si256((const __m256i*)(x + 3 * n + i)), row + i, ones);
+            }
+            sums[(b + 0) * layer->outputs + o] = layer->biases[o] + horizontal_sum(acc0);
+            sums[(b + 1) * layer->outputs + o] = layer->biases[o] + horizontal_sum(acc1);
+            sums[(b + 2) * layer->outputs + o] = layer->biases[o] + horizontal_sum(acc2);
+            sums[(b + 3) * layer->outputs + o] = layer->biases[o] + horizontal_sum(acc3);
+        }
+        for(; b < no_of_positions; b++)
+        {
+            const uint8_t* x = in + (size_t)b * n;
+            __m256i acc = _mm256_setzero_si256();
+            for(int i = 0; i < n; i += NET_ALIGN)
+            {
+                acc = dot_chunk(acc, _mm256_loadu_si256((const __m256i*)(x + i)), row + i, ones);
+            }
+            sums[b * layer->outputs + o] = layer->biases[o] + horizontal_sum(acc);
+        }
+    }
+}
+
+#endif
+
+static void layer_sums(const Net* net, const Net_layer* layer, const uint8_t* in, int no_of_positions, int32_t* sums)
+{
+#if HAS_AVX2_KERNELS
+    if(net->kernels == NET_KERNELS_AVX2)
+    {
+        layer_sums_avx2(layer, in, no_of_positions, sums);
+        return;
+    }
+#endif
+    layer_sums_scalar(layer, in, no_of_positions, sums);
+}
+
+// Clipped ReLU of the sums, back to 0-127
+static void requantize(const Net_layer* layer, const int32_t* sums, int no_of_positions, uint8_t* out)
+{
+    for(int i = 0; i < no_of_positions * layer->outputs; i++)
+    {
+        int64_t value = ((int64_t)sums[i] * layer->multiplier) >> NET_REQUANT_SHIFT;
+        out[i] = value < 0 ? 0 : (value > 127 ? 127 : (uint8_t)value);
+    }
+}
+
+// `inputs` holds NET_INPUTS bytes per position
+void net_evaluate_batch(const Net* net, const uint8_t* inputs, int no_of_positions, float* values)
+{
+    _Alignas(NET_ALIGN) uint8_t hidden1[NET_MAX_BATCH * NET_MAX_HIDDEN];
+    _Alignas(NET_ALIGN) uint8_t hidden2[NET_MAX_BATCH * NET_MAX_HIDDEN];
+    int32_t sums[NET_MAX_BATCH * MAX_LAYER_OUTPUTS];
+
+    for(int first = 0; first < no_of_positions; first += NET_MAX_BATCH)
+    {
+        int batch = no_of_positions - first < NET_MAX_BATCH ? no_of_positions - first : NET_MAX_BATCH;
+        layer_sums(net, &net->hidden1, inputs + (size_t)first * NET_INPUTS, batch, sums);
+        requantize(&net->hidden1, sums, batch, hidden1);
+        layer_sums(net, &net->hidden2, hidden1, batch, sums);
+        requantize(&net->hidden2, sums, batch, hidden2);
+
+        layer_sums(net, &net->value, hidden2, batch, sums);
+        for(int b = 0; b < batch; b++)
+        {
+            values[first + b] = sums[b] * net->value.scale;
+        }
+    }
+}
+
+// Correction of evaluate_lead() for `player` the network expects
+float net_evaluate(const Net* net, const Game* info, int player)
+{
+    _Alignas(NET_ALIGN) uint8_t inputs[NET_INPUTS];
+    float value;
+    net_encode(info, player, inputs);
+    net_evaluate_batch(net, inputs, 1, &value);
+    return value;
+}
@@ -0,0 +1,98 @@
+/*AZUL BOARD GAME - Quantized network evaluator
+
+An optional value network for the searches, small enough to run
+on plain CPUs. A position is encoded from one player's seat as fixed
+feature planes of small counts (every input fits in 0-127):
+
+    per player, that player first, then the others in seat order
+        wall            25 cells, 1 if tiled
+        pattern lines   5 lines x 5 colors, the tiles of the line's color
+        floor           occupied floor slots
+        score           clamped to 127
+        token           1 if the first player token is on the floor
+    shared
+        factories       9 factories x 5 colors, tiles of each color
+        middle pile     tiles of each color, 1 if the token is there
+        bag, box lid    tiles of each color
+        on move         4 inputs, seat of the player on move from ours
+
+The network is a multilayer perceptron with int8 weights: inputs ->
+hidden1 -> hidden2 with clipped ReLUs whose outputs are requantized to
+0-127, then a value head: the correction, in points, that the final
+score lead of our player needs over evaluate_lead() (azul_eval.h)
+with default_eval_weights: the features see the points on the board
+exactly, the network only learns what they miss. The layers
+multiply unsigned 8-bit activations by signed 8-bit weights into 32-bit
+sums, with AVX2 (vpmaddubsw) when the CPU has it and plain loops
+otherwise. Positions are evaluated in batches, every weight row is
+loaded once for the whole batch.
+
+Networks are trained outside the game (tools/azul_net_train.c) and
+loaded from a little-endian file:
+
+    "AZNN", version, inputs, hidden1, hidden2 (uint32)
+    hidden1 x inputs weights (int8), hidden1 biases (int32), multiplier
+    hidden2 x hidden1 weights, hidden2 biases, multiplier
+    hidden2 value weights, value bias, value scale (float)
+
+Version 1 files also carried a policy head, which no search used.
+
+A layer's 32-bit sums times its multiplier, shifted right by
+NET_REQUANT_SHIFT, are its outputs.
+*/
+
+#ifndef AZUL_NET_H
+#define AZUL_NET_H
+
+#include <stdint.h>
+
+#include "azul_rules.h"
+
+#define NET_MAGIC 0x4E4E5A41u          // "AZNN"
+#define NET_VERSION 2
+#define NET_PLAYER_INPUTS 53
+#define NET_INPUTS_USED (MAX_PLAYERS * NET_PLAYER_INPUTS + MAX_NUMBER_OF_FACTORIES * HOW_MANY_TILES_TYPES + \
+                         3 * HOW_MANY_TILES_TYPES + 1 + MAX_PLAYERS)
+// Layer widths are multiples of one AVX2 register of 8-bit values
+#define NET_ALIGN 32
+#define NET_INPUTS ((NET_INPUTS_USED + NET_ALIGN - 1) / NET_ALIGN * NET_ALIGN)
+#define NET_MAX_HIDDEN 256
+#define NET_MAX_BATCH 64
+#define NET_REQUANT_SHIFT 16
+
+#define NET_KERNELS_AUTO 0
+#define NET_KERNELS_SCALAR 1
+#define NET_KERNELS_AVX2 2
+
+typedef struct
+{
+    int inputs;
+    int outputs;
+    int8_t* weights;        // outputs x inputs, rows aligned to NET_ALIGN
+    int32_t* biases;
+    int32_t multiplier;     // hidden layers only
+    float scale;            // heads only, sum -> value
+}Net_layer;
+
+typedef struct
+{
+    Net_layer hidden1;
+    Net_layer hidden2;
+    Net_layer value;
+    int kernels;            // NET_KERNELS_SCALAR or NET_KERNELS_AVX2
+}Net;
+
+// The network of the bots unless they are given another, NULL = none
+extern const Net* default_net;
+
+int net_kernels_supported(int kernels);
+int net_load(Net* net, const char* path, int kernels);
+int net_save(const Net* net, const char* path);
+int net_alloc(Net* net, int hidden1, int hidden2);
+void net_free(Net* net);
+
+void net_encode(const Game* info, int player, uint8_t inputs[NET_INPUTS]);
+void net_evaluate_batch(const Net* net, const uint8_t* inputs, int no_of_positions, float* values);
+float net_evaluate(const Net* net, const Game* info, int player);
+
+#endif
@@ -0,0 +1,536 @@
+/*AZUL BOARD GAME - Game notation
+See azul_notation.h.
+*/
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "azul_notation.h"
+
+static const char* const color_names[HOW_MANY_TILES_TYPES] = {"blue", "red", "black", "yellow", "white"};
+static const char tile_letters[HOW_MANY_TILES_TYPES] = {'B', 'R', 'K', 'Y', 'W'};
+
+// Returns the length of the next space separated token (0 at the end) and
+// moves the cursor past it
+static int next_token(const char** cursor, const char* end, const char** token)
+{
+    const char* c = *cursor;
+    while(c < end && (*c == ' ' || *c == '\t'))
+    {
+        c++;
+    }
+    *token = c;
+    while(c < end && *c != ' ' && *c != '\t')
+    {
+        c++;
+    }
+    *cursor = c;
+    return (int)(c - *token);
+}
+
+static int token_is(const char* token, int length, const char* word)
+{
+    return (int)strlen(word) == length && memcmp(token, word, length) == 0;
+}
+
+// Reads a whole decimal number, returns 0 if the token is anything else
+static int parse_number(const char* token, int length, uint64_t* value)
+{
+    if(length == 0 || length > 20)
+    {
+        return 0;
+    }
+    *value = 0;
+    for(int i = 0; i < length; i++)
+    {
+        if(token[i] < '0' || token[i] > '9')
+        {
+            return 0;
+        }
+        *value = *value * 10 + (token[i] - '0');
+    }
+    return 1;
+}
+
+static int tile_from_letter(char letter)
+{
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        if(letter == tile_letters[color])
+        {
+            return color;
+        }
+    }
+    return -1;
+}
+
+// Returns the length of the text
+int format_move(Move move, char text[MAX_MOVE_TEXT])
+{
+    char source[8] = "M";
+    if(move.source != MIDDLE_PILE)
+    {
+        snprintf(source, sizeof(source), "F%d", move.source + 1);
+    }
+    if(move.pattern_line == FLOOR_LINE)
+    {
+        return snprintf(text, MAX_MOVE_TEXT, "%s %s floor", source, color_names[move.color]);
+    }
+    return snprintf(text, MAX_MOVE_TEXT, "%s %s L%d", source, color_names[move.color], move.pattern_line + 1);
+}
+
+// Reads "F3 red L2" or "M blue floor", returns 0 if the text is not a
+// move (legality is up to the caller)
+int parse_move(const char* text, int length, Move* move)
+{
+    const char* cursor = text;
+    const char* end = text + length;
+    const char* token;
+    int token_length;
+
+    token_length = next_token(&cursor, end, &token);
+    if(token_is(token, token_length, "M"))
+    {
+        move->source = MIDDLE_PILE;
+    }
+    else if(token_length == 2 && token[0] == 'F' && token[1] >= '1' && token[1] <= '0' + MAX_NUMBER_OF_FACTORIES)
+    {
+        move->source = token[1] - '1';
+    }
+    else
+    {
+        return 0;
+    }
+
+    token_length = next_token(&cursor, end, &token);
+    move->color = -1;
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        if(token_is(token, token_length, color_names[color]))
+        {
+            move->color = color;
+        }
+    }
+    if(move->color == -1)
+    {
+        return 0;
+    }
+
+    token_length = next_token(&cursor, end, &token);
+    if(token_is(token, token_length, "floor"))
+    {
+        move->pattern_line = FLOOR_LINE;
+    }
+    else if(token_length == 2 && token[0] == 'L' && token[1] >= '1' && token[1] <= '0' + HOW_MANY_TILES_TYPES)
+    {
+        move->pattern_line = token[1] - '1';
+    }
+    else
+    {
+        return 0;
+    }
+    return next_token(&cursor, end, &token) == 0;
+}
+
+// The format_* functions write one line without its newline and return
+// its length. `seed` may be NULL for a game whose fills are written out.
+int format_game_line(int no_of_players, const uint64_t* seed, char text[MAX_LINE_TEXT])
+{
+    if(seed != NULL)
+    {
+        return snprintf(text, MAX_LINE_TEXT, "game %d seed %" PRIu64, no_of_players, *seed);
+    }
+    return snprintf(text, MAX_LINE_TEXT, "game %d", no_of_players);
+}
+
+// Call right after start_round()
+int format_fill_line(const Game* info, char text[MAX_LINE_TEXT])
+{
+    int length = snprintf(text, MAX_LINE_TEXT, "fill");
+    for(int f = 0; f < info->no_of_factory_displays; f++)
+    {
+        int no_of_letters = 0;
+        text[length++] = ' ';
+        for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+        {
+            int color = info->factory_displays.all_factories[f][i];
+            if(color >= 0 && color < HOW_MANY_TILES_TYPES)
+            {
+                text[length++] = tile_letters[color];
+                no_of_letters++;
+            }
+        }
+        if(no_of_letters == 0)
+        {
+            text[length++] = '-';
+        }
+    }
+    text[length] = '\0';
+    return length;
+}
+
+// Call after calculate_final_bonuses()
+int format_end_line(const Game* info, char text[MAX_LINE_TEXT])
+{
+    int length = snprintf(text, MAX_LINE_TEXT, "end");
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        length += snprintf(text + length, MAX_LINE_TEXT - length, " %u", info->players[p].mat.score);
+    }
+    return length;
+}
+
+void notation_write_game(FILE* out, int no_of_players, const uint64_t* seed)
+{
+    char text[MAX_LINE_TEXT];
+    format_game_line(no_of_players, seed, text);
+    fputs(text, out);
+    fputc('\n', out);
+}
+
+void notation_write_fill(FILE* out, const Game* info)
+{
+    char text[MAX_LINE_TEXT];
+    format_fill_line(info, text);
+    fputs(text, out);
+    fputc('\n', out);
+}
+
+void notation_write_move(FILE* out, Move move)
+{
+    char text[MAX_MOVE_TEXT];
+    format_move(move, text);
+    fputs(text, out);
+    fputc('\n', out);
+}
+
+void notation_write_end(FILE* out, const Game* info)
+{
+    char text[MAX_LINE_TEXT];
+    format_end_line(info, text);
+    fputs(text, out);
+    fputc('\n', out);
+}
+
+// Writes an archived game with its seed and fills. Returns 0 if the
+// record does not replay (nothing is written past the bad move).
+int notation_write_archived_game(FILE* out, const Archive_record* record)
+{
+    const Archive_record_header* header = record->header;
+    const uint8_t* cursor = record->moves;
+    const uint8_t* end = record->moves + header->moves_size;
+    uint64_t seed = header->seed;
+    Game info;
+
+    memset(&info, 0, sizeof(info));
+    init_game(&info, header->no_of_players, seed);
+    notation_write_game(out, header->no_of_players, &seed);
+    for(int round = 0; round < header->rounds; round++)
+    {
+        start_round(&info);
+        notation_write_fill(out, &info);
+        while(!is_round_over(&info))
+        {
+            if(cursor >= end || (cursor[0] >= 0x80 && cursor + 1 >= end))
+            {
+                return 0;
+            }
+            Move move = archive_unpack_move(&cursor);
+            if(!apply_move(&info, move))
+            {
+                return 0;
+            }
+            notation_write_move(out, move);
+        }
+        process_end_of_round(&info, NULL);
+    }
+    calculate_final_bonuses(&info, NULL);
+    notation_write_end(out, &info);
+    return 1;
+}
+
+static int replay_error(Notation_replayer* state, const char* message)
+{
+    state->replay->error_line = state->replay->lines;
+    snprintf(state->replay->error, NOTATION_ERROR_SIZE, "%s", message);
+    return 0;
+}
+
+static int replay_game_line(Notation_replayer* state, const char* cursor, const char* end)
+{
+    const char* token;
+    int length;
+    uint64_t value;
+
+    if(state->in_game)
+    {
+        return replay_error(state, "previous game has no end line");
+    }
+    length = next_token(&cursor, end, &token);
+    if(!parse_number(token, length, &value) || value < 2 || value > MAX_PLAYERS)
+    {
+        return replay_error(state, "a game needs 2-4 players");
+    }
+    int no_of_players = (int)value;
+
+    state->has_seed = 0;
+    length = next_token(&cursor, end, &token);
+    if(token_is(token, length, "seed"))
+    {
+        length = next_token(&cursor, end, &token);
+        if(!parse_number(token, length, &value))
+        {
+            return replay_error(state, "bad seed");
+        }
+        state->has_seed = 1;
+        length = next_token(&cursor, end, &token);
+    }
+    if(length != 0)
+    {
+        return replay_error(state, "unexpected text after the game line");
+    }
+
+    memset(&state->game, 0, sizeof(state->game));
+    init_game(&state->game, no_of_players, state->has_seed ? value : 0);
+    state->in_game = 1;
+    state->round_started = 0;
+    return 1;
+}
+
+static int replay_fill_line(Notation_replayer* state, const char* cursor, const char* end)
+{
+    Game* info = &state->game;
+    int tiles[MAX_NUMBER_OF_FACTORIES][HOW_MANY_TILES_ON_FACTORY];
+    const char* token;
+    int length;
+
+    if(!state->in_game)
+    {
+        return replay_error(state, "fill outside a game");
+    }
+    if(state->round_started)
+    {
+        if(!is_round_over(info))
+        {
+            return replay_error(state, "fill before the round is over");
+        }
+        process_end_of_round(info, NULL);
+        if(check_game_end(info))
+        {
+            return replay_error(state, "fill after the last round");
+        }
+    }
+    start_round(info);
+    state->round_started = 1;
+
+    for(int f = 0; f < MAX_NUMBER_OF_FACTORIES; f++)
+    {
+        length = next_token(&cursor, end, &token);
+        if(f >= info->no_of_factory_displays)
+        {
+            if(length != 0)
+            {
+                return replay_error(state, "too many factories");
+            }
+            break;
+        }
+        if(length == 0 || length > HOW_MANY_TILES_ON_FACTORY)
+        {
+            return replay_error(state, "a factory needs 1-4 tiles or '-'");
+        }
+        for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+        {
+            tiles[f][i] = BLOCKED;
+        }
+        if(token_is(token, length, "-"))
+        {
+            continue;
+        }
+        for(int i = 0; i < length; i++)
+        {
+            tiles[f][i] = tile_from_letter(token[i]);
+            if(tiles[f][i] == -1)
+            {
+                return replay_error(state, "unknown tile letter");
+            }
+        }
+    }
+
+    if(!state->has_seed)
+    {
+        if(!set_factory_tiles(info, tiles))
+        {
+            return replay_error(state, "the bag does not hold these tiles");
+        }
+        return 1;
+    }
+    for(int f = 0; f < info->no_of_factory_displays; f++)
+    {
+        for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+        {
+            if(tiles[f][i] != info->factory_displays.all_factories[f][i])
+            {
+                return replay_error(state, "fill differs from the one drawn from the seed");
+            }
+        }
+    }
+    return 1;
+}
+
+static int replay_end_line(Notation_replayer* state, const char* cursor, const char* end)
+{
+    Game* info = &state->game;
+    const char* token;
+    int length;
+    uint64_t value;
+
+    if(!state->in_game || !state->round_started || !is_round_over(info))
+    {
+        return replay_error(state, "end before the last round is over");
+    }
+    process_end_of_round(info, NULL);
+    calculate_final_bonuses(info, NULL);
+
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        length = next_token(&cursor, end, &token);
+        if(!parse_number(token, length, &value))
+        {
+            return replay_error(state, "end needs one score per player");
+        }
+        if(value != info->players[p].mat.score)
+        {
+            return replay_error(state, "final score differs from the replay");
+        }
+    }
+    if(next_token(&cursor, end, &token) != 0)
+    {
+        return replay_error(state, "end needs one score per player");
+    }
+    state->in_game = 0;
+    state->replay->games++;
+    return 1;
+}
+
+void notation_start_replay(Notation_replayer* state, Notation_replay* replay)
+{
+    memset(replay, 0, sizeof(*replay));
+    state->in_game = 0;
+    state->replay = replay;
+}
+
+// Plays one line (without its newline) on the replayer's game. Returns 0
+// if the line is not valid there, the replay then tells why.
+int notation_replay_line(Notation_replayer* state, const char* line, const char* end)
+{
+    const char* comment = memchr(line, '#', end - line);
+    if(comment != NULL)
+    {
+        end = comment;
+    }
+    while(end > line && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+    {
+        end--;
+    }
+
+    const char* cursor = line;
+    const char* token;
+    int length = next_token(&cursor, end, &token);
+    if(length == 0)
+    {
+        return 1;
+    }
+    if(token_is(token, length, "game"))
+    {
+        return replay_game_line(state, cursor, end);
+    }
+    if(token_is(token, length, "fill"))
+    {
+        return replay_fill_line(state, cursor, end);
+    }
+    if(token_is(token, length, "end"))
+    {
+        return replay_end_line(state, cursor, end);
+    }
+
+    Move move;
+    if(!parse_move(token, (int)(end - token), &move))
+    {
+        return replay_error(state, "not a game, fill, move or end line");
+    }
+    if(!state->in_game || !state->round_started)
+    {
+        return replay_error(state, "move before the first fill");
+    }
+    if(!apply_move(&state->game, move))
+    {
+        return replay_error(state, "illegal move");
+    }
+    state->replay->moves++;
+    return 1;
+}
+
+// Replays every game of the stream. Returns 0 at the first bad line,
+// `replay` then tells which one and why.
+int notation_replay_stream(FILE* in, Notation_replay* replay)
+{
+    Notation_replayer* state = malloc(sizeof(Notation_replayer));
+    char* buffer = malloc(NOTATION_BUFFER_SIZE);
+    size_t start = 0, filled = 0;
+    int at_eof = 0, ok = 1;
+
+    memset(replay, 0, sizeof(*replay));
+    if(state == NULL || buffer == NULL)
+    {
+        free(state);
+        free(buffer);
+        snprintf(replay->error, NOTATION_ERROR_SIZE, "out of memory");
+        return 0;
+    }
+    notation_start_replay(state, replay);
+
+    while(ok)
+    {
+        char* newline = memchr(buffer + start, '\n', filled - start);
+        if(newline == NULL && !at_eof)
+        {
+            // Keep the partial line and read behind it
+            memmove(buffer, buffer + start, filled - start);
+            filled -= start;
+            start = 0;
+            if(filled == NOTATION_BUFFER_SIZE)
+            {
+                replay->lines++;
+                ok = replay_error(state, "line too long");
+                break;
+            }
+            size_t got = fread(buffer + filled, 1, NOTATION_BUFFER_SIZE - filled, in);
+            replay->bytes += got;
+            filled += got;
+            at_eof = got == 0;
+            continue;
+        }
+        if(newline == NULL)
+        {
+            // Last line without a newline
+            if(start < filled)
+            {
+                replay->lines++;
+                ok = notation_replay_line(state, buffer + start, buffer + filled);
+            }
+            break;
+        }
+        replay->lines++;
+        ok = notation_replay_line(state, buffer + start, newline);
+        start = newline + 1 - buffer;
+    }
+
+    if(ok && state->in_game)
+    {
+        ok = replay_error(state, "last game has no end line");
+    }
+    free(state);
+    free(buffer);
+    return ok;
+}
@@ -0,0 +1,75 @@
+/*AZUL BOARD GAME - Game notation
+
+A plain text form of complete games, one item per line:
+
+    # anything after a '#' is a comment, blank lines are skipped
+    game 2 seed 1234        a game of 2-4 players, the seed is optional
+    fill BBRK YYWW KWRB ...  tiles of every factory when a round starts,
+                            B blue, R red, K black, Y yellow, W white,
+                            "-" for a factory left empty
+    F3 red L2               factory 3 (from 1), red tiles, pattern line 2
+    M blue floor            middle pile, blue tiles, floor line
+    end 28 0                final scores, after the bonuses
+
+Factories and pattern lines are counted from 1. With a seed the fills
+must be the ones our generator draws; without one they are put on the
+factories as written, so games from other programs can be replayed.
+
+The replayer reads the stream through a fixed buffer one line at a time
+and plays every line through the rules as it goes, so files of any size
+are checked without being loaded.
+*/
+
+#ifndef AZUL_NOTATION_H
+#define AZUL_NOTATION_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "azul_archive.h"
+#include "azul_rules.h"
+
+// Longest move text, "F9 yellow floor" and its '\0'
+#define MAX_MOVE_TEXT 16
+// Longest game, fill or end line and its '\0'
+#define MAX_LINE_TEXT 64
+#define NOTATION_BUFFER_SIZE (1 << 20)
+#define NOTATION_ERROR_SIZE 96
+
+typedef struct
+{
+    long games;
+    long moves;
+    long lines;
+    long long bytes;
+    long error_line;                 // 0 if the stream replayed cleanly
+    char error[NOTATION_ERROR_SIZE];
+}Notation_replay;
+
+// A replay in progress, fed one line at a time
+typedef struct
+{
+    Game game;
+    int in_game;
+    int has_seed;
+    int round_started;
+    Notation_replay* replay;
+}Notation_replayer;
+
+int format_move(Move move, char text[MAX_MOVE_TEXT]);
+int parse_move(const char* text, int length, Move* move);
+int format_game_line(int no_of_players, const uint64_t* seed, char text[MAX_LINE_TEXT]);
+int format_fill_line(const Game* info, char text[MAX_LINE_TEXT]);
+int format_end_line(const Game* info, char text[MAX_LINE_TEXT]);
+
+void notation_write_game(FILE* out, int no_of_players, const uint64_t* seed);
+void notation_write_fill(FILE* out, const Game* info);
+void notation_write_move(FILE* out, Move move);
+void notation_write_end(FILE* out, const Game* info);
+int notation_write_archived_game(FILE* out, const Archive_record* record);
+
+void notation_start_replay(Notation_replayer* state, Notation_replay* replay);
+int notation_replay_line(Notation_replayer* state, const char* line, const char* end);
+int notation_replay_stream(FILE* in, Notation_replay* replay);
+
+#endif
@@ -0,0 +1,144 @@
+/*AZUL BOARD GAME - Packed game state
+See azul_packed.h for the layout.
+*/
+
+#include <string.h>
+
+#include "azul_packed.h"
+#include "azul_zobrist.h"
+
+static uint32_t pack_floor_line(const Mat* mat)
+{
+    uint32_t floor_line = 0;
+    for(int i = 0; i < MAX_PENALTIES; i++)
+    {
+        uint32_t slot = PACKED_FLOOR_EMPTY;
+        if(mat->penalties[i] == TOKEN_MARKER)
+        {
+            slot = PACKED_FLOOR_TOKEN;
+        }
+        else if(mat->penalties[i] >= 0 && mat->penalties[i] < HOW_MANY_TILES_TYPES)
+        {
+            slot = mat->penalties[i] + 1;
+        }
+        floor_line |= slot << (3 * i);
+    }
+    return floor_line;
+}
+
+static void unpack_floor_line(uint32_t floor_line, Mat* mat)
+{
+    for(int i = 0; i < MAX_PENALTIES; i++)
+    {
+        int slot = (floor_line >> (3 * i)) & 7;
+        if(slot == PACKED_FLOOR_EMPTY)
+        {
+            mat->penalties[i] = AVAILABLE;
+        }
+        else if(slot == PACKED_FLOOR_TOKEN)
+        {
+            mat->penalties[i] = TOKEN_MARKER;
+        }
+        else
+        {
+            mat->penalties[i] = slot - 1;
+        }
+    }
+}
+
+void pack_game(const Game* info, Packed_game* packed)
+{
+    memset(packed, 0, sizeof(*packed));
+
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        const Mat* mat = &info->players[p].mat;
+        Packed_player* player = &packed->players[p];
+
+        player->portugese_wall = mat->portugese_wall;
+        player->floor_line = pack_floor_line(mat);
+        player->score = mat->score;
+        player->is_token_present = info->players[p].is_token_present;
+        for(int line = 0; line < 5; line++)
+        {
+            int count = pattern_line_count(mat, line);
+            int color = count > 0 ? pattern_line_color(mat, line) : 0;
+            player->pattern_lines[line] = color << 4 | count;
+        }
+    }
+
+    for(int f = 0; f < info->no_of_factory_displays; f++)
+    {
+        for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+        {
+            packed->factories[f] |= count_tiles_in_source(info, f, color) << (3 * color);
+        }
+    }
+
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        packed->bag[color] = info->bag.all_tiles[color];
+        packed->box_lid[color] = info->box_lid.all_tiles[color];
+        packed->middle_pile[color] = info->middle_pile.all_tiles[color];
+    }
+    packed->middle_token = info->middle_pile.is_token_present;
+    packed->no_of_players = info->no_of_players;
+    packed->player_on_move = info->flow.player_on_move;
+    packed->round_number = info->flow.round_number;
+    packed->selections_until_round_finish = info->flow.selections_until_round_finish;
+}
+
+// Player names and the random generator in `info` are left untouched. Factory tiles come back
+// sorted by color, the packed state does not keep their order.
+void unpack_game(const Packed_game* packed, Game* info)
+{
+    info->no_of_players = packed->no_of_players;
+    set_the_no_of_factories(info);
+    initialise_mat(info);
+
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        const Packed_player* player = &packed->players[p];
+        Mat* mat = &info->players[p].mat;
+
+        mat->portugese_wall = player->portugese_wall;
+        unpack_floor_line(player->floor_line, mat);
+        mat->score = player->score;
+        info->players[p].is_token_present = player->is_token_present;
+        for(int line = 0; line < 5; line++)
+        {
+            int color = player->pattern_lines[line] >> 4;
+            int count = player->pattern_lines[line] & 0xF;
+            for(int col = HOW_MANY_TILES_TYPES - 1; col > HOW_MANY_TILES_TYPES - 1 - count; col--)
+            {
+                mat->pattern_lines[line][col] = color;
+            }
+        }
+    }
+
+    initialise_factory_displays(info);
+    for(int f = 0; f < info->no_of_factory_displays; f++)
+    {
+        int slot = 0;
+        for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+        {
+            int count = (packed->factories[f] >> (3 * color)) & 7;
+            while(count-- > 0 && slot < HOW_MANY_TILES_ON_FACTORY)
+            {
+                info->factory_displays.all_factories[f][slot++] = color;
+            }
+        }
+    }
+
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        info->bag.all_tiles[color] = packed->bag[color];
+        info->box_lid.all_tiles[color] = packed->box_lid[color];
+        info->middle_pile.all_tiles[color] = packed->middle_pile[color];
+    }
+    info->middle_pile.is_token_present = packed->middle_token;
+    info->flow.player_on_move = packed->player_on_move;
+    info->flow.round_number = packed->round_number;
+    info->flow.selections_until_round_finish = packed->selections_until_round_finish;
+    info->hash = compute_game_hash(info);
+}
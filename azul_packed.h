@@ -0,0 +1,57 @@
+/*AZUL BOARD GAME - Packed game state
+
+A copy of Game that keeps only what the rules need, small enough to be
+copied around by searches: 104 bytes whatever the number of players,
+held under two cache lines by the _Static_assert below, while Game is
+~8 times that. Player names and the game's random generator are not
+part of it.
+
+The searches still copy Game: unpack_game() recomputes the hash, which
+costs more than the copy it would save. tools/azul_perft.c --check
+sends every position it counts through pack_game() and unpack_game(),
+so the format stays in step with the rules.
+
+    - pattern line: color << 4 | count
+    - floor line:   7 slots of 3 bits, 0 = empty, 1-5 = color + 1, 6 = token
+    - factory:      5 colors of 3 bits, the number of tiles of each color
+*/
+
+#ifndef AZUL_PACKED_H
+#define AZUL_PACKED_H
+
+#include <stdint.h>
+
+#include "azul_rules.h"
+
+#define PACKED_FLOOR_EMPTY 0
+#define PACKED_FLOOR_TOKEN 6
+
+typedef struct
+{
+    uint32_t portugese_wall;
+    uint32_t floor_line;
+    uint16_t score;
+    uint8_t pattern_lines[5];
+    uint8_t is_token_present;
+}Packed_player;
+
+typedef struct
+{
+    Packed_player players[MAX_PLAYERS];
+    uint16_t factories[MAX_NUMBER_OF_FACTORIES];
+    uint8_t bag[HOW_MANY_TILES_TYPES];
+    uint8_t box_lid[HOW_MANY_TILES_TYPES];
+    uint8_t middle_pile[HOW_MANY_TILES_TYPES];
+    uint8_t middle_token;
+    uint8_t no_of_players;
+    uint8_t player_on_move;
+    uint8_t round_number;
+    uint8_t selections_until_round_finish;
+}Packed_game;
+
+_Static_assert(sizeof(Packed_game) <= 128, "Packed_game must fit in two cache lines");
+
+void pack_game(const Game* info, Packed_game* packed);
+void unpack_game(const Packed_game* packed, Game* info);
+
+#endif
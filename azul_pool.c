@@ -0,0 +1,185 @@
+/*AZUL BOARD GAME - Work-stealing thread pool
+See azul_pool.h.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "azul_pool.h"
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    long begin;
+    long end;
+}Task_range;
+
+typedef struct
+{
+    Task_range* ranges;
+    int no_of_threads;
+    Pool_task task;
+    void* arg;
+}Pool;
+
+typedef struct
+{
+    Pool* pool;
+    int worker_idx;
+}Pool_worker;
+
+int online_core_count(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+// Takes the next task of the worker's own range, -1 if it is empty
+static long pop_own_task(Task_range* range)
+{
+    long task_idx = -1;
+    pthread_mutex_lock(&range->lock);
+    if(range->begin < range->end)
+    {
+        task_idx = range->begin++;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return task_idx;
+}
+
+// Moves the back half of the fullest other range into the worker's own
+// range. Returns 0 when there is nothing left anywhere.
+static int steal_tasks(Pool* pool, int worker_idx)
+{
+    while(1)
+    {
+        int victim = -1;
+        long most = 0;
+        for(int i = 0; i < pool->no_of_threads; i++)
+        {
+            if(i == worker_idx)
+            {
+                continue;
+            }
+            pthread_mutex_lock(&pool->ranges[i].lock);
+            long left = pool->ranges[i].end - pool->ranges[i].begin;
+            pthread_mutex_unlock(&pool->ranges[i].lock);
+            if(left > most)
+            {
+                most = left;
+                victim = i;
+            }
+        }
+        if(victim == -1)
+        {
+            return 0;
+        }
+
+        Task_range* from = &pool->ranges[victim];
+        long stolen_begin = 0;
+        long stolen_end = 0;
+        pthread_mutex_lock(&from->lock);
+        long left = from->end - from->begin;
+        if(left > 0)
+        {
+            stolen_end = from->end;
+            stolen_begin = from->end - (left + 1) / 2;
+            from->end = stolen_begin;
+        }
+        pthread_mutex_unlock(&from->lock);
+
+        if(stolen_end > stolen_begin)
+        {
+            Task_range* own = &pool->ranges[worker_idx];
+            pthread_mutex_lock(&own->lock);
+            own->begin = stolen_begin;
+            own->end = stolen_end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+}
+
+static void* pool_worker_main(void* arg)
+{
+    Pool_worker* worker = arg;
+    Pool* pool = worker->pool;
+
+    while(1)
+    {
+        long task_idx = pop_own_task(&pool->ranges[worker->worker_idx]);
+        if(task_idx == -1)
+        {
+            if(!steal_tasks(pool, worker->worker_idx))
+            {
+                break;
+            }
+            continue;
+        }
+        pool->task(task_idx, worker->worker_idx, pool->arg);
+    }
+    return NULL;
+}
+
+// Blocks until every task has run. `no_of_threads` <= 0 uses all cores.
+void run_parallel_tasks(long no_of_tasks, int no_of_threads, Pool_task task, void* arg)
+{
+    if(no_of_threads <= 0)
+    {
+        no_of_threads = online_core_count();
+    }
+
+    Pool pool;
+    pool.ranges = malloc(sizeof(Task_range) * no_of_threads);
+    Pool_worker* workers = malloc(sizeof(Pool_worker) * no_of_threads);
+    pthread_t* threads = malloc(sizeof(pthread_t) * no_of_threads);
+    if(pool.ranges == NULL || workers == NULL || threads == NULL)
+    {
+        // Not enough memory for the pool, run everything here
+        for(long i = 0; i < no_of_tasks; i++)
+        {
+            task(i, 0, arg);
+        }
+        free(pool.ranges);
+        free(workers);
+        free(threads);
+        return;
+    }
+    pool.no_of_threads = no_of_threads;
+    pool.task = task;
+    pool.arg = arg;
+
+    for(int i = 0; i < no_of_threads; i++)
+    {
+        pthread_mutex_init(&pool.ranges[i].lock, NULL);
+        pool.ranges[i].begin = no_of_tasks * i / no_of_threads;
+        pool.ranges[i].end = no_of_tasks * (i + 1) / no_of_threads;
+        workers[i].pool = &pool;
+        workers[i].worker_idx = i;
+    }
+
+    // The calling thread is worker 0. The range of a worker that cannot
+    // be started is stolen by the others.
+    int no_of_started = 0;
+    for(int i = 1; i < no_of_threads; i++)
+    {
+        if(pthread_create(&threads[no_of_started], NULL, pool_worker_main, &workers[i]) == 0)
+        {
+            no_of_started++;
+        }
+    }
+    pool_worker_main(&workers[0]);
+    for(int i = 0; i < no_of_started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    for(int i = 0; i < no_of_threads; i++)
+    {
+        pthread_mutex_destroy(&pool.ranges[i].lock);
+    }
+    free(pool.ranges);
+    free(workers);
+    free(threads);
+}
@@ -0,0 +1,17 @@
+/*AZUL BOARD GAME - Work-stealing thread pool
+
+Runs task 0 .. no_of_tasks - 1 on a number of threads. Each thread starts
+with an equal slice of the tasks and takes them from the front; a thread
+that runs out steals the back half of the largest slice left, so slow
+tasks (long games, search bots) do not leave cores idle.
+*/
+
+#ifndef AZUL_POOL_H
+#define AZUL_POOL_H
+
+typedef void (*Pool_task)(long task_idx, int worker_idx, void* arg);
+
+int online_core_count(void);
+void run_parallel_tasks(long no_of_tasks, int no_of_threads, Pool_task task, void* arg);
+
+#endif
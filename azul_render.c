@@ -0,0 +1,368 @@
+/*AZUL BOARD GAME - Terminal renderer
+See azul_render.h.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "azul_render.h"
+
+// Every style starts with a reset so switching costs one sequence
+static const char* style_codes[NO_OF_STYLES] = {
+    "\x1b[0m",
+    "\x1b[0;1m",
+    "\x1b[0;34;1m",   // Blue tile
+    "\x1b[0;31;1m",   // Red tile
+    "\x1b[0;90;1m",   // Black tile (gray, visible on black terminals)
+    "\x1b[0;33;1m",   // Yellow tile
+    "\x1b[0;37;1m",   // White tile
+    "\x1b[0;44;97m",  // Blue cover
+    "\x1b[0;41;97m",  // Red cover
+    "\x1b[0;40;97m",  // Black cover
+    "\x1b[0;43;30m",  // Yellow cover
+    "\x1b[0;47;30m"   // White cover
+};
+
+static const char tile_letters[HOW_MANY_TILES_TYPES] = {'B', 'R', 'K', 'Y', 'W'};
+
+// Player boards, two per band of BOARD_ROWS rows
+#define BOARD_ROWS 10
+#define BOARD_COLS 40
+#define FACTORIES_PER_LINE 5
+
+void frame_clear(Frame* frame)
+{
+    frame->rows = 0;
+    for(int r = 0; r < FRAME_ROWS; r++)
+    {
+        for(int c = 0; c < FRAME_COLS; c++)
+        {
+            frame->cells[r][c].ch = ' ';
+            frame->cells[r][c].style = STYLE_PLAIN;
+        }
+    }
+}
+
+// Text is clipped at the frame border
+void frame_put_text(Frame* frame, int row, int col, const char* text, int style)
+{
+    if(row < 0 || row >= FRAME_ROWS)
+    {
+        return;
+    }
+    for(; *text != '\0' && col < FRAME_COLS; text++, col++)
+    {
+        if(col >= 0)
+        {
+            frame->cells[row][col].ch = *text;
+            frame->cells[row][col].style = style;
+        }
+    }
+    if(row >= frame->rows)
+    {
+        frame->rows = row + 1;
+    }
+}
+
+// A tile is three cells, " B " on its color
+static void frame_put_tile(Frame* frame, int row, int col, int color, int covered)
+{
+    char text[4] = {' ', tile_letters[color], ' ', '\0'};
+    if(!covered)
+    {
+        text[1] = tile_letters[color] - 'A' + 'a';
+    }
+    frame_put_text(frame, row, col, text, (covered ? STYLE_COVER : STYLE_TILE) + color);
+}
+
+static void frame_draw_player(Frame* frame, const Game* info, int p, int top, int left)
+{
+    const Mat* mat = &info->players[p].mat;
+    char text[FRAME_COLS + 1];
+
+    snprintf(text, sizeof(text), "%d. %-10.10s Score: %3u%s", p + 1, info->players[p].player_name,
+             mat->score, p == info->flow.player_on_move ? "  <" : "");
+    frame_put_text(frame, top, left, text, STYLE_BOLD);
+
+    for(int row = 0; row < 5; row++)
+    {
+        // Pattern line, right aligned next to the wall
+        for(int i = 0; i < 5; i++)
+        {
+            int cell = mat->pattern_lines[row][i];
+            int col = left + 3 * i;
+            if(cell >= 0 && cell < HOW_MANY_TILES_TYPES)
+            {
+                frame_put_tile(frame, top + 1 + row, col, cell, 1);
+            }
+            else if(cell == AVAILABLE)
+            {
+                frame_put_text(frame, top + 1 + row, col, " . ", STYLE_PLAIN);
+            }
+        }
+        frame_put_text(frame, top + 1 + row, left + 15, ">", STYLE_PLAIN);
+
+        for(int col = 0; col < 5; col++)
+        {
+            frame_put_tile(frame, top + 1 + row, left + 17 + 3 * col, get_portugese_wall_color(row, col),
+                           (mat->portugese_wall & WALL_BIT(row, col)) != 0);
+        }
+    }
+
+    frame_put_text(frame, top + 6, left, "Floor:", STYLE_PLAIN);
+    for(int i = 0; i < MAX_PENALTIES; i++)
+    {
+        int slot = mat->penalties[i];
+        int col = left + 7 + 3 * i;
+        if(slot >= 0 && slot < HOW_MANY_TILES_TYPES)
+        {
+            frame_put_tile(frame, top + 6, col, slot, 1);
+        }
+        else if(slot == TOKEN_MARKER)
+        {
+            frame_put_text(frame, top + 6, col, "[1]", STYLE_BOLD);
+        }
+        else
+        {
+            frame_put_text(frame, top + 6, col, "[ ]", STYLE_PLAIN);
+        }
+    }
+    for(int i = 0; i < MAX_PENALTIES; i++)
+    {
+        snprintf(text, sizeof(text), "%2d", floor_penalties[i]);
+        frame_put_text(frame, top + 7, left + 7 + 3 * i, text, STYLE_PLAIN);
+    }
+}
+
+void frame_draw_game(Frame* frame, const Game* info, const char* status_line)
+{
+    char text[FRAME_COLS + 1];
+    int factory_top = (info->no_of_players + 1) / 2 * BOARD_ROWS;
+
+    frame_clear(frame);
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        frame_draw_player(frame, info, p, (p / 2) * BOARD_ROWS, (p % 2) * BOARD_COLS);
+    }
+
+    snprintf(text, sizeof(text), "Round %d - Factories:", info->flow.round_number);
+    frame_put_text(frame, factory_top, 0, text, STYLE_BOLD);
+    for(int f = 0; f < info->no_of_factory_displays; f++)
+    {
+        int row = factory_top + 1 + f / FACTORIES_PER_LINE;
+        int col = (f % FACTORIES_PER_LINE) * 16;
+        snprintf(text, sizeof(text), "%d:", f + 1);
+        frame_put_text(frame, row, col, text, STYLE_PLAIN);
+        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+        {
+            int tile = info->factory_displays.all_factories[f][j];
+            if(tile >= 0 && tile < HOW_MANY_TILES_TYPES)
+            {
+                frame_put_tile(frame, row, col + 2 + 3 * j, tile, 1);
+            }
+        }
+    }
+
+    int row = factory_top + 3;
+    frame_put_text(frame, row, 0, "Middle:", STYLE_BOLD);
+    int col = 8;
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        if(info->middle_pile.all_tiles[color] > 0)
+        {
+            frame_put_tile(frame, row, col, color, 1);
+            snprintf(text, sizeof(text), "x%-2d", info->middle_pile.all_tiles[color]);
+            frame_put_text(frame, row, col + 3, text, STYLE_PLAIN);
+            col += 7;
+        }
+    }
+    if(info->middle_pile.is_token_present)
+    {
+        frame_put_text(frame, row, col, "[TOKEN]", STYLE_BOLD);
+    }
+
+    if(status_line)
+    {
+        frame_put_text(frame, factory_top + 5, 0, status_line, STYLE_BOLD);
+    }
+}
+
+// Set by SIGWINCH, the size is read again at the next render
+static volatile sig_atomic_t size_changed = 1;
+
+// The terminal must not keep the scrolling region once the program ends
+static Renderer* renderer_at_exit = NULL;
+
+static void note_size_change(int signal_number)
+{
+    (void)signal_number;
+    size_changed = 1;
+}
+
+static void write_all(int fd, const char* data, size_t left)
+{
+    while(left > 0)
+    {
+        ssize_t written = write(fd, data, left);
+        if(written <= 0)
+        {
+            break;
+        }
+        data += written;
+        left -= written;
+    }
+}
+
+static void release_at_exit(void)
+{
+    renderer_invalidate(renderer_at_exit);
+}
+
+// Unknown sizes count as the classic 80x24
+static void read_terminal_size(Renderer* renderer)
+{
+    struct winsize size;
+    renderer->screen_rows = 24;
+    renderer->screen_cols = 80;
+    if(ioctl(renderer->fd, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0)
+    {
+        renderer->screen_rows = size.ws_row;
+        renderer->screen_cols = size.ws_col;
+    }
+}
+
+void renderer_init(Renderer* renderer, int fd)
+{
+    renderer->fd = fd;
+    renderer->screen_valid = 0;
+    renderer->frame_rows = 0;
+
+    // SA_RESTART, so a resize does not cut short the read of a move
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = note_size_change;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, NULL);
+    size_changed = 1;
+
+    if(renderer_at_exit == NULL)
+    {
+        atexit(release_at_exit);
+    }
+    renderer_at_exit = renderer;
+}
+
+// Forces a full repaint, e.g. after other output scrolled the screen, and
+// gives the whole screen back to scrolling output
+void renderer_invalidate(Renderer* renderer)
+{
+    if(renderer->frame_rows > 0)
+    {
+        // Resetting the region homes the cursor, so save and restore it
+        static const char release[] = "\x1b" "7\x1b[r\x1b" "8";
+        fflush(stdout);
+        write_all(renderer->fd, release, sizeof(release) - 1);
+        renderer->frame_rows = 0;
+    }
+    renderer->screen_valid = 0;
+}
+
+static char* append_text(char* out, const char* text)
+{
+    while(*text != '\0')
+    {
+        *out++ = *text++;
+    }
+    return out;
+}
+
+static char* append_cursor_move(char* out, int row, int col)
+{
+    return out + sprintf(out, "\x1b[%d;%dH", row + 1, col + 1);
+}
+
+// Returns 0 and draws nothing if the frame does not fit the terminal
+int render_frame(Renderer* renderer, const Frame* frame)
+{
+    char* out = renderer->out;
+    int cursor_row = -1;
+    int cursor_col = -1;
+    int style = -1;
+
+    if(size_changed)
+    {
+        size_changed = 0;
+        read_terminal_size(renderer);
+        renderer_invalidate(renderer);
+    }
+    if(frame->rows + RENDER_MIN_PROMPT_ROWS > renderer->screen_rows || FRAME_COLS > renderer->screen_cols)
+    {
+        renderer_invalidate(renderer);
+        return 0;
+    }
+    if(frame->rows != renderer->frame_rows)
+    {
+        renderer_invalidate(renderer);
+    }
+
+    if(!renderer->screen_valid)
+    {
+        // Only the rows below the frame scroll
+        out = append_text(out, "\x1b[0m");
+        out += sprintf(out, "\x1b[%d;%dr", frame->rows + 1, renderer->screen_rows);
+        out = append_text(out, "\x1b[H\x1b[2J");
+        renderer->frame_rows = frame->rows;
+        cursor_row = 0;
+        cursor_col = 0;
+        style = STYLE_PLAIN;
+    }
+
+    // Rows the old frame used beyond the new one are cleared by "\x1b[J" below
+    for(int r = 0; r < frame->rows; r++)
+    {
+        for(int c = 0; c < FRAME_COLS; c++)
+        {
+            const Render_cell* cell = &frame->cells[r][c];
+            const Render_cell* shown = &renderer->screen.cells[r][c];
+            if(renderer->screen_valid && r < renderer->screen.rows &&
+               cell->ch == shown->ch && cell->style == shown->style)
+            {
+                continue;
+            }
+            // A cleared screen already shows blanks
+            if(!renderer->screen_valid && cell->ch == ' ' && cell->style == STYLE_PLAIN)
+            {
+                continue;
+            }
+            if(r != cursor_row || c != cursor_col)
+            {
+                out = append_cursor_move(out, r, c);
+            }
+            if(cell->style != style)
+            {
+                out = append_text(out, style_codes[cell->style]);
+                style = cell->style;
+            }
+            *out++ = cell->ch;
+            cursor_row = r;
+            cursor_col = c + 1;
+        }
+    }
+
+    // Leave the cursor below the frame and clear the old prompts
+    out = append_text(out, style_codes[STYLE_PLAIN]);
+    out = append_cursor_move(out, frame->rows, 0);
+    out = append_text(out, "\x1b[J");
+
+    // stdio output must reach the terminal before the frame
+    fflush(stdout);
+    write_all(renderer->fd, renderer->out, out - renderer->out);
+
+    renderer->screen = *frame;
+    renderer->screen_valid = 1;
+    return 1;
+}
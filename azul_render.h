@@ -0,0 +1,67 @@
+/*AZUL BOARD GAME - Terminal renderer
+
+The board is drawn into an in-memory frame of character cells, each with
+one of a few precomputed styles (escape sequences). render_frame()
+compares it with the frame on screen and sends only the changed cells,
+cursor moves and style switches included, in a single write(). Anything
+printed afterwards (prompts, messages) appears below the frame and is
+cleared by the next render.
+
+The rows below the frame are set as the terminal's scrolling region, so
+however much is printed there the frame itself never scrolls and the
+cells on screen stay where the diff expects them. The terminal size is
+read at the first render and after every SIGWINCH. When the frame and
+RENDER_MIN_PROMPT_ROWS do not fit, render_frame() draws nothing and
+returns 0, and the caller prints the game as lines instead.
+*/
+
+#ifndef AZUL_RENDER_H
+#define AZUL_RENDER_H
+
+#include "azul_rules.h"
+
+#define FRAME_ROWS 32
+#define FRAME_COLS 80
+#define RENDER_MIN_PROMPT_ROWS 6                      // below the frame, for prompts and messages
+
+#define STYLE_PLAIN 0
+#define STYLE_BOLD 1
+#define STYLE_TILE 2                                  // + color, colored letter
+#define STYLE_COVER (STYLE_TILE + HOW_MANY_TILES_TYPES) // + color, colored background
+#define NO_OF_STYLES (STYLE_COVER + HOW_MANY_TILES_TYPES)
+
+// Worst case output: every cell with a cursor move and a style switch
+#define RENDER_BUFFER_SIZE (FRAME_ROWS * FRAME_COLS * 24 + 64)
+
+typedef struct
+{
+    char ch;
+    unsigned char style;
+}Render_cell;
+
+typedef struct
+{
+    Render_cell cells[FRAME_ROWS][FRAME_COLS];
+    int rows;            // rows in use, prompts start below them
+}Frame;
+
+typedef struct
+{
+    Frame screen;        // what the terminal shows
+    int screen_valid;    // 0 = repaint everything on the next render
+    int screen_rows;     // size of the terminal
+    int screen_cols;
+    int frame_rows;      // rows kept out of the scrolling region, 0 = no region set
+    int fd;
+    char out[RENDER_BUFFER_SIZE];
+}Renderer;
+
+void frame_clear(Frame* frame);
+void frame_put_text(Frame* frame, int row, int col, const char* text, int style);
+void frame_draw_game(Frame* frame, const Game* info, const char* status_line);
+
+void renderer_init(Renderer* renderer, int fd);
+void renderer_invalidate(Renderer* renderer);
+int render_frame(Renderer* renderer, const Frame* frame);
+
+#endif
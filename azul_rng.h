@@ -0,0 +1,70 @@
+/*AZUL BOARD GAME - Random numbers
+
+xoshiro256** generator. Every game (and every search thread) owns one,
+seeded explicitly, so results can be replayed from the seed and do not
+depend on how games are spread over threads.
+*/
+
+#ifndef AZUL_RNG_H
+#define AZUL_RNG_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint64_t s[4];
+}Rng;
+
+static inline uint64_t splitmix64(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Seed of the `stream`-th independent generator of a run seeded with `seed`
+static inline uint64_t derive_seed(uint64_t seed, uint64_t stream)
+{
+    uint64_t state = seed;
+    uint64_t mixed = splitmix64(&state);
+    state = mixed ^ stream;
+    return splitmix64(&state);
+}
+
+static inline void rng_seed(Rng* rng, uint64_t seed)
+{
+    uint64_t state = seed;
+    for(int i = 0; i < 4; i++)
+    {
+        rng->s[i] = splitmix64(&state);
+    }
+}
+
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(Rng* rng)
+{
+    uint64_t* s = rng->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+// Uniform number in [0, bound), bound > 0
+static inline uint32_t rng_below(Rng* rng, uint32_t bound)
+{
+    return (uint32_t)(((rng_next(rng) >> 32) * (uint64_t)bound) >> 32);
+}
+
+#endif
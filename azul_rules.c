@@ -0,0 +1,1037 @@
+/*AZUL BOARD GAME - Headless rules core
+See azul_rules.h. Nothing in this file prints or reads input.
+*/
+
+#include <string.h>
+
+#include "azul_rules.h"
+#include "azul_zobrist.h"
+
+const int floor_penalties[MAX_PENALTIES] = {-1, -1, -2, -2, -2, -3, -3};
+
+const unsigned int wall_col_masks[5] = {
+    0x0108421, 0x0210842, 0x0421084, 0x0842108, 0x1084210
+};
+
+// Where each color appears on the Portuguese wall (one diagonal per color)
+const unsigned int wall_color_masks[HOW_MANY_TILES_TYPES] = {
+    0x1041041, // Blue
+    0x020C104, // Red
+    0x0410608, // Black
+    0x0182082, // Yellow
+    0x0820830  // White
+};
+
+// Column of each color on each wall row, wall_col_table[row][color]
+const unsigned char wall_col_table[5][HOW_MANY_TILES_TYPES] = {
+    {0, 2, 3, 1, 4},
+    {1, 3, 4, 2, 0},
+    {2, 4, 0, 3, 1},
+    {3, 0, 1, 4, 2},
+    {4, 1, 2, 0, 3}
+};
+
+// Length of the run of placed tiles through position i of a row or column
+// with occupancy `bits` (bit i = position i), run_length_table[bits][i]
+const unsigned char run_length_table[32][5] = {
+    {0, 0, 0, 0, 0}, {1, 0, 0, 0, 0}, {0, 1, 0, 0, 0}, {2, 2, 0, 0, 0},
+    {0, 0, 1, 0, 0}, {1, 0, 1, 0, 0}, {0, 2, 2, 0, 0}, {3, 3, 3, 0, 0},
+    {0, 0, 0, 1, 0}, {1, 0, 0, 1, 0}, {0, 1, 0, 1, 0}, {2, 2, 0, 1, 0},
+    {0, 0, 2, 2, 0}, {1, 0, 2, 2, 0}, {0, 3, 3, 3, 0}, {4, 4, 4, 4, 0},
+    {0, 0, 0, 0, 1}, {1, 0, 0, 0, 1}, {0, 1, 0, 0, 1}, {2, 2, 0, 0, 1},
+    {0, 0, 1, 0, 1}, {1, 0, 1, 0, 1}, {0, 2, 2, 0, 1}, {3, 3, 3, 0, 1},
+    {0, 0, 0, 2, 2}, {1, 0, 0, 2, 2}, {0, 1, 0, 2, 2}, {2, 2, 0, 2, 2},
+    {0, 0, 3, 3, 3}, {1, 0, 3, 3, 3}, {0, 4, 4, 4, 4}, {5, 5, 5, 5, 5}
+};
+
+void fill_the_bag(Bag* bag)
+{
+    for(int idx = 0; idx < HOW_MANY_TILES_TYPES; idx++)
+    {
+        bag->all_tiles[idx] = SAME_COLOR_TILES;
+    }
+}
+
+// Every change below is bracketed by a toggle of the old and the new value
+// so that Game.hash stays equal to compute_game_hash()
+static inline void toggle_bag_key(Game* info, int color)
+{
+    info->hash ^= zobrist_key(ZOBRIST_BAG, 0, color, info->bag.all_tiles[color]);
+}
+
+static inline void toggle_box_lid_key(Game* info, int color)
+{
+    info->hash ^= zobrist_key(ZOBRIST_BOX_LID, 0, color, info->box_lid.all_tiles[color]);
+}
+
+static inline void toggle_middle_pile_key(Game* info, int color)
+{
+    info->hash ^= zobrist_key(ZOBRIST_MIDDLE_PILE, 0, color, info->middle_pile.all_tiles[color]);
+}
+
+static inline void toggle_factory_key(Game* info, int factory, int color, int count)
+{
+    info->hash ^= zobrist_key(ZOBRIST_FACTORY, factory, color, count);
+}
+
+static inline void toggle_pattern_line_key(Game* info, int player_idx, int line)
+{
+    info->hash ^= zobrist_key(ZOBRIST_PATTERN_LINE, player_idx, line,
+                              pattern_line_code(&info->players[player_idx].mat, line));
+}
+
+static inline void toggle_floor_slot_key(Game* info, int player_idx, int slot)
+{
+    info->hash ^= zobrist_key(ZOBRIST_FLOOR, player_idx, slot,
+                              floor_slot_code(info->players[player_idx].mat.penalties[slot]));
+}
+
+static inline void toggle_score_key(Game* info, int player_idx)
+{
+    info->hash ^= zobrist_key(ZOBRIST_SCORE, player_idx, 0, info->players[player_idx].mat.score);
+}
+
+static inline void toggle_player_on_move_key(Game* info)
+{
+    info->hash ^= zobrist_key(ZOBRIST_PLAYER_ON_MOVE, 0, 0, info->flow.player_on_move + 1);
+}
+
+// Helper function to get the tile color at a specific Portuguese wall position
+int get_portugese_wall_color(int row, int col)
+{
+    // The Portuguese wall has a fixed pattern that rotates
+    // Each row shifts the pattern by one position
+    int pattern[5] = {BLUE, YELLOW, RED, BLACK, WHITE};
+    return pattern[(col - row + 5) % 5];
+}
+
+// Column of `color` on wall row `row`
+int get_portugese_wall_col(int row, int color)
+{
+    return wall_col_table[row][color];
+}
+
+// Points of the tile at (row, col) of `wall`, which already holds it: the
+// tiles connected to it in its row plus those in its column, itself once.
+// Two table lookups, no branches.
+int wall_placement_score(unsigned int wall, int row, int col)
+{
+    unsigned int row_bits = (wall >> (row * 5)) & 0x1F;
+    unsigned int col_bits = ((wall >> col) & 0x01) |
+                            ((wall >> (col + 4)) & 0x02) |
+                            ((wall >> (col + 8)) & 0x04) |
+                            ((wall >> (col + 12)) & 0x08) |
+                            ((wall >> (col + 16)) & 0x10);
+    return run_length_table[row_bits][col] + run_length_table[col_bits][row] - 1;
+}
+
+void set_the_no_of_factories(Game* info)
+{
+    if(info->no_of_players == 2)
+    {
+        info->no_of_factory_displays = 5;
+    }
+    else if(info->no_of_players == 3)
+    {
+        info->no_of_factory_displays = 7;
+    }
+    else if(info->no_of_players == 4)
+    {
+        info->no_of_factory_displays = 9;
+    }
+}
+
+void initialise_mat(Game* info)
+{
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        // Initialize pattern lines
+        for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
+        {
+            for(int j = 0; j < HOW_MANY_TILES_TYPES; j++)
+            {
+                if(i + j >= HOW_MANY_TILES_TYPES - 1)
+                {
+                    info->players[p].mat.pattern_lines[i][j] = AVAILABLE;
+                }
+                else
+                {
+                    info->players[p].mat.pattern_lines[i][j] = BLOCKED;
+                }
+            }
+        }
+
+        // Initialize Portuguese wall
+        info->players[p].mat.portugese_wall = 0;
+
+        // Initialize floor line
+        for(int i = 0; i < MAX_PENALTIES; i++)
+        {
+            info->players[p].mat.penalties[i] = AVAILABLE;
+        }
+
+        // Initialize score
+        info->players[p].mat.score = 0;
+        info->players[p].is_token_present = 0;
+    }
+}
+
+void initialise_factory_displays(Game* info)
+{
+    for(int i = 0; i < MAX_NUMBER_OF_FACTORIES; i++)
+    {
+        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+        {
+            info->factory_displays.all_factories[i][j] = BLOCKED;
+        }
+    }
+}
+
+void initialise_middle_pile(Game* info)
+{
+    for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
+    {
+        info->middle_pile.all_tiles[i] = 0;
+    }
+    info->middle_pile.is_token_present = 1;
+}
+
+// Player names are left untouched so the caller can set them before or after.
+// `seed` decides every factory fill of the game.
+void init_game(Game* info, int no_of_players, uint64_t seed)
+{
+    info->no_of_players = no_of_players;
+    rng_seed(&info->rng, seed);
+    fill_the_bag(&info->bag);
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        info->box_lid.all_tiles[color] = 0;
+    }
+    set_the_no_of_factories(info);
+    initialise_mat(info);
+    initialise_factory_displays(info);
+    initialise_middle_pile(info);
+    info->middle_pile.is_token_present = 0;
+
+    info->flow.player_on_move = 0;
+    info->flow.round_number = 0;
+    info->flow.selections_until_round_finish = 0;
+    info->hash = compute_game_hash(info);
+}
+
+static int count_bag_tiles(const Bag* bag)
+{
+    int total = 0;
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        total += bag->all_tiles[color];
+    }
+    return total;
+}
+
+// Pours the box lid back into the bag, returns the new number of bag tiles
+static int refill_bag_from_box_lid(Game* info)
+{
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        toggle_bag_key(info, color);
+        toggle_box_lid_key(info, color);
+        info->bag.all_tiles[color] += info->box_lid.all_tiles[color];
+        info->box_lid.all_tiles[color] = 0;
+        toggle_bag_key(info, color);
+    }
+    return count_bag_tiles(&info->bag);
+}
+
+// Draws each tile with probability proportional to the bag counts, so a
+// draw never fails while there are tiles. When the bag runs out it is
+// refilled from the box lid. Returns 1 if every factory got 4 tiles, 0 if
+// bag and lid both ran out first (the remaining slots are left BLOCKED).
+int amplasete_tiles_on_a_factory(Game* info)
+{
+    int random_tile_idx = 0;
+    int tiles_in_bag = count_bag_tiles(&info->bag);
+    for(int i = 0; i < info->no_of_factory_displays; i++)
+    {
+        int on_factory[HOW_MANY_TILES_TYPES] = {0};
+        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+        {
+            if(tiles_in_bag == 0)
+            {
+                tiles_in_bag = refill_bag_from_box_lid(info);
+                if(tiles_in_bag == 0)
+                {
+                    return 0;
+                }
+            }
+
+            int pick = rng_below(&info->rng, tiles_in_bag);
+            random_tile_idx = 0;
+            while(pick >= (int)info->bag.all_tiles[random_tile_idx])
+            {
+                pick -= info->bag.all_tiles[random_tile_idx];
+                random_tile_idx++;
+            }
+            tiles_in_bag--;
+
+            toggle_bag_key(info, random_tile_idx);
+            info->bag.all_tiles[random_tile_idx]--;
+            toggle_bag_key(info, random_tile_idx);
+
+            toggle_factory_key(info, i, random_tile_idx, on_factory[random_tile_idx]);
+            on_factory[random_tile_idx]++;
+            toggle_factory_key(info, i, random_tile_idx, on_factory[random_tile_idx]);
+            info->factory_displays.all_factories[i][j] = random_tile_idx;
+        }
+    }
+    return 1;
+}
+
+// Replaces the tiles start_round() drew with the given ones (BLOCKED for an
+// empty slot) as if they had come out of the bag, for games whose fills do
+// not come from our generator. Returns 0, changing nothing, if the bag (or
+// the box lid once the bag is empty) cannot supply them.
+int set_factory_tiles(Game* info, const int tiles[MAX_NUMBER_OF_FACTORIES][HOW_MANY_TILES_ON_FACTORY])
+{
+    Bag bag = info->bag;
+    Bag box_lid = info->box_lid;
+
+    for(int i = 0; i < info->no_of_factory_displays; i++)
+    {
+        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+        {
+            int color = info->factory_displays.all_factories[i][j];
+            if(color >= 0 && color < HOW_MANY_TILES_TYPES)
+            {
+                bag.all_tiles[color]++;
+            }
+        }
+    }
+
+    for(int i = 0; i < info->no_of_factory_displays; i++)
+    {
+        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+        {
+            int color = tiles[i][j];
+            if(color == BLOCKED)
+            {
+                continue;
+            }
+            if(color < 0 || color >= HOW_MANY_TILES_TYPES)
+            {
+                return 0;
+            }
+            if(count_bag_tiles(&bag) == 0)
+            {
+                for(int c = 0; c < HOW_MANY_TILES_TYPES; c++)
+                {
+                    bag.all_tiles[c] += box_lid.all_tiles[c];
+                    box_lid.all_tiles[c] = 0;
+                }
+            }
+            if(bag.all_tiles[color] == 0)
+            {
+                return 0;
+            }
+            bag.all_tiles[color]--;
+        }
+    }
+
+    info->bag = bag;
+    info->box_lid = box_lid;
+    for(int i = 0; i < info->no_of_factory_displays; i++)
+    {
+        for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+        {
+            info->factory_displays.all_factories[i][j] = tiles[i][j];
+        }
+    }
+    info->hash = compute_game_hash(info);
+    return 1;
+}
+
+// The player who took the first player token last round starts this one
+void start_round(Game* info)
+{
+    int first_player = 0;
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        if(info->players[p].is_token_present)
+        {
+            first_player = p;
+            info->players[p].is_token_present = 0;
+            info->hash ^= zobrist_key(ZOBRIST_PLAYER_TOKEN, p, 0, 1);
+        }
+    }
+
+    // Factories and middle pile are normally empty here, clear whatever is left
+    for(int f = 0; f < info->no_of_factory_displays; f++)
+    {
+        for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+        {
+            toggle_factory_key(info, f, color, count_tiles_in_source(info, f, color));
+        }
+    }
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        toggle_middle_pile_key(info, color);
+    }
+    info->hash ^= zobrist_key(ZOBRIST_MIDDLE_TOKEN, 0, 0, info->middle_pile.is_token_present);
+
+    initialise_factory_displays(info);
+    amplasete_tiles_on_a_factory(info);
+    initialise_middle_pile(info);
+    info->hash ^= zobrist_key(ZOBRIST_MIDDLE_TOKEN, 0, 0, 1);
+
+    toggle_player_on_move_key(info);
+    info->flow.player_on_move = first_player;
+    toggle_player_on_move_key(info);
+    info->flow.round_number++;
+    info->flow.selections_until_round_finish = 0;
+}
+
+static int is_factory_empty(const Game* info, int factory)
+{
+    for(int j = 0; j < HOW_MANY_TILES_ON_FACTORY; j++)
+    {
+        if(info->factory_displays.all_factories[factory][j] != BLOCKED)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Returns 1 if all factories are empty
+int check_factories(const Game* info)
+{
+    for(int i = 0; i < info->no_of_factory_displays; i++)
+    {
+        if(!is_factory_empty(info, i))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Returns 1 if the middle pile has no tiles left
+int check_MidPile(const Game* info)
+{
+    for(int i = 0; i < HOW_MANY_TILES_TYPES; i++)
+    {
+        if(info->middle_pile.all_tiles[i] != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int is_round_over(const Game* info)
+{
+    return check_factories(info) && check_MidPile(info);
+}
+
+int count_tiles_in_source(const Game* info, int source, int color)
+{
+    if(color < 0 || color >= HOW_MANY_TILES_TYPES)
+    {
+        return 0;
+    }
+    if(source == MIDDLE_PILE)
+    {
+        return info->middle_pile.all_tiles[color];
+    }
+    if(source < 0 || source >= info->no_of_factory_displays)
+    {
+        return 0;
+    }
+
+    int cnt = 0;
+    for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+    {
+        if(info->factory_displays.all_factories[source][i] == color)
+        {
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+// Color already on a pattern line, or -1 if the line is empty
+int pattern_line_color(const Mat* mat, int line)
+{
+    int tile = mat->pattern_lines[line][HOW_MANY_TILES_TYPES - 1];
+    if(tile >= 0 && tile < HOW_MANY_TILES_TYPES)
+    {
+        return tile;
+    }
+    return -1;
+}
+
+// Number of tiles on a pattern line (lines are filled from the right)
+int pattern_line_count(const Mat* mat, int line)
+{
+    int cnt = 0;
+    for(int col = HOW_MANY_TILES_TYPES - 1; col >= HOW_MANY_TILES_TYPES - 1 - line; col--)
+    {
+        if(mat->pattern_lines[line][col] == AVAILABLE)
+        {
+            break;
+        }
+        cnt++;
+    }
+    return cnt;
+}
+
+int is_wall_row_holding_color(const Mat* mat, int row, int color)
+{
+    return (mat->portugese_wall & WALL_ROW_MASK(row) & wall_color_masks[color]) != 0;
+}
+
+int is_move_legal(const Game* info, Move move)
+{
+    if(is_round_over(info))
+    {
+        return 0;
+    }
+    if(count_tiles_in_source(info, move.source, move.color) == 0)
+    {
+        return 0;
+    }
+    if(move.pattern_line == FLOOR_LINE)
+    {
+        return 1;
+    }
+    if(move.pattern_line < 0 || move.pattern_line >= HOW_MANY_TILES_TYPES)
+    {
+        return 0;
+    }
+
+    const Mat* mat = &info->players[info->flow.player_on_move].mat;
+    int line_color = pattern_line_color(mat, move.pattern_line);
+    if(line_color != -1 && line_color != move.color)
+    {
+        return 0;
+    }
+    if(pattern_line_count(mat, move.pattern_line) == move.pattern_line + 1)
+    {
+        return 0;
+    }
+    if(is_wall_row_holding_color(mat, move.pattern_line, move.color))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+// Fills `moves` with every legal move of the player on move and returns how
+// many there are. Moves are ordered by source (factories, then the middle
+// pile), color and pattern line, with the floor line last for each color.
+int generate_legal_moves(const Game* info, Move moves[MAX_LEGAL_MOVES])
+{
+    const Mat* mat = &info->players[info->flow.player_on_move].mat;
+    int no_of_moves = 0;
+
+    // Which pattern lines accept each color, as a bit per line
+    int lines_for_color[HOW_MANY_TILES_TYPES] = {0};
+    for(int line = 0; line < HOW_MANY_TILES_TYPES; line++)
+    {
+        if(pattern_line_count(mat, line) == line + 1)
+        {
+            continue;
+        }
+        int line_color = pattern_line_color(mat, line);
+        for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+        {
+            if((line_color == -1 || line_color == color) &&
+               !is_wall_row_holding_color(mat, line, color))
+            {
+                lines_for_color[color] |= 1 << line;
+            }
+        }
+    }
+
+    for(int source = 0; source <= info->no_of_factory_displays; source++)
+    {
+        int tiles[HOW_MANY_TILES_TYPES] = {0};
+        int source_idx = source;
+        if(source == info->no_of_factory_displays)
+        {
+            source_idx = MIDDLE_PILE;
+            for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+            {
+                tiles[color] = info->middle_pile.all_tiles[color];
+            }
+        }
+        else
+        {
+            for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+            {
+                int tile = info->factory_displays.all_factories[source][i];
+                if(tile >= 0 && tile < HOW_MANY_TILES_TYPES)
+                {
+                    tiles[tile]++;
+                }
+            }
+        }
+
+        for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+        {
+            if(tiles[color] == 0)
+            {
+                continue;
+            }
+            for(int line = 0; line < HOW_MANY_TILES_TYPES; line++)
+            {
+                if(lines_for_color[color] & (1 << line))
+                {
+                    moves[no_of_moves].source = source_idx;
+                    moves[no_of_moves].color = color;
+                    moves[no_of_moves].pattern_line = line;
+                    no_of_moves++;
+                }
+            }
+            moves[no_of_moves].source = source_idx;
+            moves[no_of_moves].color = color;
+            moves[no_of_moves].pattern_line = FLOOR_LINE;
+            no_of_moves++;
+        }
+    }
+    return no_of_moves;
+}
+
+// Dense numbering of all moves, 0 to MAX_LEGAL_MOVES - 1
+int move_to_index(Move move)
+{
+    return ((move.source + 1) * HOW_MANY_TILES_TYPES + move.color) * (HOW_MANY_TILES_TYPES + 1) +
+           move.pattern_line + 1;
+}
+
+Move move_from_index(int index)
+{
+    Move move;
+    move.pattern_line = index % (HOW_MANY_TILES_TYPES + 1) - 1;
+    index /= HOW_MANY_TILES_TYPES + 1;
+    move.color = index % HOW_MANY_TILES_TYPES;
+    move.source = index / HOW_MANY_TILES_TYPES - 1;
+    return move;
+}
+
+void put_on_available_floorline_slot(Game* info, int player_idx, int color, int count)
+{
+    for(int i = 0; i < MAX_PENALTIES && count > 0; i++)
+    {
+        if(info->players[player_idx].mat.penalties[i] == AVAILABLE)
+        {
+            info->players[player_idx].mat.penalties[i] = color;
+            toggle_floor_slot_key(info, player_idx, i);
+            count--;
+        }
+    }
+
+    // Excess tiles go to the box lid
+    toggle_box_lid_key(info, color);
+    info->box_lid.all_tiles[color] += count;
+    toggle_box_lid_key(info, color);
+}
+
+// Takes the tiles from the chosen source, places them and passes the turn.
+// Returns 1 on success, 0 (state untouched) if the move is not legal.
+int apply_move(Game* info, Move move)
+{
+    if(!is_move_legal(info, move))
+    {
+        return 0;
+    }
+
+    int player_idx = info->flow.player_on_move;
+    Mat* mat = &info->players[player_idx].mat;
+    int taken = 0;
+
+    if(move.source == MIDDLE_PILE)
+    {
+        taken = info->middle_pile.all_tiles[move.color];
+        toggle_middle_pile_key(info, move.color);
+        info->middle_pile.all_tiles[move.color] = 0;
+
+        // Take the token if present and put it on the first free floor slot
+        if(info->middle_pile.is_token_present)
+        {
+            info->players[player_idx].is_token_present = 1;
+            info->middle_pile.is_token_present = 0;
+            info->hash ^= zobrist_key(ZOBRIST_PLAYER_TOKEN, player_idx, 0, 1);
+            info->hash ^= zobrist_key(ZOBRIST_MIDDLE_TOKEN, 0, 0, 1);
+
+            for(int i = 0; i < MAX_PENALTIES; i++)
+            {
+                if(mat->penalties[i] == AVAILABLE)
+                {
+                    mat->penalties[i] = TOKEN_MARKER;
+                    toggle_floor_slot_key(info, player_idx, i);
+                    break;
+                }
+            }
+        }
+    }
+    else
+    {
+        // Selected color is taken, the other tiles go to the middle
+        int on_factory[HOW_MANY_TILES_TYPES] = {0};
+        for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+        {
+            int tile = info->factory_displays.all_factories[move.source][i];
+            if(tile == move.color)
+            {
+                taken++;
+            }
+            else if(tile != BLOCKED)
+            {
+                toggle_middle_pile_key(info, tile);
+                info->middle_pile.all_tiles[tile]++;
+                toggle_middle_pile_key(info, tile);
+            }
+            if(tile != BLOCKED)
+            {
+                on_factory[tile]++;
+            }
+            info->factory_displays.all_factories[move.source][i] = BLOCKED;
+        }
+        for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+        {
+            toggle_factory_key(info, move.source, color, on_factory[color]);
+        }
+    }
+
+    if(move.pattern_line != FLOOR_LINE)
+    {
+        int line = move.pattern_line;
+        toggle_pattern_line_key(info, player_idx, line);
+        for(int col = HOW_MANY_TILES_TYPES - 1; col >= HOW_MANY_TILES_TYPES - 1 - line && taken > 0; col--)
+        {
+            if(mat->pattern_lines[line][col] == AVAILABLE)
+            {
+                mat->pattern_lines[line][col] = move.color;
+                taken--;
+            }
+        }
+        toggle_pattern_line_key(info, player_idx, line);
+    }
+
+    // Remaining tiles to floor
+    if(taken > 0)
+    {
+        put_on_available_floorline_slot(info, player_idx, move.color, taken);
+    }
+
+    toggle_player_on_move_key(info);
+    info->flow.player_on_move = (player_idx + 1) % info->no_of_players;
+    toggle_player_on_move_key(info);
+    info->flow.selections_until_round_finish++;
+    return 1;
+}
+
+static int floor_line_count(const Mat* mat)
+{
+    // Floor slots are always taken from the left, the occupied ones are a prefix
+    int cnt = 0;
+    while(cnt < MAX_PENALTIES && mat->penalties[cnt] != AVAILABLE)
+    {
+        cnt++;
+    }
+    return cnt;
+}
+
+// apply_move() that also fills `undo` so the move can be taken back with
+// undo_move(). Returns 1 on success, 0 (state untouched) if illegal.
+int apply_move_with_undo(Game* info, Move move, Undo_record* undo)
+{
+    if(!is_move_legal(info, move))
+    {
+        return 0;
+    }
+
+    int player_idx = info->flow.player_on_move;
+    const Mat* mat = &info->players[player_idx].mat;
+
+    undo->move = move;
+    undo->taken = count_tiles_in_source(info, move.source, move.color);
+    undo->line_count_before = move.pattern_line == FLOOR_LINE ? 0 : pattern_line_count(mat, move.pattern_line);
+    undo->floor_count_before = floor_line_count(mat);
+    undo->took_token = move.source == MIDDLE_PILE && info->middle_pile.is_token_present;
+    undo->player_idx = player_idx;
+    undo->hash_before = info->hash;
+    if(move.source != MIDDLE_PILE)
+    {
+        for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+        {
+            undo->factory_tiles[i] = info->factory_displays.all_factories[move.source][i];
+        }
+    }
+
+    int lid_before = info->box_lid.all_tiles[move.color];
+    apply_move(info, move);
+    undo->to_lid = info->box_lid.all_tiles[move.color] - lid_before;
+    return 1;
+}
+
+// Takes back the last move made with apply_move_with_undo(). Moves must be
+// undone in the reverse order they were made.
+void undo_move(Game* info, const Undo_record* undo)
+{
+    Move move = undo->move;
+    int player_idx = undo->player_idx;
+    Mat* mat = &info->players[player_idx].mat;
+
+    info->flow.player_on_move = player_idx;
+    info->flow.selections_until_round_finish--;
+    info->box_lid.all_tiles[move.color] -= undo->to_lid;
+
+    for(int i = undo->floor_count_before; i < MAX_PENALTIES; i++)
+    {
+        mat->penalties[i] = AVAILABLE;
+    }
+    if(move.pattern_line != FLOOR_LINE)
+    {
+        for(int col = HOW_MANY_TILES_TYPES - 1 - undo->line_count_before; col >= HOW_MANY_TILES_TYPES - 1 - move.pattern_line; col--)
+        {
+            mat->pattern_lines[move.pattern_line][col] = AVAILABLE;
+        }
+    }
+
+    if(undo->took_token)
+    {
+        info->players[player_idx].is_token_present = 0;
+        info->middle_pile.is_token_present = 1;
+    }
+
+    if(move.source == MIDDLE_PILE)
+    {
+        info->middle_pile.all_tiles[move.color] = undo->taken;
+    }
+    else
+    {
+        // The other colors went to the middle, take them back
+        for(int i = 0; i < HOW_MANY_TILES_ON_FACTORY; i++)
+        {
+            int tile = undo->factory_tiles[i];
+            if(tile != move.color && tile != BLOCKED)
+            {
+                info->middle_pile.all_tiles[tile]--;
+            }
+            info->factory_displays.all_factories[move.source][i] = tile;
+        }
+    }
+
+    info->hash = undo->hash_before;
+}
+
+// Moves complete pattern lines to the wall, scores them and the floor line.
+// `report` may be NULL when the caller does not need the details.
+void process_end_of_round(Game* info, Round_report* report)
+{
+    if(report)
+    {
+        memset(report, 0, sizeof(*report));
+    }
+
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        Mat* mat = &info->players[p].mat;
+        int round_score = 0;
+
+        // Check each pattern line
+        for(int row = 0; row < 5; row++)
+        {
+            if(pattern_line_count(mat, row) != row + 1)
+            {
+                continue;
+            }
+            int tile_color = pattern_line_color(mat, row);
+            int wall_col = wall_col_table[row][tile_color];
+
+            // Place tile on wall
+            unsigned int wall = mat->portugese_wall | WALL_BIT(row, wall_col);
+            info->hash ^= zobrist_key(ZOBRIST_WALL, p, row * 5 + wall_col, (wall ^ mat->portugese_wall) != 0);
+            mat->portugese_wall = wall;
+
+            int tile_score = wall_placement_score(wall, row, wall_col);
+            round_score += tile_score;
+
+            if(report)
+            {
+                Wall_placement* placed = &report->placements[p][report->no_of_placements[p]++];
+                placed->row = row;
+                placed->color = tile_color;
+                placed->wall_col = wall_col;
+                placed->score = tile_score;
+            }
+
+            // Clear the pattern line, one tile went to the wall, the rest go to the box lid
+            toggle_box_lid_key(info, tile_color);
+            info->box_lid.all_tiles[tile_color] += row;
+            toggle_box_lid_key(info, tile_color);
+            toggle_pattern_line_key(info, p, row);
+            for(int col = HOW_MANY_TILES_TYPES - 1 - row; col < 5; col++)
+            {
+                mat->pattern_lines[row][col] = AVAILABLE;
+            }
+        }
+
+        // Process floor line penalties
+        int penalty_score = 0;
+        for(int i = 0; i < MAX_PENALTIES; i++)
+        {
+            if(mat->penalties[i] != AVAILABLE)
+            {
+                penalty_score += floor_penalties[i];
+                // Tiles go to the box lid (the token marker goes back to the middle)
+                if(mat->penalties[i] >= 0 && mat->penalties[i] < 5)
+                {
+                    toggle_box_lid_key(info, mat->penalties[i]);
+                    info->box_lid.all_tiles[mat->penalties[i]]++;
+                    toggle_box_lid_key(info, mat->penalties[i]);
+                }
+                toggle_floor_slot_key(info, p, i);
+                mat->penalties[i] = AVAILABLE;
+            }
+        }
+        round_score += penalty_score;
+
+        // Update score (can't go below 0)
+        int new_score = mat->score + round_score;
+        if(new_score < 0) new_score = 0;
+        toggle_score_key(info, p);
+        mat->score = new_score;
+        toggle_score_key(info, p);
+
+        if(report)
+        {
+            report->penalty_points[p] = penalty_score;
+            report->round_score[p] = round_score;
+        }
+    }
+}
+
+static int count_complete_rows(const Mat* mat)
+{
+    int complete_rows = 0;
+    for(int row = 0; row < 5; row++)
+    {
+        complete_rows += (mat->portugese_wall & WALL_ROW_MASK(row)) == WALL_ROW_MASK(row);
+    }
+    return complete_rows;
+}
+
+// Index of the first player with a complete horizontal row, or -1
+int find_player_with_complete_row(const Game* info)
+{
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        unsigned int wall = info->players[p].mat.portugese_wall;
+        for(int row = 0; row < 5; row++)
+        {
+            if((wall & WALL_ROW_MASK(row)) == WALL_ROW_MASK(row))
+            {
+                return p;
+            }
+        }
+    }
+    return -1;
+}
+
+// Game ends when any player completes a horizontal row
+int check_game_end(const Game* info)
+{
+    return find_player_with_complete_row(info) != -1;
+}
+
+// `report` may be NULL when the caller does not need the details
+void calculate_final_bonuses(Game* info, Bonus_report* report)
+{
+    if(report)
+    {
+        memset(report, 0, sizeof(*report));
+    }
+
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        Mat* mat = &info->players[p].mat;
+        int bonus_points = 0;
+
+        // Bonus for complete horizontal rows (2 points each)
+        int complete_rows = count_complete_rows(mat);
+        bonus_points += complete_rows * 2;
+
+        // Bonus for complete vertical columns (7 points each)
+        int complete_cols = 0;
+        for(int col = 0; col < 5; col++)
+        {
+            if((mat->portugese_wall & wall_col_masks[col]) == wall_col_masks[col])
+            {
+                complete_cols++;
+                bonus_points += 7;
+            }
+        }
+
+        // Bonus for complete colors (10 points each)
+        for(int color = 0; color < 5; color++)
+        {
+            int color_complete = (mat->portugese_wall & wall_color_masks[color]) == wall_color_masks[color];
+            if(color_complete)
+            {
+                bonus_points += 10;
+            }
+            if(report)
+            {
+                report->complete_colors[p][color] = color_complete;
+            }
+        }
+
+        toggle_score_key(info, p);
+        mat->score += bonus_points;
+        toggle_score_key(info, p);
+
+        if(report)
+        {
+            report->complete_rows[p] = complete_rows;
+            report->complete_cols[p] = complete_cols;
+            report->bonus_points[p] = bonus_points;
+        }
+    }
+}
+
+// Highest score wins, ties are broken by the number of complete rows.
+// Returns the winner's index, or -1 if the tie cannot be broken.
+int find_winner(const Game* info)
+{
+    int winner_idx = -1;
+    int tie = 0;
+
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        if(winner_idx == -1 ||
+           info->players[p].mat.score > info->players[winner_idx].mat.score)
+        {
+            winner_idx = p;
+            tie = 0;
+        }
+        else if(info->players[p].mat.score == info->players[winner_idx].mat.score)
+        {
+            int rows_p = count_complete_rows(&info->players[p].mat);
+            int rows_winner = count_complete_rows(&info->players[winner_idx].mat);
+            if(rows_p > rows_winner)
+            {
+                winner_idx = p;
+                tie = 0;
+            }
+            else if(rows_p == rows_winner)
+            {
+                tie = 1;
+            }
+        }
+    }
+
+    return tie ? -1 : winner_idx;
+}
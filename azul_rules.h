@@ -0,0 +1,210 @@
+/*AZUL BOARD GAME - Headless rules core
+
+Everything needed to play a game without a terminal: the game state,
+setting up a round, applying a move and scoring the end of a round/game.
+None of these functions print or read input, the interactive game in
+Azul.c (and any bot or simulator) is built on top of them.
+*/
+
+#ifndef AZUL_RULES_H
+#define AZUL_RULES_H
+
+#include <stdint.h>
+
+#include "azul_rng.h"
+
+#define ALL_TILES 100
+#define SAME_COLOR_TILES 20
+#define HOW_MANY_TILES_TYPES 5
+#define HOW_MANY_TILES_ON_FACTORY 4
+#define MAX_NUMBER_OF_FACTORIES 9
+#define MAX_PLAYERS 4
+#define MAX_PLAYER_NAME 10
+#define MAX_PENALTIES 7
+#define BLUE 0
+#define RED 1
+#define BLACK 2
+#define YELLOW 3
+#define WHITE 4
+#define AVAILABLE -1
+#define BLOCKED -2
+#define TOKEN_MARKER -3
+
+// Special values of Move.source and Move.pattern_line
+#define MIDDLE_PILE -1
+#define FLOOR_LINE -1
+
+// Upper bound of legal moves in one position: 9 factories + middle pile,
+// 5 colors, 5 pattern lines + floor
+#define MAX_LEGAL_MOVES ((MAX_NUMBER_OF_FACTORIES + 1) * HOW_MANY_TILES_TYPES * (HOW_MANY_TILES_TYPES + 1))
+
+/*
+    Color indices:
+    - 0 = BLUE
+    - 1 = RED
+    - 2 = BLACK
+    - 3 = YELLOW
+    - 4 = WHITE
+*/
+
+typedef struct
+{
+    unsigned int all_tiles[5];
+}Bag;
+
+/*
+    The Portuguese wall is a 25-bit mask, bit (row * 5 + col) is set once
+    a tile is placed there. Full rows, columns and colors are then single
+    mask tests against the tables below.
+*/
+#define WALL_BIT(row, col) (1u << ((row) * 5 + (col)))
+#define WALL_ROW_MASK(row) (0x1Fu << ((row) * 5))
+#define FULL_WALL 0x1FFFFFFu
+
+extern const unsigned int wall_col_masks[5];
+extern const unsigned int wall_color_masks[HOW_MANY_TILES_TYPES];
+extern const unsigned char wall_col_table[5][HOW_MANY_TILES_TYPES];
+extern const unsigned char run_length_table[32][5];
+
+typedef struct
+{
+    unsigned int portugese_wall;
+    int pattern_lines[5][5];
+    unsigned int score;
+    int penalties[7];
+}Mat;
+
+typedef struct
+{
+    int all_factories[MAX_NUMBER_OF_FACTORIES][HOW_MANY_TILES_ON_FACTORY];
+}Factory_display;
+
+typedef struct
+{
+    int all_tiles[HOW_MANY_TILES_TYPES];
+    unsigned int is_token_present;
+}Middle_pile;
+
+typedef struct
+{
+    Mat mat;
+    unsigned int is_token_present;
+    char player_name[MAX_PLAYER_NAME];
+}Player;
+
+typedef struct
+{
+    int player_on_move;
+    int round_number;
+    int selections_until_round_finish;
+}Gameflow;
+
+typedef struct
+{
+    Bag bag;
+    Bag box_lid;    // used tiles, poured back into the bag when it runs out
+    Middle_pile middle_pile;
+    Player players[MAX_PLAYERS];
+    int no_of_players;
+    Factory_display factory_displays;
+    int no_of_factory_displays;
+    Gameflow flow;
+    uint64_t hash;  // Zobrist key of the position, see azul_zobrist.h
+    Rng rng;        // draws the factory tiles
+}Game;
+
+// Most moves a round can take: every move removes at least one tile
+#define MAX_MOVES_PER_ROUND (MAX_NUMBER_OF_FACTORIES * HOW_MANY_TILES_ON_FACTORY)
+
+// One turn: take every tile of `color` from a factory (0-based index) or
+// from the MIDDLE_PILE and put them on pattern line 0-4 or the FLOOR_LINE
+typedef struct
+{
+    signed char source;
+    signed char color;
+    signed char pattern_line;
+}Move;
+
+// Everything apply_move_with_undo() changed that the state alone cannot
+// tell, enough for undo_move() to restore the position exactly
+typedef struct
+{
+    Move move;
+    signed char factory_tiles[HOW_MANY_TILES_ON_FACTORY];
+    unsigned char taken;
+    unsigned char line_count_before;
+    unsigned char floor_count_before;
+    unsigned char to_lid;
+    unsigned char took_token;
+    unsigned char player_idx;
+    uint64_t hash_before;
+}Undo_record;
+
+// What happened to one pattern line that was moved to the wall
+typedef struct
+{
+    int row;
+    int color;
+    int wall_col;
+    int score;
+}Wall_placement;
+
+typedef struct
+{
+    Wall_placement placements[MAX_PLAYERS][5];
+    int no_of_placements[MAX_PLAYERS];
+    int penalty_points[MAX_PLAYERS];
+    int round_score[MAX_PLAYERS];
+}Round_report;
+
+typedef struct
+{
+    int complete_rows[MAX_PLAYERS];
+    int complete_cols[MAX_PLAYERS];
+    int complete_colors[MAX_PLAYERS][HOW_MANY_TILES_TYPES];
+    int bonus_points[MAX_PLAYERS];
+}Bonus_report;
+
+extern const int floor_penalties[MAX_PENALTIES];
+
+// Setup
+void fill_the_bag(Bag* bag);
+int get_portugese_wall_color(int row, int col);
+int get_portugese_wall_col(int row, int color);
+int wall_placement_score(unsigned int wall, int row, int col);
+void set_the_no_of_factories(Game* info);
+void initialise_mat(Game* info);
+void initialise_factory_displays(Game* info);
+void initialise_middle_pile(Game* info);
+void init_game(Game* info, int no_of_players, uint64_t seed);
+
+// Rounds
+int amplasete_tiles_on_a_factory(Game* info);
+int set_factory_tiles(Game* info, const int tiles[MAX_NUMBER_OF_FACTORIES][HOW_MANY_TILES_ON_FACTORY]);
+void start_round(Game* info);
+int check_factories(const Game* info);
+int check_MidPile(const Game* info);
+int is_round_over(const Game* info);
+
+// Moves
+int count_tiles_in_source(const Game* info, int source, int color);
+int pattern_line_color(const Mat* mat, int line);
+int pattern_line_count(const Mat* mat, int line);
+int is_wall_row_holding_color(const Mat* mat, int row, int color);
+int is_move_legal(const Game* info, Move move);
+int generate_legal_moves(const Game* info, Move moves[MAX_LEGAL_MOVES]);
+int move_to_index(Move move);
+Move move_from_index(int index);
+void put_on_available_floorline_slot(Game* info, int player_idx, int color, int count);
+int apply_move(Game* info, Move move);
+int apply_move_with_undo(Game* info, Move move, Undo_record* undo);
+void undo_move(Game* info, const Undo_record* undo);
+
+// Scoring and game end
+void process_end_of_round(Game* info, Round_report* report);
+int find_player_with_complete_row(const Game* info);
+int check_game_end(const Game* info);
+void calculate_final_bonuses(Game* info, Bonus_report* report);
+int find_winner(const Game* info);
+
+#endif
@@ -0,0 +1,246 @@
+/*AZUL BOARD GAME - Batch self-play
+See azul_selfplay.h.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "azul_selfplay.h"
+#include "azul_pool.h"
+
+typedef struct
+{
+    const Selfplay_config* config;
+    Selfplay_stats* worker_stats;   // one per worker, merged at the end
+}Batch;
+
+void reset_selfplay_stats(Selfplay_stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for(int p = 0; p < MAX_PLAYERS; p++)
+    {
+        stats->min_score[p] = ~0u;
+    }
+}
+
+void add_selfplay_result(Selfplay_stats* stats, const Game_result* result, int no_of_players, long moves)
+{
+    stats->games++;
+    stats->total_moves += moves;
+    stats->round_histogram[result->rounds]++;
+    if(!result->finished)
+    {
+        stats->unfinished_games++;
+    }
+    if(result->winner == -1)
+    {
+        stats->ties++;
+    }
+    else
+    {
+        stats->wins[result->winner]++;
+    }
+
+    for(int p = 0; p < no_of_players; p++)
+    {
+        unsigned int score = result->scores[p];
+        int bucket = score / SCORE_BUCKET_SIZE;
+        stats->score_sum[p] += score;
+        stats->score_square_sum[p] += (long long)score * score;
+        stats->score_histogram[p][bucket < NO_OF_SCORE_BUCKETS ? bucket : NO_OF_SCORE_BUCKETS - 1]++;
+        if(score < stats->min_score[p]) stats->min_score[p] = score;
+        if(score > stats->max_score[p]) stats->max_score[p] = score;
+    }
+}
+
+void merge_selfplay_stats(Selfplay_stats* into, const Selfplay_stats* from)
+{
+    into->games += from->games;
+    into->unfinished_games += from->unfinished_games;
+    into->ties += from->ties;
+    into->total_moves += from->total_moves;
+    into->unarchived_games += from->unarchived_games;
+    for(int p = 0; p < MAX_PLAYERS; p++)
+    {
+        into->wins[p] += from->wins[p];
+        into->score_sum[p] += from->score_sum[p];
+        into->score_square_sum[p] += from->score_square_sum[p];
+        if(from->min_score[p] < into->min_score[p]) into->min_score[p] = from->min_score[p];
+        if(from->max_score[p] > into->max_score[p]) into->max_score[p] = from->max_score[p];
+        for(int b = 0; b < NO_OF_SCORE_BUCKETS; b++)
+        {
+            into->score_histogram[p][b] += from->score_histogram[p][b];
+        }
+    }
+    for(int r = 0; r <= MAX_ROUNDS; r++)
+    {
+        into->round_histogram[r] += from->round_histogram[r];
+    }
+}
+
+// One complete game, it only depends on the batch seed and the game index
+// so a batch gives the same results whatever the number of threads.
+// The moves are stored in `history` unless it is NULL.
+void play_selfplay_game(const Selfplay_config* config, long game_idx, Game_result* result,
+                        Move history[MAX_GAME_MOVES], long* moves)
+{
+    Game info;
+    Rng bot_rng;
+    uint64_t game_seed = derive_seed(config->seed, game_idx);
+    long no_of_moves = 0;
+
+    memset(&info, 0, sizeof(info));
+    init_game(&info, config->no_of_players, game_seed);
+    rng_seed(&bot_rng, derive_seed(game_seed, 1));
+
+    int game_ended = 0;
+    while(!game_ended && info.flow.round_number < MAX_ROUNDS)
+    {
+        start_round(&info);
+        while(!is_round_over(&info))
+        {
+            const Bot* bot = &config->seats[info.flow.player_on_move];
+            Move move = choose_bot_move(&info, bot, &bot_rng);
+            apply_move(&info, move);
+            if(history != NULL)
+            {
+                history[no_of_moves] = move;
+            }
+            no_of_moves++;
+        }
+        process_end_of_round(&info, NULL);
+        game_ended = check_game_end(&info);
+    }
+    calculate_final_bonuses(&info, NULL);
+
+    for(int p = 0; p < info.no_of_players; p++)
+    {
+        result->scores[p] = info.players[p].mat.score;
+    }
+    result->winner = find_winner(&info);
+    result->rounds = info.flow.round_number;
+    result->finished = game_ended;
+    result->seed = game_seed;
+    *moves = no_of_moves;
+}
+
+// Returns 0 if the game could not be written
+static int archive_game(const Selfplay_config* config, const Game_result* result,
+                        const Move* history, long moves)
+{
+    Archive_game game;
+    game.seed = result->seed;
+    game.no_of_players = config->no_of_players;
+    game.rounds = result->rounds;
+    game.finished = result->finished;
+    game.moves = history;
+    game.no_of_moves = moves;
+    for(int p = 0; p < config->no_of_players; p++)
+    {
+        game.seats[p] = config->seats[p].type;
+        game.scores[p] = result->scores[p];
+    }
+    return archive_write_game(config->archive, &game);
+}
+
+static void selfplay_task(long task_idx, int worker_idx, void* arg)
+{
+    Batch* batch = arg;
+    Game_result result;
+    long moves = 0;
+    Move history[MAX_GAME_MOVES];
+    int keep_history = batch->config->archive != NULL;
+
+    play_selfplay_game(batch->config, task_idx, &result, keep_history ? history : NULL, &moves);
+    if(keep_history && !archive_game(batch->config, &result, history, moves))
+    {
+        batch->worker_stats[worker_idx].unarchived_games++;
+    }
+    add_selfplay_result(&batch->worker_stats[worker_idx], &result, batch->config->no_of_players, moves);
+    if(batch->config->results != NULL)
+    {
+        batch->config->results[task_idx] = result;
+    }
+}
+
+void run_selfplay_batch(const Selfplay_config* config, Selfplay_stats* stats)
+{
+    int no_of_threads = config->no_of_threads > 0 ? config->no_of_threads : online_core_count();
+    Batch batch;
+    batch.config = config;
+    batch.worker_stats = malloc(sizeof(Selfplay_stats) * no_of_threads);
+    reset_selfplay_stats(stats);
+    if(batch.worker_stats == NULL)
+    {
+        return;
+    }
+    for(int i = 0; i < no_of_threads; i++)
+    {
+        reset_selfplay_stats(&batch.worker_stats[i]);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_parallel_tasks(config->no_of_games, no_of_threads, selfplay_task, &batch);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for(int i = 0; i < no_of_threads; i++)
+    {
+        merge_selfplay_stats(stats, &batch.worker_stats[i]);
+    }
+    stats->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    free(batch.worker_stats);
+}
+
+void print_selfplay_stats(FILE* out, const Selfplay_config* config, const Selfplay_stats* stats)
+{
+    long games = stats->games > 0 ? stats->games : 1;
+
+    fprintf(out, "Games: %ld (%ld stopped after %d rounds), %.2fs, %.1f games/sec, %.0f moves/sec\n",
+            stats->games, stats->unfinished_games, MAX_ROUNDS, stats->seconds,
+            stats->seconds > 0 ? stats->games / stats->seconds : 0.0,
+            stats->seconds > 0 ? stats->total_moves / stats->seconds : 0.0);
+
+    fprintf(out, "\nSeat  Bot        Wins    Win%%   Mean score  Std dev  Min  Max\n");
+    for(int p = 0; p < config->no_of_players; p++)
+    {
+        double mean = (double)stats->score_sum[p] / games;
+        double variance = (double)stats->score_square_sum[p] / games - mean * mean;
+        fprintf(out, "%-5d %-10s %-7ld %5.1f%%  %10.1f  %7.1f  %3u  %3u\n",
+                p + 1, bot_name(config->seats[p].type), stats->wins[p],
+                100.0 * stats->wins[p] / games, mean, variance > 0 ? sqrt(variance) : 0.0,
+                stats->games > 0 ? stats->min_score[p] : 0, stats->max_score[p]);
+    }
+    fprintf(out, "Ties: %ld (%.1f%%)\n", stats->ties, 100.0 * stats->ties / games);
+
+    fprintf(out, "\nScore distribution (games per %d points):\n", SCORE_BUCKET_SIZE);
+    for(int b = 0; b < NO_OF_SCORE_BUCKETS; b++)
+    {
+        long in_bucket = 0;
+        for(int p = 0; p < config->no_of_players; p++)
+        {
+            in_bucket += stats->score_histogram[p][b];
+        }
+        if(in_bucket == 0)
+        {
+            continue;
+        }
+        fprintf(out, "  %3d-%-3d", b * SCORE_BUCKET_SIZE, b * SCORE_BUCKET_SIZE + SCORE_BUCKET_SIZE - 1);
+        for(int p = 0; p < config->no_of_players; p++)
+        {
+            fprintf(out, " %8ld", stats->score_histogram[p][b]);
+        }
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "\nRounds per game:\n");
+    for(int r = 0; r <= MAX_ROUNDS; r++)
+    {
+        if(stats->round_histogram[r] > 0)
+        {
+            fprintf(out, "  %2d: %ld\n", r, stats->round_histogram[r]);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/*AZUL BOARD GAME - Batch self-play
+
+Plays complete games between bots with the same round flow as the
+terminal game (start_round, moves until is_round_over,
+process_end_of_round, check_game_end, calculate_final_bonuses) but
+without printing anything, spread over a work-stealing thread pool.
+*/
+
+#ifndef AZUL_SELFPLAY_H
+#define AZUL_SELFPLAY_H
+
+#include <stdio.h>
+
+#include "azul_archive.h"
+#include "azul_bots.h"
+
+// Games still running after this many rounds are stopped and counted apart
+#define MAX_ROUNDS 50
+#define SCORE_BUCKET_SIZE 10
+#define NO_OF_SCORE_BUCKETS 20
+#define MAX_GAME_MOVES (MAX_ROUNDS * MAX_MOVES_PER_ROUND)
+
+typedef struct
+{
+    uint64_t seed;            // seed of this game
+    unsigned int scores[MAX_PLAYERS];
+    int winner;               // -1 on a tie
+    int rounds;
+    int finished;             // 0 if stopped at MAX_ROUNDS
+}Game_result;
+
+typedef struct
+{
+    int no_of_players;
+    Bot seats[MAX_PLAYERS];
+    long no_of_games;
+    int no_of_threads;        // 0 = all cores
+    uint64_t seed;            // game i is played from derive_seed(seed, i)
+    Game_result* results;     // optional, game i is stored at results[i]
+    Archive_writer* archive;  // optional, every game is appended to it
+}Selfplay_config;
+
+typedef struct
+{
+    long games;
+    long unfinished_games;
+    long ties;
+    long wins[MAX_PLAYERS];
+    long score_sum[MAX_PLAYERS];
+    long long score_square_sum[MAX_PLAYERS];
+    unsigned int min_score[MAX_PLAYERS];
+    unsigned int max_score[MAX_PLAYERS];
+    long score_histogram[MAX_PLAYERS][NO_OF_SCORE_BUCKETS];
+    long round_histogram[MAX_ROUNDS + 1];
+    long total_moves;
+    long unarchived_games;    // games the archive could not take
+    double seconds;
+}Selfplay_stats;
+
+// Building blocks of the statistics, for other batch runners
+void reset_selfplay_stats(Selfplay_stats* stats);
+void add_selfplay_result(Selfplay_stats* stats, const Game_result* result, int no_of_players, long moves);
+void merge_selfplay_stats(Selfplay_stats* into, const Selfplay_stats* from);
+
+void play_selfplay_game(const Selfplay_config* config, long game_idx, Game_result* result,
+                        Move history[MAX_GAME_MOVES], long* moves);
+void run_selfplay_batch(const Selfplay_config* config, Selfplay_stats* stats);
+void print_selfplay_stats(FILE* out, const Selfplay_config* config, const Selfplay_stats* stats);
+
+#endif
@@ -0,0 +1,859 @@
+/*AZUL BOARD GAME - Game server
+See azul_server.h.
+*/
+
+#define _GNU_SOURCE    // accept4()
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "azul_bots.h"
+#include "azul_log.h"
+#include "azul_notation.h"
+#include "azul_selfplay.h"
+#include "azul_server.h"
+
+#define SEAT_HUMAN -1
+#define NO_CONNECTION -1
+#define MAX_EVENTS 256
+#define LISTEN_BACKLOG 1024
+
+typedef struct
+{
+    int fd;
+    char input[SERVER_LINE_SIZE];
+    int input_length;
+    char* output;
+    size_t output_length;
+    size_t output_sent;
+    size_t output_capacity;
+    int is_dirty;           // output queued since the last flush
+    unsigned int events;    // registered with epoll
+    int is_closing;         // closed once the output is sent
+    long game_idx;          // -1 when not in a game
+    int seat;
+}Connection;
+
+typedef struct
+{
+    Game info;
+    Rng bot_rng;
+    uint64_t seed;
+    int seats[MAX_PLAYERS];          // SEAT_HUMAN or a bot type
+    int connections[MAX_PLAYERS];    // fd of each human seat, NO_CONNECTION while free
+    int free_seats;
+    int is_used;
+}Server_game;
+
+typedef struct
+{
+    int epoll_fd;
+    int listen_fd;
+    int spare_fd;                    // given up to refuse a client when out of fds
+    Connection** connections;        // by fd
+    int no_of_connection_slots;
+    int* dirty;                      // fds with output to send, at most once each
+    int no_of_dirty;
+    Server_game* games;
+    long no_of_game_slots;
+    long* free_games;
+    long no_of_free_games;
+    uint64_t seed;
+    long games_created;
+    long games_finished;
+    long moves_played;
+}Server;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int signal_number)
+{
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+// "unix:/path", "host:port" (IPv4 or localhost) or a port alone for 127.0.0.1
+int parse_server_address(const char* text, struct sockaddr_storage* address, socklen_t* length)
+{
+    memset(address, 0, sizeof(*address));
+    if(strncmp(text, "unix:", 5) == 0)
+    {
+        struct sockaddr_un* unix_address = (struct sockaddr_un*)address;
+        const char* path = text + 5;
+        if(*path == '\0' || strlen(path) >= sizeof(unix_address->sun_path))
+        {
+            return 0;
+        }
+        unix_address->sun_family = AF_UNIX;
+        strcpy(unix_address->sun_path, path);
+        *length = sizeof(*unix_address);
+        return 1;
+    }
+
+    struct sockaddr_in* inet_address = (struct sockaddr_in*)address;
+    char host[64] = "127.0.0.1";
+    const char* port_text = text;
+    const char* colon = strrchr(text, ':');
+    if(colon != NULL)
+    {
+        if(colon - text >= (long)sizeof(host))
+        {
+            return 0;
+        }
+        memcpy(host, text, colon - text);
+        host[colon - text] = '\0';
+        port_text = colon + 1;
+    }
+    if(strcmp(host, "localhost") == 0)
+    {
+        strcpy(host, "127.0.0.1");
+    }
+
+    char* rest;
+    long port = strtol(port_text, &rest, 10);
+    if(*port_text == '\0' || *rest != '\0' || port <= 0 || port > 65535 ||
+       inet_pton(AF_INET, host, &inet_address->sin_addr) != 1)
+    {
+        return 0;
+    }
+    inet_address->sin_family = AF_INET;
+    inet_address->sin_port = htons((uint16_t)port);
+    *length = sizeof(*inet_address);
+    return 1;
+}
+
+static int open_listener(const struct sockaddr_storage* address, socklen_t length)
+{
+    int fd = socket(address->ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1)
+    {
+        return -1;
+    }
+    if(address->ss_family == AF_UNIX)
+    {
+        // A socket left by an earlier run would make bind() fail
+        const char* path = ((const struct sockaddr_un*)address)->sun_path;
+        struct stat path_stat;
+        if(stat(path, &path_stat) == 0 && S_ISSOCK(path_stat.st_mode))
+        {
+            unlink(path);
+        }
+    }
+    else
+    {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if(bind(fd, (const struct sockaddr*)address, length) == -1 || listen(fd, LISTEN_BACKLOG) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Connections and their output */
+
+static void mark_dirty(Server* server, Connection* conn)
+{
+    if(!conn->is_dirty)
+    {
+        conn->is_dirty = 1;
+        server->dirty[server->no_of_dirty++] = conn->fd;
+    }
+}
+
+// Queues one line, the newline is added
+static void queue_line(Server* server, Connection* conn, const char* text)
+{
+    size_t length = strlen(text);
+    size_t needed = conn->output_length + length + 1;
+
+    if(conn->is_closing)
+    {
+        return;
+    }
+    if(needed - conn->output_sent > SERVER_MAX_OUTPUT)
+    {
+        // Too far behind, the client is dropped
+        conn->output_length = conn->output_sent = 0;
+        conn->is_closing = 1;
+        mark_dirty(server, conn);
+        return;
+    }
+    if(needed > conn->output_capacity && conn->output_sent > 0)
+    {
+        // Drop what was sent before growing the buffer
+        memmove(conn->output, conn->output + conn->output_sent, conn->output_length - conn->output_sent);
+        conn->output_length -= conn->output_sent;
+        needed -= conn->output_sent;
+        conn->output_sent = 0;
+    }
+    if(needed > conn->output_capacity)
+    {
+        size_t capacity = conn->output_capacity > 0 ? conn->output_capacity : SERVER_LINE_SIZE;
+        while(capacity < needed)
+        {
+            capacity *= 2;
+        }
+        char* output = realloc(conn->output, capacity);
+        if(output == NULL)
+        {
+            conn->output_length = conn->output_sent = 0;
+            conn->is_closing = 1;
+            mark_dirty(server, conn);
+            return;
+        }
+        conn->output = output;
+        conn->output_capacity = capacity;
+    }
+    memcpy(conn->output + conn->output_length, text, length);
+    conn->output[conn->output_length + length] = '\n';
+    conn->output_length = needed;
+    mark_dirty(server, conn);
+}
+
+static Connection* seat_connection(Server* server, const Server_game* game, int seat)
+{
+    return game->connections[seat] == NO_CONNECTION ? NULL : server->connections[game->connections[seat]];
+}
+
+static void broadcast_line(Server* server, const Server_game* game, const char* text)
+{
+    for(int seat = 0; seat < game->info.no_of_players; seat++)
+    {
+        Connection* conn = seat_connection(server, game, seat);
+        if(conn != NULL)
+        {
+            queue_line(server, conn, text);
+        }
+    }
+}
+
+static int add_connection(Server* server, int fd)
+{
+    if(fd >= server->no_of_connection_slots)
+    {
+        int slots = server->no_of_connection_slots * 2;
+        while(slots <= fd)
+        {
+            slots *= 2;
+        }
+        Connection** connections = realloc(server->connections, sizeof(Connection*) * slots);
+        int* dirty = connections != NULL ? realloc(server->dirty, sizeof(int) * slots) : NULL;
+        if(connections != NULL)
+        {
+            server->connections = connections;
+        }
+        if(dirty == NULL)
+        {
+            return 0;
+        }
+        server->dirty = dirty;
+        memset(server->connections + server->no_of_connection_slots, 0,
+               sizeof(Connection*) * (slots - server->no_of_connection_slots));
+        server->no_of_connection_slots = slots;
+    }
+
+    Connection* conn = calloc(1, sizeof(Connection));
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if(conn == NULL || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+    {
+        free(conn);
+        return 0;
+    }
+    conn->fd = fd;
+    conn->events = EPOLLIN;
+    conn->game_idx = -1;
+    server->connections[fd] = conn;
+    return 1;
+}
+
+static void accept_connections(Server* server)
+{
+    for(;;)
+    {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd == -1)
+        {
+            if((errno == EMFILE || errno == ENFILE) && server->spare_fd != -1)
+            {
+                // Out of fds: take the client with the spare one and close it,
+                // or it would stay in the backlog and wake us up forever
+                close(server->spare_fd);
+                fd = accept(server->listen_fd, NULL, NULL);
+                if(fd != -1)
+                {
+                    close(fd);
+                }
+                server->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                LOG(LOG_NORMAL, "Out of file descriptors, a client was refused\n");
+                continue;
+            }
+            return;
+        }
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        if(!add_connection(server, fd))
+        {
+            close(fd);
+        }
+    }
+}
+
+/* Games */
+
+static long allocate_game(Server* server)
+{
+    if(server->no_of_free_games == 0)
+    {
+        long slots = server->no_of_game_slots > 0 ? server->no_of_game_slots * 2 : 64;
+        Server_game* games = realloc(server->games, sizeof(Server_game) * slots);
+        long* free_games = games != NULL ? realloc(server->free_games, sizeof(long) * slots) : NULL;
+        if(games != NULL)
+        {
+            server->games = games;
+        }
+        if(free_games == NULL)
+        {
+            return -1;
+        }
+        server->free_games = free_games;
+        for(long idx = slots - 1; idx >= server->no_of_game_slots; idx--)
+        {
+            server->games[idx].is_used = 0;
+            server->free_games[server->no_of_free_games++] = idx;
+        }
+        server->no_of_game_slots = slots;
+    }
+    return server->free_games[--server->no_of_free_games];
+}
+
+// Frees the game, its players stay connected and may play another one
+static void release_game(Server* server, long game_idx, const char* last_line)
+{
+    Server_game* game = &server->games[game_idx];
+    for(int seat = 0; seat < game->info.no_of_players; seat++)
+    {
+        Connection* conn = seat_connection(server, game, seat);
+        if(conn != NULL)
+        {
+            if(last_line != NULL)
+            {
+                queue_line(server, conn, last_line);
+            }
+            conn->game_idx = -1;
+        }
+    }
+    game->is_used = 0;
+    server->free_games[server->no_of_free_games++] = game_idx;
+}
+
+// Plays bot moves and round ends until a human seat is on move or the
+// game is over
+static void advance_game(Server* server, long game_idx)
+{
+    Server_game* game = &server->games[game_idx];
+    Game* info = &game->info;
+    char text[MAX_LINE_TEXT];
+
+    for(;;)
+    {
+        if(is_round_over(info))
+        {
+            process_end_of_round(info, NULL);
+            if(check_game_end(info) || info->flow.round_number >= MAX_ROUNDS)
+            {
+                calculate_final_bonuses(info, NULL);
+                format_end_line(info, text);
+                broadcast_line(server, game, text);
+                release_game(server, game_idx, NULL);
+                server->games_finished++;
+                return;
+            }
+            start_round(info);
+            format_fill_line(info, text);
+            broadcast_line(server, game, text);
+            continue;
+        }
+
+        int seat = info->flow.player_on_move;
+        if(game->seats[seat] == SEAT_HUMAN)
+        {
+            queue_line(server, seat_connection(server, game, seat), "turn");
+            return;
+        }
+        Bot bot;
+        default_bot(&bot, game->seats[seat]);
+        Move move = choose_bot_move(info, &bot, &game->bot_rng);
+        apply_move(info, move);
+        format_move(move, text);
+        broadcast_line(server, game, text);
+        server->moves_played++;
+    }
+}
+
+static void start_game(Server* server, long game_idx)
+{
+    Server_game* game = &server->games[game_idx];
+    char text[MAX_LINE_TEXT];
+
+    format_game_line(game->info.no_of_players, &game->seed, text);
+    for(int seat = 0; seat < game->info.no_of_players; seat++)
+    {
+        Connection* conn = seat_connection(server, game, seat);
+        if(conn != NULL)
+        {
+            char seat_text[16];
+            snprintf(seat_text, sizeof(seat_text), "seat %d", seat + 1);
+            queue_line(server, conn, seat_text);
+            queue_line(server, conn, text);
+        }
+    }
+    start_round(&game->info);
+    format_fill_line(&game->info, text);
+    broadcast_line(server, game, text);
+    advance_game(server, game_idx);
+}
+
+static void take_seat(Server* server, long game_idx, Connection* conn)
+{
+    Server_game* game = &server->games[game_idx];
+    for(int seat = 0; seat < game->info.no_of_players; seat++)
+    {
+        if(game->seats[seat] == SEAT_HUMAN && game->connections[seat] == NO_CONNECTION)
+        {
+            game->connections[seat] = conn->fd;
+            game->free_seats--;
+            conn->game_idx = game_idx;
+            conn->seat = seat;
+            break;
+        }
+    }
+    if(game->free_seats == 0)
+    {
+        start_game(server, game_idx);
+    }
+}
+
+/* Commands */
+
+// "human,greedy,..." into seat types, returns the number of seats or 0
+static int parse_seat_list(const char* text, int length, int seats[MAX_PLAYERS])
+{
+    int no_of_seats = 0, no_of_humans = 0;
+    const char* end = text + length;
+    while(text < end)
+    {
+        const char* comma = memchr(text, ',', end - text);
+        const char* item_end = comma != NULL ? comma : end;
+        char name[16];
+        if(no_of_seats == MAX_PLAYERS || item_end - text >= (long)sizeof(name))
+        {
+            return 0;
+        }
+        memcpy(name, text, item_end - text);
+        name[item_end - text] = '\0';
+
+        // Search bots would hold up every other game of the loop
+        int type = strcmp(name, "human") == 0 ? SEAT_HUMAN : bot_type_from_name(name);
+        if(type != SEAT_HUMAN && type != BOT_RANDOM && type != BOT_GREEDY)
+        {
+            return 0;
+        }
+        no_of_humans += type == SEAT_HUMAN;
+        seats[no_of_seats++] = type;
+        text = comma != NULL ? comma + 1 : end;
+    }
+    return no_of_seats >= 2 && no_of_humans > 0 ? no_of_seats : 0;
+}
+
+static void new_game_command(Server* server, Connection* conn, const char* args, int length)
+{
+    int seats[MAX_PLAYERS];
+    int no_of_seats = parse_seat_list(args, length, seats);
+    char text[32];
+
+    if(no_of_seats == 0)
+    {
+        queue_line(server, conn, "error new needs 2-4 seats of human, random or greedy, one human at least");
+        return;
+    }
+    long game_idx = allocate_game(server);
+    if(game_idx == -1)
+    {
+        queue_line(server, conn, "error out of memory");
+        return;
+    }
+
+    Server_game* game = &server->games[game_idx];
+    game->seed = derive_seed(server->seed, server->games_created++);
+    memset(&game->info, 0, sizeof(game->info));
+    init_game(&game->info, no_of_seats, game->seed);
+    rng_seed(&game->bot_rng, derive_seed(game->seed, 1));
+    game->free_seats = 0;
+    for(int seat = 0; seat < no_of_seats; seat++)
+    {
+        game->seats[seat] = seats[seat];
+        game->connections[seat] = NO_CONNECTION;
+        game->free_seats += seats[seat] == SEAT_HUMAN;
+    }
+    game->is_used = 1;
+
+    snprintf(text, sizeof(text), "created %ld", game_idx);
+    queue_line(server, conn, text);
+    take_seat(server, game_idx, conn);
+}
+
+static void join_command(Server* server, Connection* conn, const char* args, int length)
+{
+    char number[24];
+    char* rest;
+    if(length == 0 || length >= (int)sizeof(number))
+    {
+        queue_line(server, conn, "error join needs a game number");
+        return;
+    }
+    memcpy(number, args, length);
+    number[length] = '\0';
+    long game_idx = strtol(number, &rest, 10);
+    if(*rest != '\0' || game_idx < 0 || game_idx >= server->no_of_game_slots ||
+       !server->games[game_idx].is_used || server->games[game_idx].free_seats == 0)
+    {
+        queue_line(server, conn, "error no such game waiting for players");
+        return;
+    }
+    take_seat(server, game_idx, conn);
+}
+
+static void move_command(Server* server, Connection* conn, Move move)
+{
+    Server_game* game = &server->games[conn->game_idx];
+    char text[MAX_MOVE_TEXT];
+
+    if(game->free_seats > 0)
+    {
+        queue_line(server, conn, "error the game waits for players");
+        return;
+    }
+    if(game->info.flow.player_on_move != conn->seat)
+    {
+        queue_line(server, conn, "error not your turn");
+        return;
+    }
+    if(!apply_move(&game->info, move))
+    {
+        queue_line(server, conn, "error illegal move");
+        return;
+    }
+    format_move(move, text);
+    broadcast_line(server, game, text);
+    server->moves_played++;
+    advance_game(server, conn->game_idx);
+}
+
+static void handle_line(Server* server, Connection* conn, const char* line, int length)
+{
+    while(length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' '))
+    {
+        length--;
+    }
+    while(length > 0 && *line == ' ')
+    {
+        line++;
+        length--;
+    }
+    const char* space = memchr(line, ' ', length);
+    int word_length = space != NULL ? (int)(space - line) : length;
+    const char* args = space != NULL ? space + 1 : line + length;
+    int args_length = (int)(line + length - args);
+    Move move;
+
+    if(length == 0)
+    {
+        return;
+    }
+    if(word_length == 4 && memcmp(line, "quit", 4) == 0)
+    {
+        conn->is_closing = 1;
+        mark_dirty(server, conn);
+    }
+    else if(word_length == 3 && memcmp(line, "new", 3) == 0)
+    {
+        if(conn->game_idx != -1)
+        {
+            queue_line(server, conn, "error already in a game");
+            return;
+        }
+        new_game_command(server, conn, args, args_length);
+    }
+    else if(word_length == 4 && memcmp(line, "join", 4) == 0)
+    {
+        if(conn->game_idx != -1)
+        {
+            queue_line(server, conn, "error already in a game");
+            return;
+        }
+        join_command(server, conn, args, args_length);
+    }
+    else if(parse_move(line, length, &move))
+    {
+        if(conn->game_idx == -1)
+        {
+            queue_line(server, conn, "error not in a game");
+            return;
+        }
+        move_command(server, conn, move);
+    }
+    else
+    {
+        queue_line(server, conn, "error unknown command");
+    }
+}
+
+// One read per wake-up, so a client that floods us does not starve the others
+static void read_connection(Server* server, Connection* conn)
+{
+    ssize_t got = read(conn->fd, conn->input + conn->input_length, SERVER_LINE_SIZE - conn->input_length);
+    if(got == -1 && (errno == EAGAIN || errno == EINTR))
+    {
+        return;
+    }
+    if(got <= 0)
+    {
+        conn->output_length = conn->output_sent = 0;
+        conn->is_closing = 1;
+        mark_dirty(server, conn);
+        return;
+    }
+
+    conn->input_length += got;
+    int start = 0;
+    for(;;)
+    {
+        char* newline = memchr(conn->input + start, '\n', conn->input_length - start);
+        if(newline == NULL || conn->is_closing)
+        {
+            break;
+        }
+        handle_line(server, conn, conn->input + start, (int)(newline - conn->input - start));
+        start = (int)(newline + 1 - conn->input);
+    }
+    memmove(conn->input, conn->input + start, conn->input_length - start);
+    conn->input_length -= start;
+    if(conn->input_length == SERVER_LINE_SIZE)
+    {
+        queue_line(server, conn, "error line too long");
+        conn->is_closing = 1;
+    }
+}
+
+static void close_connection(Server* server, Connection* conn)
+{
+    if(conn->game_idx != -1)
+    {
+        Server_game* game = &server->games[conn->game_idx];
+        game->connections[conn->seat] = NO_CONNECTION;
+        release_game(server, conn->game_idx, "abandoned");
+    }
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    server->connections[conn->fd] = NULL;
+    free(conn->output);
+    free(conn);
+}
+
+// Sends what the socket takes now, the rest when it is writable again.
+// Connections are only closed here, so no command ever sees a freed one.
+static void flush_connections(Server* server)
+{
+    while(server->no_of_dirty > 0)
+    {
+        Connection* conn = server->connections[server->dirty[--server->no_of_dirty]];
+        conn->is_dirty = 0;
+
+        while(conn->output_sent < conn->output_length)
+        {
+            ssize_t sent = send(conn->fd, conn->output + conn->output_sent,
+                                conn->output_length - conn->output_sent, MSG_NOSIGNAL);
+            if(sent == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if(sent == -1)
+            {
+                if(errno != EAGAIN)
+                {
+                    conn->output_length = conn->output_sent = 0;
+                    conn->is_closing = 1;
+                }
+                break;
+            }
+            conn->output_sent += sent;
+        }
+        if(conn->output_sent == conn->output_length)
+        {
+            conn->output_length = conn->output_sent = 0;
+        }
+
+        int wants_write = conn->output_length > 0;
+        if(conn->is_closing && !wants_write)
+        {
+            close_connection(server, conn);
+            continue;
+        }
+        // A closing connection is not read any more, so it must not wait
+        // for input either: level-triggered EPOLLIN would fire forever
+        unsigned int events = (conn->is_closing ? 0 : EPOLLIN) | (wants_write ? EPOLLOUT : 0);
+        if(events != conn->events)
+        {
+            struct epoll_event event;
+            event.events = events;
+            event.data.fd = conn->fd;
+            epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+            conn->events = events;
+        }
+    }
+}
+
+static void free_server(Server* server)
+{
+    for(int fd = 0; fd < server->no_of_connection_slots; fd++)
+    {
+        if(server->connections[fd] != NULL)
+        {
+            close(fd);
+            free(server->connections[fd]->output);
+            free(server->connections[fd]);
+        }
+    }
+    if(server->spare_fd != -1)
+    {
+        close(server->spare_fd);
+    }
+    close(server->listen_fd);
+    close(server->epoll_fd);
+    free(server->connections);
+    free(server->dirty);
+    free(server->games);
+    free(server->free_games);
+}
+
+// Serves games until SIGINT or SIGTERM. Game i is played from
+// derive_seed(seed, i).
+int run_server(const char* address_text, uint64_t seed)
+{
+    struct sockaddr_storage address;
+    socklen_t address_length;
+    struct epoll_event events[MAX_EVENTS];
+    Server server;
+
+    if(!parse_server_address(address_text, &address, &address_length))
+    {
+        printf("Not a server address: %s\n", address_text);
+        return EXIT_FAILURE;
+    }
+    memset(&server, 0, sizeof(server));
+    server.seed = seed;
+    server.listen_fd = open_listener(&address, address_length);
+    if(server.listen_fd == -1)
+    {
+        printf("Cannot listen on %s: %s\n", address_text, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server.spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    server.no_of_connection_slots = 1024;
+    server.connections = calloc(server.no_of_connection_slots, sizeof(Connection*));
+    server.dirty = malloc(sizeof(int) * server.no_of_connection_slots);
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = server.listen_fd;
+    if(server.epoll_fd == -1 || server.connections == NULL || server.dirty == NULL ||
+       epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &event) == -1)
+    {
+        printf("Cannot start the server\n");
+        free_server(&server);
+        return EXIT_FAILURE;
+    }
+
+    // No SA_RESTART, so a signal ends epoll_wait() and the loop sees it
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    LOG(LOG_NORMAL, "Serving games on %s\n", address_text);
+    while(!stop_requested)
+    {
+        int no_of_events = epoll_wait(server.epoll_fd, events, MAX_EVENTS, -1);
+        if(no_of_events == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            printf("epoll_wait: %s\n", strerror(errno));
+            break;
+        }
+        for(int i = 0; i < no_of_events; i++)
+        {
+            int fd = events[i].data.fd;
+            if(fd == server.listen_fd)
+            {
+                accept_connections(&server);
+                continue;
+            }
+            Connection* conn = server.connections[fd];
+            if(conn == NULL)
+            {
+                continue;
+            }
+            if(conn->is_closing)
+            {
+                // Only its output is left: a dead peer will never take it
+                if(events[i].events & (EPOLLHUP | EPOLLERR))
+                {
+                    conn->output_length = conn->output_sent = 0;
+                }
+                mark_dirty(&server, conn);
+                continue;
+            }
+            if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                read_connection(&server, conn);
+            }
+            if(events[i].events & EPOLLOUT)
+            {
+                mark_dirty(&server, conn);
+            }
+        }
+        flush_connections(&server);
+    }
+
+    LOG(LOG_NORMAL, "Served %ld games, %ld finished, %ld moves\n",
+        server.games_created, server.games_finished, server.moves_played);
+    free_server(&server);
+    if(address.ss_family == AF_UNIX)
+    {
+        unlink(((struct sockaddr_un*)&address)->sun_path);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+/*AZUL BOARD GAME - Game server
+
+Hosts any number of games in one process: a single epoll loop accepts
+connections on a TCP or Unix socket, reads their commands and sends the
+games back as they are played. Nothing ever blocks on one client, a slow
+or silent player only holds up its own game.
+
+Every line is a command or an update, ending with '\n':
+
+    client to server
+    new human,greedy        a new game with these seats (human, random or
+                            greedy); the connection takes the first human
+                            seat, the bots are played by the server
+    join 12                 the next free human seat of game 12
+    F3 red L2               a move, in game notation, when it is our turn
+    quit                    close the connection
+
+    server to client
+    created 12              the id of our new game, to give to join
+    seat 2                  our seat (from 1), once the game starts
+    game 2 seed 1234        the game as notation lines (azul_notation.h):
+    fill BBRK ... / moves   game, fill of each round, every move of every
+    end 28 17               seat and the final scores
+    turn                    our move is awaited
+    error <why>             the command was refused, the game goes on
+    abandoned               a player left, the game is over
+
+A connection plays one game at a time and may start or join another once
+it is over. Addresses are "unix:/path/to/socket", "host:port" or a port
+number alone for 127.0.0.1.
+*/
+
+#ifndef AZUL_SERVER_H
+#define AZUL_SERVER_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#define SERVER_LINE_SIZE 256
+#define SERVER_MAX_OUTPUT (1 << 20)   // a client this far behind is dropped
+
+int parse_server_address(const char* text, struct sockaddr_storage* address, socklen_t* length);
+int run_server(const char* address_text, uint64_t seed);
+
+#endif
@@ -0,0 +1,98 @@
+/*AZUL BOARD GAME - Transposition table
+See azul_tt.h.
+
+Data word layout:
+    bits  0-31  value
+    bits 32-39  depth
+    bits 40-41  bound
+    bits 42-50  best move index + 1 (0 = no move)
+*/
+
+#include <stdlib.h>
+
+#include "azul_tt.h"
+
+static uint64_t pack_entry(int value, int depth, int bound, const Move* best_move)
+{
+    uint64_t move_code = best_move ? (uint64_t)(move_to_index(*best_move) + 1) : 0;
+    return (uint64_t)(uint32_t)value |
+           (uint64_t)(depth & 0xFF) << 32 |
+           (uint64_t)(bound & 3) << 40 |
+           move_code << 42;
+}
+
+// Returns 1 if the table could be allocated. The size is rounded down to
+// a power of two number of slots.
+int tt_init(Transposition_table* table, size_t size_in_mb)
+{
+    size_t no_of_slots = 1;
+    while(no_of_slots * 2 * sizeof(Tt_slot) <= size_in_mb * 1024 * 1024)
+    {
+        no_of_slots *= 2;
+    }
+
+    table->slots = calloc(no_of_slots, sizeof(Tt_slot));
+    if(table->slots == NULL)
+    {
+        table->mask = 0;
+        return 0;
+    }
+    table->mask = no_of_slots - 1;
+    return 1;
+}
+
+void tt_free(Transposition_table* table)
+{
+    free(table->slots);
+    table->slots = NULL;
+    table->mask = 0;
+}
+
+void tt_clear(Transposition_table* table)
+{
+    for(size_t i = 0; i <= table->mask; i++)
+    {
+        atomic_store_explicit(&table->slots[i].key_xor_data, 0, memory_order_relaxed);
+        atomic_store_explicit(&table->slots[i].data, 0, memory_order_relaxed);
+    }
+}
+
+// Returns 1 and fills `entry` if the position is in the table
+int tt_probe(const Transposition_table* table, uint64_t key, Tt_entry* entry)
+{
+    Tt_slot* slot = &table->slots[key & table->mask];
+    uint64_t data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    uint64_t check = atomic_load_explicit(&slot->key_xor_data, memory_order_relaxed);
+    if((check ^ data) != key || data == 0)
+    {
+        return 0;
+    }
+
+    entry->value = (int32_t)(uint32_t)data;
+    entry->depth = (data >> 32) & 0xFF;
+    entry->bound = (data >> 40) & 3;
+    int move_code = (data >> 42) & 0x1FF;
+    entry->has_best_move = move_code != 0;
+    if(move_code != 0)
+    {
+        entry->best_move = move_from_index(move_code - 1);
+    }
+    return 1;
+}
+
+// Replaces the slot unless it holds the same position searched deeper.
+// `best_move` may be NULL.
+void tt_store(Transposition_table* table, uint64_t key, int value, int depth, int bound, const Move* best_move)
+{
+    Tt_slot* slot = &table->slots[key & table->mask];
+    uint64_t old_data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    uint64_t old_check = atomic_load_explicit(&slot->key_xor_data, memory_order_relaxed);
+    if((old_check ^ old_data) == key && (int)((old_data >> 32) & 0xFF) > depth)
+    {
+        return;
+    }
+
+    uint64_t data = pack_entry(value, depth, bound, best_move);
+    atomic_store_explicit(&slot->key_xor_data, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+}
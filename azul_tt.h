@@ -0,0 +1,49 @@
+/*AZUL BOARD GAME - Transposition table
+
+Fixed-size table of search results keyed by Game.hash, shared by all
+search threads without locks. Each slot is two 64-bit words, the data and
+the key XOR-ed with the data; a slot torn by two concurrent writers no
+longer matches its key and is simply read as a miss.
+*/
+
+#ifndef AZUL_TT_H
+#define AZUL_TT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "azul_rules.h"
+
+#define TT_BOUND_EXACT 0
+#define TT_BOUND_LOWER 1
+#define TT_BOUND_UPPER 2
+
+typedef struct
+{
+    int value;
+    int depth;
+    int bound;
+    int has_best_move;
+    Move best_move;
+}Tt_entry;
+
+typedef struct
+{
+    _Atomic uint64_t key_xor_data;
+    _Atomic uint64_t data;
+}Tt_slot;
+
+typedef struct
+{
+    Tt_slot* slots;
+    size_t mask;
+}Transposition_table;
+
+int tt_init(Transposition_table* table, size_t size_in_mb);
+void tt_free(Transposition_table* table);
+void tt_clear(Transposition_table* table);
+int tt_probe(const Transposition_table* table, uint64_t key, Tt_entry* entry);
+void tt_store(Transposition_table* table, uint64_t key, int value, int depth, int bound, const Move* best_move);
+
+#endif
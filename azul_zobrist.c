@@ -0,0 +1,72 @@
+/*AZUL BOARD GAME - Zobrist hashing
+See azul_zobrist.h.
+*/
+
+#include "azul_zobrist.h"
+
+int pattern_line_code(const Mat* mat, int line)
+{
+    int count = pattern_line_count(mat, line);
+    if(count == 0)
+    {
+        return 0;
+    }
+    return pattern_line_color(mat, line) << 4 | count;
+}
+
+int floor_slot_code(int slot)
+{
+    if(slot == TOKEN_MARKER)
+    {
+        return 6;
+    }
+    if(slot >= 0 && slot < HOW_MANY_TILES_TYPES)
+    {
+        return slot + 1;
+    }
+    return 0;
+}
+
+// Full hash of a position, the incremental updates must always match it
+uint64_t compute_game_hash(const Game* info)
+{
+    uint64_t hash = 0;
+
+    for(int p = 0; p < info->no_of_players; p++)
+    {
+        const Mat* mat = &info->players[p].mat;
+        for(int line = 0; line < 5; line++)
+        {
+            hash ^= zobrist_key(ZOBRIST_PATTERN_LINE, p, line, pattern_line_code(mat, line));
+        }
+        for(int bit = 0; bit < 25; bit++)
+        {
+            hash ^= zobrist_key(ZOBRIST_WALL, p, bit, (mat->portugese_wall >> bit) & 1);
+        }
+        for(int i = 0; i < MAX_PENALTIES; i++)
+        {
+            hash ^= zobrist_key(ZOBRIST_FLOOR, p, i, floor_slot_code(mat->penalties[i]));
+        }
+        hash ^= zobrist_key(ZOBRIST_PLAYER_TOKEN, p, 0, info->players[p].is_token_present);
+        hash ^= zobrist_key(ZOBRIST_SCORE, p, 0, mat->score);
+    }
+
+    for(int f = 0; f < info->no_of_factory_displays; f++)
+    {
+        for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+        {
+            hash ^= zobrist_key(ZOBRIST_FACTORY, f, color, count_tiles_in_source(info, f, color));
+        }
+    }
+
+    for(int color = 0; color < HOW_MANY_TILES_TYPES; color++)
+    {
+        hash ^= zobrist_key(ZOBRIST_MIDDLE_PILE, 0, color, info->middle_pile.all_tiles[color]);
+        hash ^= zobrist_key(ZOBRIST_BAG, 0, color, info->bag.all_tiles[color]);
+        hash ^= zobrist_key(ZOBRIST_BOX_LID, 0, color, info->box_lid.all_tiles[color]);
+    }
+    hash ^= zobrist_key(ZOBRIST_MIDDLE_TOKEN, 0, 0, info->middle_pile.is_token_present);
+    hash ^= zobrist_key(ZOBRIST_PLAYER_ON_MOVE, 0, 0, info->flow.player_on_move + 1);
+
+    return hash;
+}
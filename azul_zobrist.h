@@ -0,0 +1,50 @@
+/*AZUL BOARD GAME - Zobrist hashing
+
+Game.hash is the XOR of one key per (component, value) of the state, kept
+up to date by the rules functions as tiles move. Keys are derived from
+their index with a splitmix64 mix, so there is no table to initialise and
+every thread sees the same keys. A value of 0 (empty line, no tiles of a
+color, ...) has no key, which makes an empty component cost nothing.
+*/
+
+#ifndef AZUL_ZOBRIST_H
+#define AZUL_ZOBRIST_H
+
+#include <stdint.h>
+
+#include "azul_rules.h"
+
+#define ZOBRIST_PATTERN_LINE 1
+#define ZOBRIST_WALL 2
+#define ZOBRIST_FLOOR 3
+#define ZOBRIST_PLAYER_TOKEN 4
+#define ZOBRIST_SCORE 5
+#define ZOBRIST_FACTORY 6
+#define ZOBRIST_MIDDLE_PILE 7
+#define ZOBRIST_MIDDLE_TOKEN 8
+#define ZOBRIST_BAG 9
+#define ZOBRIST_PLAYER_ON_MOVE 10
+#define ZOBRIST_BOX_LID 11
+
+static inline uint64_t zobrist_key(int kind, int a, int b, int value)
+{
+    if(value == 0)
+    {
+        return 0;
+    }
+    uint64_t x = ((uint64_t)kind << 48) ^ ((uint64_t)(a & 0xFF) << 40) ^
+                 ((uint64_t)(b & 0xFF) << 32) ^ (uint32_t)value;
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Value hashed for a pattern line: color << 4 | count, 0 when empty
+int pattern_line_code(const Mat* mat, int line);
+// Value hashed for a floor slot: 0 empty, 1-5 color + 1, 6 token
+int floor_slot_code(int slot);
+
+uint64_t compute_game_hash(const Game* info);
+
+#endif
@@ -0,0 +1,399 @@
+/*AZUL BOARD GAME - Engine microbenchmarks
+
+Times the hot paths of the rules core on positions taken from random
+games played from a fixed seed, so two builds measure the same work:
+
+    gcc -O2 -pthread tools/azul_bench.c azul_*.c -o azul_bench -lm
+    ./azul_bench [--seed <n>] [--time <seconds>] [--format text|csv|json]
+
+Every benchmark repeats its operation, doubling the count until it runs
+for at least --time seconds, and reports ns/op and ops/sec. Benchmarks
+that need a fresh position copy it first; copy_game times that copy on
+its own so it can be taken off.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../azul_rules.h"
+
+#define NO_OF_POSITIONS 4096
+// Random games that go on longer than this are cut short
+#define MAX_ROUNDS 50
+#define FORMAT_TEXT 0
+#define FORMAT_CSV 1
+#define FORMAT_JSON 2
+
+typedef struct
+{
+    Game start;                            // first position of a game, bag full
+    Game* positions;                       // moves left to play in the round
+    Move* moves;                           // a legal move of each position
+    Game* round_ends;                      // round over, not scored yet
+    Game* game_ends;                       // last round scored, no bonuses yet
+    int no_of_positions;
+    int no_of_round_ends;
+    int no_of_game_ends;
+    uint64_t seed;
+}Bench_data;
+
+// Runs `iterations` operations, returns how many items they handled
+// (moves generated, moves played, ...), 0 if items are the operations
+typedef long (*Bench_run)(Bench_data* data, long iterations);
+
+typedef struct
+{
+    const char* name;
+    const char* item;                      // what the items are, NULL if none
+    Bench_run run;
+}Benchmark;
+
+// Keeps results alive so the compiler cannot drop the work
+static volatile long sink;
+
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Plays uniformly random games and keeps the positions the benchmarks use
+static int collect_positions(Bench_data* data)
+{
+    Rng rng;
+    Move moves[MAX_LEGAL_MOVES];
+    long seen = 0;
+
+    data->positions = malloc(sizeof(Game) * NO_OF_POSITIONS);
+    data->moves = malloc(sizeof(Move) * NO_OF_POSITIONS);
+    data->round_ends = malloc(sizeof(Game) * NO_OF_POSITIONS);
+    data->game_ends = malloc(sizeof(Game) * NO_OF_POSITIONS);
+    if(data->positions == NULL || data->moves == NULL || data->round_ends == NULL || data->game_ends == NULL)
+    {
+        return 0;
+    }
+    data->no_of_positions = data->no_of_round_ends = data->no_of_game_ends = 0;
+
+    memset(&data->start, 0, sizeof(data->start));
+    init_game(&data->start, 2, data->seed);
+    rng_seed(&rng, derive_seed(data->seed, 1));
+
+    for(long game = 0; data->no_of_game_ends < NO_OF_POSITIONS; game++)
+    {
+        Game info;
+        memset(&info, 0, sizeof(info));
+        init_game(&info, 2 + game % 3, derive_seed(data->seed, game + 2));
+
+        int game_ended = 0;
+        while(!game_ended && info.flow.round_number < MAX_ROUNDS)
+        {
+            start_round(&info);
+            while(!is_round_over(&info))
+            {
+                int no_of_moves = generate_legal_moves(&info, moves);
+                Move move = moves[rng_below(&rng, no_of_moves)];
+                // Every position at first, then a spread of later ones
+                int slot = data->no_of_positions < NO_OF_POSITIONS ? data->no_of_positions++
+                                                                   : (int)rng_below(&rng, seen + 1);
+                if(slot < NO_OF_POSITIONS)
+                {
+                    data->positions[slot] = info;
+                    data->moves[slot] = move;
+                }
+                seen++;
+                apply_move(&info, move);
+            }
+            if(data->no_of_round_ends < NO_OF_POSITIONS)
+            {
+                data->round_ends[data->no_of_round_ends++] = info;
+            }
+            process_end_of_round(&info, NULL);
+            game_ended = check_game_end(&info);
+        }
+        if(game_ended)
+        {
+            data->game_ends[data->no_of_game_ends++] = info;
+        }
+    }
+    return 1;
+}
+
+static long bench_copy_game(Bench_data* data, long iterations)
+{
+    Game info;
+    long total = 0;
+    for(long i = 0; i < iterations; i++)
+    {
+        memcpy(&info, &data->positions[i % data->no_of_positions], sizeof(info));
+        total += info.flow.player_on_move;
+    }
+    sink = total;
+    return 0;
+}
+
+static long bench_factory_fill(Bench_data* data, long iterations)
+{
+    Game info = data->start;
+    long total = 0;
+    for(long i = 0; i < iterations; i++)
+    {
+        // A full bag every time, so each fill draws the same number of tiles
+        info.bag = data->start.bag;
+        total += amplasete_tiles_on_a_factory(&info);
+    }
+    sink = total + info.factory_displays.all_factories[0][0];
+    return 0;
+}
+
+static long bench_generate_moves(Bench_data* data, long iterations)
+{
+    Move moves[MAX_LEGAL_MOVES];
+    long total = 0;
+    for(long i = 0; i < iterations; i++)
+    {
+        total += generate_legal_moves(&data->positions[i % data->no_of_positions], moves);
+    }
+    sink = total;
+    return total;
+}
+
+static long bench_apply_undo_move(Bench_data* data, long iterations)
+{
+    Undo_record undo;
+    long total = 0;
+    for(long i = 0; i < iterations; i++)
+    {
+        Game* info = &data->positions[i % data->no_of_positions];
+        total += apply_move_with_undo(info, data->moves[i % data->no_of_positions], &undo);
+        undo_move(info, &undo);
+    }
+    sink = total;
+    return 0;
+}
+
+static long bench_copy_apply_move(Bench_data* data, long iterations)
+{
+    Game info;
+    long total = 0;
+    for(long i = 0; i < iterations; i++)
+    {
+        info = data->positions[i % data->no_of_positions];
+        total += apply_move(&info, data->moves[i % data->no_of_positions]);
+    }
+    sink = total;
+    return 0;
+}
+
+static long bench_end_of_round(Bench_data* data, long iterations)
+{
+    Game info;
+    long total = 0;
+    for(long i = 0; i < iterations; i++)
+    {
+        info = data->round_ends[i % data->no_of_round_ends];
+        process_end_of_round(&info, NULL);
+        total += info.players[0].mat.score;
+    }
+    sink = total;
+    return 0;
+}
+
+static long bench_final_bonuses(Bench_data* data, long iterations)
+{
+    Game info;
+    long total = 0;
+    for(long i = 0; i < iterations; i++)
+    {
+        info = data->game_ends[i % data->no_of_game_ends];
+        calculate_final_bonuses(&info, NULL);
+        total += info.players[0].mat.score;
+    }
+    sink = total;
+    return 0;
+}
+
+static long bench_check_game_end(Bench_data* data, long iterations)
+{
+    long total = 0;
+    for(long i = 0; i < iterations; i++)
+    {
+        // Alternate finished and running games
+        const Game* info = i & 1 ? &data->game_ends[(i >> 1) % data->no_of_game_ends]
+                                 : &data->round_ends[(i >> 1) % data->no_of_round_ends];
+        total += check_game_end(info);
+    }
+    sink = total;
+    return 0;
+}
+
+static long bench_random_playout(Bench_data* data, long iterations)
+{
+    Move moves[MAX_LEGAL_MOVES];
+    Rng rng;
+    long total_moves = 0;
+
+    rng_seed(&rng, data->seed);
+    for(long i = 0; i < iterations; i++)
+    {
+        Game info = data->start;
+        rng_seed(&info.rng, derive_seed(data->seed, i));
+        int game_ended = 0;
+        while(!game_ended && info.flow.round_number < MAX_ROUNDS)
+        {
+            start_round(&info);
+            while(!is_round_over(&info))
+            {
+                int no_of_moves = generate_legal_moves(&info, moves);
+                apply_move(&info, moves[rng_below(&rng, no_of_moves)]);
+                total_moves++;
+            }
+            process_end_of_round(&info, NULL);
+            game_ended = check_game_end(&info);
+        }
+        calculate_final_bonuses(&info, NULL);
+        sink = info.players[0].mat.score;
+    }
+    return total_moves;
+}
+
+static const Benchmark benchmarks[] = {
+    {"copy_game", NULL, bench_copy_game},
+    {"factory_fill", NULL, bench_factory_fill},
+    {"generate_legal_moves", "moves", bench_generate_moves},
+    {"apply_undo_move", NULL, bench_apply_undo_move},
+    {"copy_apply_move", NULL, bench_copy_apply_move},
+    {"process_end_of_round", NULL, bench_end_of_round},
+    {"calculate_final_bonuses", NULL, bench_final_bonuses},
+    {"check_game_end", NULL, bench_check_game_end},
+    {"random_playout", "moves", bench_random_playout},
+};
+
+#define NO_OF_BENCHMARKS (int)(sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+static void print_usage(const char* program)
+{
+    printf("Usage: %s [--seed <n>] [--time <seconds>] [--format text|csv|json]\n", program);
+}
+
+int main(int argc, char* argv[])
+{
+    Bench_data data;
+    double min_seconds = 0.5;
+    int format = FORMAT_TEXT;
+
+    data.seed = 1;
+    for(int i = 1; i < argc; i++)
+    {
+        if(i + 1 >= argc)
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if(strcmp(argv[i], "--seed") == 0)
+        {
+            data.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--time") == 0)
+        {
+            min_seconds = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--format") == 0)
+        {
+            i++;
+            if(strcmp(argv[i], "text") == 0) format = FORMAT_TEXT;
+            else if(strcmp(argv[i], "csv") == 0) format = FORMAT_CSV;
+            else if(strcmp(argv[i], "json") == 0) format = FORMAT_JSON;
+            else
+            {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(!collect_positions(&data))
+    {
+        printf("Not enough memory for the benchmark positions\n");
+        return EXIT_FAILURE;
+    }
+
+    if(format == FORMAT_TEXT)
+    {
+        printf("%-24s %12s %12s %14s %16s\n", "benchmark", "iterations", "ns/op", "ops/sec", "items/sec");
+    }
+    else if(format == FORMAT_CSV)
+    {
+        printf("benchmark,seed,iterations,ns_per_op,ops_per_sec,item,items_per_sec\n");
+    }
+    else
+    {
+        printf("[\n");
+    }
+
+    for(int b = 0; b < NO_OF_BENCHMARKS; b++)
+    {
+        const Benchmark* bench = &benchmarks[b];
+        long iterations = 1;
+        long items;
+        double seconds;
+
+        bench->run(&data, 1);    // warm up caches
+        for(;;)
+        {
+            double start = now_in_seconds();
+            items = bench->run(&data, iterations);
+            seconds = now_in_seconds() - start;
+            if(seconds >= min_seconds || iterations > (1L << 40))
+            {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        double ns_per_op = seconds * 1e9 / iterations;
+        double ops_per_sec = iterations / seconds;
+        double items_per_sec = bench->item != NULL ? items / seconds : 0.0;
+        const char* item = bench->item != NULL ? bench->item : "";
+
+        if(format == FORMAT_TEXT)
+        {
+            printf("%-24s %12ld %12.1f %14.0f", bench->name, iterations, ns_per_op, ops_per_sec);
+            if(bench->item != NULL)
+            {
+                printf(" %10.0f %s", items_per_sec, item);
+            }
+            printf("\n");
+        }
+        else if(format == FORMAT_CSV)
+        {
+            printf("%s,%llu,%ld,%.3f,%.1f,%s,%.1f\n", bench->name, (unsigned long long)data.seed,
+                   iterations, ns_per_op, ops_per_sec, item, items_per_sec);
+        }
+        else
+        {
+            printf("  {\"benchmark\":\"%s\",\"seed\":%llu,\"iterations\":%ld,\"ns_per_op\":%.3f,"
+                   "\"ops_per_sec\":%.1f,\"item\":\"%s\",\"items_per_sec\":%.1f}%s\n",
+                   bench->name, (unsigned long long)data.seed, iterations, ns_per_op,
+                   ops_per_sec, item, items_per_sec, b + 1 < NO_OF_BENCHMARKS ? "," : "");
+        }
+        fflush(stdout);
+    }
+    if(format == FORMAT_JSON)
+    {
+        printf("]\n");
+    }
+
+    free(data.positions);
+    free(data.moves);
+    free(data.round_ends);
+    free(data.game_ends);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*AZUL BOARD GAME - Opening book generator
+
+Searches the first move of chosen games deeply and writes the opening
+book of azul_book.h:
+
+    gcc -O2 -pthread tools/azul_book.c azul_*.c -o azul_book -lm
+    ./azul_book --players 2 --seed 7 --games 1000 --depth 8 --out azul.book
+    ./Azul --book azul.book --seed 7 --games 1000 --seats expectimax,search
+
+There are far too many factory fills to search them all, so the book
+covers the games of one seed: the game Azul plays with --seed <n> and
+the games a batch or a server plays with --seed <n> --games <count>.
+Positions are canonicalized by book_key(), so fills met twice share one
+entry. Each position is one task on the thread pool, searched with one
+thread by expectimax (--depth, --samples) or MCTS (--bot search,
+--iterations), far deeper than the bots can afford while playing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../azul_book.h"
+#include "../azul_bots.h"
+#include "../azul_expectimax.h"
+#include "../azul_mcts.h"
+#include "../azul_pool.h"
+
+typedef struct
+{
+    int no_of_players;
+    uint64_t seed;
+    long games;
+    int bot_type;
+    int depth;
+    int samples;
+    long iterations;
+    int no_of_threads;
+    const char* out_path;
+}Book_options;
+
+typedef struct
+{
+    const Book_options* options;
+    Game* positions;
+    Book_entry* entries;
+    char* has_entry;
+    double* seconds;
+}Book_run;
+
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void book_task(long task_idx, int worker_idx, void* arg)
+{
+    (void)worker_idx;
+    Book_run* run = arg;
+    const Book_options* options = run->options;
+    const Game* position = &run->positions[task_idx];
+    uint64_t search_seed = derive_seed(position->hash, 0);
+    Move move;
+    double value = 0;
+    int found;
+    double start = now_in_seconds();
+
+    if(options->bot_type == BOT_SEARCH)
+    {
+        Mcts_config config;
+        Mcts_result result;
+        mcts_default_config(&config);
+        config.no_of_threads = 1;
+        config.max_iterations = options->iterations;
+        config.seed = search_seed;
+        found = mcts_search(position, &config, &result);
+        move = result.best_move;
+    }
+    else
+    {
+        Expectimax_config config;
+        Expectimax_result result;
+        expectimax_default_config(&config);
+        config.depth = options->depth;
+        config.chance_samples = options->samples;
+        config.seed = search_seed;
+        found = expectimax_search(position, &config, &result);
+        move = result.best_move;
+        value = result.value;
+    }
+    run->seconds[task_idx] = now_in_seconds() - start;
+    // A failed search leaves the position out of the book
+    run->has_entry[task_idx] = found && book_make_entry(position, move, value, &run->entries[task_idx]);
+}
+
+static void print_usage(const char* program)
+{
+    printf("Usage: %s [--players <n>] [--seed <n>] [--games <n>] [--bot <expectimax|search>] [--depth <n>]\n",
+           program);
+    printf("       [--samples <n>] [--iterations <n>] [--threads <n>] [--out <file>]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    Book_options options = {2, 1, 1000, BOT_EXPECTIMAX, 8, 4, 200000, 0, "azul.book"};
+    for(int i = 1; i < argc; i++)
+    {
+        int has_value = i + 1 < argc;
+        if(has_value && strcmp(argv[i], "--players") == 0)
+        {
+            options.no_of_players = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--seed") == 0)
+        {
+            options.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if(has_value && strcmp(argv[i], "--games") == 0)
+        {
+            options.games = atol(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--bot") == 0)
+        {
+            options.bot_type = bot_type_from_name(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--depth") == 0)
+        {
+            options.depth = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--samples") == 0)
+        {
+            options.samples = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--iterations") == 0)
+        {
+            options.iterations = atol(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--threads") == 0)
+        {
+            options.no_of_threads = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--out") == 0)
+        {
+            options.out_path = argv[++i];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(options.no_of_players < 2 || options.no_of_players > MAX_PLAYERS || options.games < 0 ||
+       (options.bot_type != BOT_EXPECTIMAX && options.bot_type != BOT_SEARCH) || options.depth <= 0 ||
+       options.iterations <= 0)
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // The game of --seed, then the games of --seed --games
+    long no_of_positions = options.games + 1;
+    Book_run run;
+    run.options = &options;
+    run.positions = malloc(sizeof(Game) * no_of_positions);
+    run.entries = calloc(no_of_positions, sizeof(Book_entry));
+    run.has_entry = calloc(no_of_positions, sizeof(char));
+    run.seconds = malloc(sizeof(double) * no_of_positions);
+    if(run.positions == NULL || run.entries == NULL || run.has_entry == NULL || run.seconds == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for(long g = -1; g < options.games; g++)
+    {
+        Game* position = &run.positions[g + 1];
+        memset(position, 0, sizeof(*position));
+        init_game(position, options.no_of_players, g < 0 ? options.seed : derive_seed(options.seed, g));
+        start_round(position);
+    }
+
+    double start = now_in_seconds();
+    int no_of_threads = options.no_of_threads > 0 ? options.no_of_threads : online_core_count();
+    run_parallel_tasks(no_of_positions, no_of_threads, book_task, &run);
+    double elapsed = now_in_seconds() - start;
+
+    double total = 0, longest = 0;
+    long no_of_entries = 0;
+    for(long p = 0; p < no_of_positions; p++)
+    {
+        total += run.seconds[p];
+        longest = run.seconds[p] > longest ? run.seconds[p] : longest;
+        if(run.has_entry[p])
+        {
+            run.entries[no_of_entries++] = run.entries[p];
+        }
+    }
+    // Fills met twice share one entry
+    if(!book_write(options.out_path, run.entries, no_of_entries))
+    {
+        printf("Cannot write %s\n", options.out_path);
+        return EXIT_FAILURE;
+    }
+    printf("%ld positions searched by %s in %.1fs on %d threads\n", no_of_positions, bot_name(options.bot_type),
+           elapsed, no_of_threads);
+    printf("search per position: mean %.3fs, longest %.3fs\n", total / no_of_positions, longest);
+    if(no_of_entries < no_of_positions)
+    {
+        printf("%ld searches failed and were left out\n", no_of_positions - no_of_entries);
+    }
+    printf("wrote %s\n", options.out_path);
+
+    free(run.positions);
+    free(run.entries);
+    free(run.has_entry);
+    free(run.seconds);
+    return 0;
+}
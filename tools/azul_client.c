@@ -0,0 +1,345 @@
+/*AZUL BOARD GAME - Test client of the game server
+
+Stands in for the human players of a server started with --serve: it
+opens one connection per human seat of each table, plays the tables'
+games to the end with bots and checks every game on the way. Each
+connection replays the lines it gets through the notation replayer, so
+an illegal move, a wrong fill or a final score that does not match the
+rules stops the run.
+
+    gcc -O2 -pthread tools/azul_client.c azul_*.c -o azul_client -lm
+    ./Azul --serve unix:/tmp/azul.sock &
+    ./azul_client --connect unix:/tmp/azul.sock --games 10000 --tables 500 --seats human,human
+
+--seats is the layout of every game (human seats are ours, random or
+greedy ones are played by the server), --bot how our seats move.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../azul_bots.h"
+#include "../azul_notation.h"
+#include "../azul_server.h"
+
+#define MAX_EVENTS 256
+#define INPUT_SIZE 4096
+
+typedef struct
+{
+    int fd;
+    int table_idx;
+    int seat_idx;                    // 0 creates the table's games, the others join
+    char input[INPUT_SIZE];
+    int input_length;
+    Notation_replayer replayer;
+    Notation_replay replay;
+    Rng rng;
+}Client_connection;
+
+typedef struct
+{
+    Client_connection* connections[MAX_PLAYERS];
+    int games_ended;                 // by the connections of the current game
+}Table;
+
+typedef struct
+{
+    const char* seats;
+    int no_of_humans;
+    Bot bot;
+    long games_to_start;
+    long games_done;
+    long moves;
+    Table* tables;
+}Client;
+
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int send_line(Client_connection* conn, const char* text)
+{
+    char line[SERVER_LINE_SIZE];
+    int length = snprintf(line, sizeof(line), "%s\n", text);
+    for(int sent = 0; sent < length;)
+    {
+        ssize_t done = write(conn->fd, line + sent, length - sent);
+        if(done == -1 && errno != EINTR)
+        {
+            return 0;
+        }
+        sent += done > 0 ? (int)done : 0;
+    }
+    return 1;
+}
+
+static int connect_to(const struct sockaddr_storage* address, socklen_t length)
+{
+    int fd = socket(address->ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd != -1 && connect(fd, (const struct sockaddr*)address, length) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int start_table_game(Client* client, Table* table)
+{
+    char text[SERVER_LINE_SIZE];
+    if(client->games_to_start == 0)
+    {
+        return 1;
+    }
+    client->games_to_start--;
+    table->games_ended = 0;
+    snprintf(text, sizeof(text), "new %s", client->seats);
+    return send_line(table->connections[0], text);
+}
+
+// Returns 0 if the line shows the server and the rules disagree
+static int handle_line(Client* client, Client_connection* conn, const char* line, int length)
+{
+    Table* table = &client->tables[conn->table_idx];
+    char text[SERVER_LINE_SIZE];
+
+    if(length >= 8 && memcmp(line, "created ", 8) == 0)
+    {
+        snprintf(text, sizeof(text), "join %.*s", length - 8, line + 8);
+        for(int h = 1; h < client->no_of_humans; h++)
+        {
+            if(!send_line(table->connections[h], text))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    if(length >= 5 && memcmp(line, "seat ", 5) == 0)
+    {
+        return 1;
+    }
+    if(length == 4 && memcmp(line, "turn", 4) == 0)
+    {
+        Move move = choose_bot_move(&conn->replayer.game, &client->bot, &conn->rng);
+        format_move(move, text);
+        return send_line(conn, text);
+    }
+    if(length >= 5 && (memcmp(line, "error", 5) == 0 || memcmp(line, "abandoned", 5) == 0))
+    {
+        printf("Table %d seat %d: %.*s\n", conn->table_idx, conn->seat_idx, length, line);
+        return 0;
+    }
+
+    long moves_before = conn->replay.moves;
+    conn->replay.lines++;
+    if(!notation_replay_line(&conn->replayer, line, line + length))
+    {
+        printf("Table %d seat %d: %s at \"%.*s\"\n", conn->table_idx, conn->seat_idx,
+               conn->replay.error, length, line);
+        return 0;
+    }
+    if(conn->seat_idx == 0)
+    {
+        client->moves += conn->replay.moves - moves_before;
+    }
+    if(length >= 3 && memcmp(line, "end", 3) == 0 && ++table->games_ended == client->no_of_humans)
+    {
+        client->games_done++;
+        return start_table_game(client, table);
+    }
+    return 1;
+}
+
+static int read_connection(Client* client, Client_connection* conn)
+{
+    ssize_t got = read(conn->fd, conn->input + conn->input_length, INPUT_SIZE - conn->input_length);
+    if(got == -1 && errno == EINTR)
+    {
+        return 1;
+    }
+    if(got <= 0)
+    {
+        printf("Table %d seat %d: the server closed the connection\n", conn->table_idx, conn->seat_idx);
+        return 0;
+    }
+    conn->input_length += got;
+
+    int start = 0;
+    for(;;)
+    {
+        char* newline = memchr(conn->input + start, '\n', conn->input_length - start);
+        if(newline == NULL)
+        {
+            break;
+        }
+        if(!handle_line(client, conn, conn->input + start, (int)(newline - conn->input - start)))
+        {
+            return 0;
+        }
+        start = (int)(newline + 1 - conn->input);
+    }
+    memmove(conn->input, conn->input + start, conn->input_length - start);
+    conn->input_length -= start;
+    return conn->input_length < INPUT_SIZE;
+}
+
+// Human seats of the layout, 0 if it is not one the server takes
+static int count_human_seats(const char* seats)
+{
+    int no_of_humans = 0, no_of_seats = 1;
+    for(const char* c = seats; *c != '\0'; c++)
+    {
+        no_of_seats += *c == ',';
+        no_of_humans += strncmp(c, "human", 5) == 0;
+    }
+    return no_of_seats >= 2 && no_of_seats <= MAX_PLAYERS ? no_of_humans : 0;
+}
+
+static void print_usage(const char* program)
+{
+    printf("Usage: %s --connect <address> [--games <n>] [--tables <n>] [--seats <seat,seat,...>]\n", program);
+    printf("       [--bot random|greedy] [--seed <n>]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char* address_text = NULL;
+    long no_of_games = 100;
+    int no_of_tables = 10;
+    uint64_t seed = 1;
+    Client client;
+    struct sockaddr_storage address;
+    socklen_t address_length;
+
+    memset(&client, 0, sizeof(client));
+    client.seats = "human,human";
+    default_bot(&client.bot, BOT_RANDOM);
+    for(int i = 1; i < argc; i++)
+    {
+        int has_value = i + 1 < argc;
+        if(has_value && strcmp(argv[i], "--connect") == 0)
+        {
+            address_text = argv[++i];
+        }
+        else if(has_value && strcmp(argv[i], "--games") == 0)
+        {
+            no_of_games = atol(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--tables") == 0)
+        {
+            no_of_tables = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--seats") == 0)
+        {
+            client.seats = argv[++i];
+        }
+        else if(has_value && strcmp(argv[i], "--bot") == 0)
+        {
+            int type = bot_type_from_name(argv[++i]);
+            if(type != BOT_RANDOM && type != BOT_GREEDY)
+            {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            default_bot(&client.bot, type);
+        }
+        else if(has_value && strcmp(argv[i], "--seed") == 0)
+        {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    client.no_of_humans = count_human_seats(client.seats);
+    if(address_text == NULL || !parse_server_address(address_text, &address, &address_length) ||
+       client.no_of_humans == 0 || no_of_games <= 0 || no_of_tables <= 0)
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(no_of_tables > no_of_games)
+    {
+        no_of_tables = (int)no_of_games;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    client.tables = calloc(no_of_tables, sizeof(Table));
+    if(epoll_fd == -1 || client.tables == NULL)
+    {
+        printf("Cannot start the client\n");
+        return EXIT_FAILURE;
+    }
+    for(int t = 0; t < no_of_tables; t++)
+    {
+        for(int h = 0; h < client.no_of_humans; h++)
+        {
+            Client_connection* conn = calloc(1, sizeof(Client_connection));
+            if(conn == NULL || (conn->fd = connect_to(&address, address_length)) == -1)
+            {
+                printf("Cannot connect to %s: %s\n", address_text, strerror(errno));
+                return EXIT_FAILURE;
+            }
+            conn->table_idx = t;
+            conn->seat_idx = h;
+            notation_start_replay(&conn->replayer, &conn->replay);
+            rng_seed(&conn->rng, derive_seed(seed, (uint64_t)t * MAX_PLAYERS + h));
+            client.tables[t].connections[h] = conn;
+
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = conn;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn->fd, &event);
+        }
+    }
+
+    double start = now_in_seconds();
+    client.games_to_start = no_of_games;
+    int ok = 1;
+    for(int t = 0; t < no_of_tables && ok; t++)
+    {
+        ok = start_table_game(&client, &client.tables[t]);
+    }
+    while(ok && client.games_done < no_of_games)
+    {
+        struct epoll_event events[MAX_EVENTS];
+        int no_of_events = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if(no_of_events == -1 && errno != EINTR)
+        {
+            break;
+        }
+        for(int i = 0; i < no_of_events && ok; i++)
+        {
+            ok = read_connection(&client, events[i].data.ptr);
+        }
+    }
+    double seconds = now_in_seconds() - start;
+
+    printf("%ld games checked, %ld moves in %.2fs (%.1f games/sec, %.0f moves/sec) over %d connections\n",
+           client.games_done, client.moves, seconds, seconds > 0 ? client.games_done / seconds : 0.0,
+           seconds > 0 ? client.moves / seconds : 0.0, no_of_tables * client.no_of_humans);
+    for(int t = 0; t < no_of_tables; t++)
+    {
+        for(int h = 0; h < client.no_of_humans; h++)
+        {
+            send_line(client.tables[t].connections[h], "quit");
+            close(client.tables[t].connections[h]->fd);
+            free(client.tables[t].connections[h]);
+        }
+    }
+    free(client.tables);
+    close(epoll_fd);
+    return ok && client.games_done == no_of_games ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,726 @@
+/*AZUL BOARD GAME - Training of the quantized network
+
+Trains the network of azul_net.h on self-play and writes it in the
+format net_load() reads:
+
+    gcc -O2 -pthread tools/azul_net_train.c azul_*.c -o azul_net_train -lm
+    ./azul_net_train --games 3000 --epochs 4 --out azul.net
+    ./Azul --net azul.net --seats expectimax,search
+
+Expectimax bots play --games games on every core. Every position before
+a move is a sample from each seat: the value target is that seat's final
+score lead minus evaluate_lead() with default_eval_weights. The last
+tenth of the games is held out: training keeps the epoch whose value
+error on them is lowest, and writes nothing if no epoch beats the error
+of no correction at all.
+
+A float network with the same shape and clipped ReLUs [0, 1] is fitted
+with Adam, then quantized layer by layer: the weights are scaled so the
+largest is 127, the multipliers bring the sums of the hidden layers back
+to 0-127. Inputs are normalised by their largest value during training,
+that factor is folded into the first layer's weights. The report
+compares the float and int8 networks on the held out games and times
+the kernels.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../azul_eval.h"
+#include "../azul_net.h"
+#include "../azul_pool.h"
+#include "../azul_selfplay.h"
+
+// Value targets are trained in units of VALUE_NORM points
+#define VALUE_NORM 20.0f
+#define VALIDATION_SHARE 10
+#define ADAM_BETA1 0.9f
+#define ADAM_BETA2 0.999f
+#define ADAM_EPSILON 1e-8f
+
+typedef struct
+{
+    uint8_t inputs[NET_INPUTS];
+    float target;          // final lead of the seat over evaluate_lead(), in points
+}Sample;
+
+typedef struct
+{
+    Sample* samples;
+    int count;
+}Game_samples;
+
+typedef struct
+{
+    int no_of_players;
+    uint64_t seed;
+    Bot bot;
+    Game_samples* games;
+}Generation;
+
+typedef struct
+{
+    int games;
+    int no_of_players;
+    int depth;
+    int samples;
+    int hidden1;
+    int hidden2;
+    int epochs;
+    int minibatch;
+    float rate;
+    int no_of_threads;
+    uint64_t seed;
+    const char* out_path;
+}Train_options;
+
+// Every parameter lives in one array, so are their gradients and moments
+typedef struct
+{
+    int hidden1;
+    int hidden2;
+    long size;
+    float* params;
+    float* w1;             // hidden1 x NET_INPUTS
+    float* b1;
+    float* w2;             // hidden2 x hidden1
+    float* b2;
+    float* wv;             // hidden2
+    float* bv;
+}Float_net;
+
+typedef struct
+{
+    float z1[NET_MAX_HIDDEN];
+    float a1[NET_MAX_HIDDEN];
+    float z2[NET_MAX_HIDDEN];
+    float a2[NET_MAX_HIDDEN];
+    float value;
+    int nonzero[NET_INPUTS];   // inputs that are not 0
+    float x[NET_INPUTS];       // their normalised values
+    int no_of_nonzero;
+}Activations;
+
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Self-play */
+
+static void generation_task(long task_idx, int worker_idx, void* arg)
+{
+    (void)worker_idx;
+    Generation* generation = arg;
+    Game_samples* out = &generation->games[task_idx];
+    int n = generation->no_of_players;
+    Sample* samples = malloc(sizeof(Sample) * MAX_GAME_MOVES * n);
+    int8_t* seats = malloc(MAX_GAME_MOVES * n);
+    Game info;
+    Rng bot_rng;
+    uint64_t game_seed = derive_seed(generation->seed, task_idx);
+    int count = 0;
+
+    out->samples = NULL;
+    out->count = 0;
+    if(samples == NULL || seats == NULL)
+    {
+        free(samples);
+        free(seats);
+        return;
+    }
+    memset(&info, 0, sizeof(info));
+    init_game(&info, n, game_seed);
+    rng_seed(&bot_rng, derive_seed(game_seed, 1));
+
+    int game_ended = 0;
+    while(!game_ended && info.flow.round_number < MAX_ROUNDS)
+    {
+        start_round(&info);
+        while(!is_round_over(&info))
+        {
+            Move move = choose_bot_move(&info, &generation->bot, &bot_rng);
+            // The searches evaluate from any seat, not only the one on move
+            for(int p = 0; p < n; p++, count++)
+            {
+                seats[count] = p;
+                net_encode(&info, p, samples[count].inputs);
+                samples[count].target = -(float)evaluate_lead(&info, p, &default_eval_weights);
+            }
+            apply_move(&info, move);
+        }
+        process_end_of_round(&info, NULL);
+        game_ended = check_game_end(&info);
+    }
+    calculate_final_bonuses(&info, NULL);
+
+    for(int i = 0; i < count; i++)
+    {
+        int best_other = -1000;
+        for(int p = 0; p < n; p++)
+        {
+            if(p != seats[i] && (int)info.players[p].mat.score > best_other)
+            {
+                best_other = info.players[p].mat.score;
+            }
+        }
+        samples[i].target += (float)((int)info.players[seats[i]].mat.score - best_other);
+    }
+    free(seats);
+    out->samples = samples;
+    out->count = count;
+}
+
+/* Float network */
+
+static int alloc_float_net(Float_net* net, int hidden1, int hidden2)
+{
+    long sizes[6] = {(long)hidden1 * NET_INPUTS, hidden1, (long)hidden2 * hidden1, hidden2, hidden2, 1};
+    float** parts[6] = {&net->w1, &net->b1, &net->w2, &net->b2, &net->wv, &net->bv};
+
+    net->hidden1 = hidden1;
+    net->hidden2 = hidden2;
+    net->size = 0;
+    for(int i = 0; i < 6; i++)
+    {
+        net->size += sizes[i];
+    }
+    net->params = calloc(net->size, sizeof(float));
+    if(net->params == NULL)
+    {
+        return 0;
+    }
+    float* at = net->params;
+    for(int i = 0; i < 6; i++)
+    {
+        *parts[i] = at;
+        at += sizes[i];
+    }
+    return 1;
+}
+
+// A view of `net`'s shape over other storage, for gradients
+static void view_float_net(const Float_net* net, Float_net* view, float* storage)
+{
+    *view = *net;
+    view->params = storage;
+    view->w1 = storage + (net->w1 - net->params);
+    view->b1 = storage + (net->b1 - net->params);
+    view->w2 = storage + (net->w2 - net->params);
+    view->b2 = storage + (net->b2 - net->params);
+    view->wv = storage + (net->wv - net->params);
+    view->bv = storage + (net->bv - net->params);
+}
+
+static float uniform(Rng* rng, float limit)
+{
+    return ((rng_next(rng) >> 40) / (float)(1 << 24) * 2.0f - 1.0f) * limit;
+}
+
+static void init_float_net(Float_net* net, Rng* rng)
+{
+    for(long i = 0; i < (long)net->hidden1 * NET_INPUTS; i++)
+    {
+        net->w1[i] = uniform(rng, 1.0f / sqrtf(NET_INPUTS_USED / 8.0f));
+    }
+    for(int o = 0; o < net->hidden1; o++)
+    {
+        net->b1[o] = 0.25f;
+    }
+    for(long i = 0; i < (long)net->hidden2 * net->hidden1; i++)
+    {
+        net->w2[i] = uniform(rng, 1.0f / sqrtf(net->hidden1));
+    }
+    for(int o = 0; o < net->hidden2; o++)
+    {
+        net->b2[o] = 0.25f;
+        net->wv[o] = uniform(rng, 1.0f / sqrtf(net->hidden2));
+    }
+}
+
+static float clipped_relu(float z)
+{
+    return z < 0 ? 0 : (z > 1 ? 1 : z);
+}
+
+static void forward(const Float_net* net, const float* input_scale, const Sample* sample, Activations* act)
+{
+    act->no_of_nonzero = 0;
+    for(int i = 0; i < NET_INPUTS; i++)
+    {
+        if(sample->inputs[i] != 0)
+        {
+            act->nonzero[act->no_of_nonzero] = i;
+            act->x[act->no_of_nonzero++] = sample->inputs[i] * input_scale[i];
+        }
+    }
+    for(int o = 0; o < net->hidden1; o++)
+    {
+        const float* row = net->w1 + (long)o * NET_INPUTS;
+        float z = net->b1[o];
+        for(int k = 0; k < act->no_of_nonzero; k++)
+        {
+            z += row[act->nonzero[k]] * act->x[k];
+        }
+        act->z1[o] = z;
+        act->a1[o] = clipped_relu(z);
+    }
+    for(int o = 0; o < net->hidden2; o++)
+    {
+        const float* row = net->w2 + (long)o * net->hidden1;
+        float z = net->b2[o];
+        for(int i = 0; i < net->hidden1; i++)
+        {
+            z += row[i] * act->a1[i];
+        }
+        act->z2[o] = z;
+        act->a2[o] = clipped_relu(z);
+    }
+    act->value = net->bv[0];
+    for(int i = 0; i < net->hidden2; i++)
+    {
+        act->value += net->wv[i] * act->a2[i];
+    }
+}
+
+// Adds the gradients of the sample's loss to `grad`, returns the loss
+static float backward(const Float_net* net, const Sample* sample, Activations* act, Float_net* grad)
+{
+    float d_a2[NET_MAX_HIDDEN] = {0};
+    float d_a1[NET_MAX_HIDDEN] = {0};
+    float error = act->value - sample->target / VALUE_NORM;
+    float d_value = 2 * error;
+
+    float loss = error * error;
+
+    grad->bv[0] += d_value;
+    for(int i = 0; i < net->hidden2; i++)
+    {
+        grad->wv[i] += d_value * act->a2[i];
+        d_a2[i] = d_value * net->wv[i];
+    }
+
+    for(int o = 0; o < net->hidden2; o++)
+    {
+        float d_z = act->z2[o] > 0 && act->z2[o] < 1 ? d_a2[o] : 0;
+        const float* row = net->w2 + (long)o * net->hidden1;
+        float* grad_row = grad->w2 + (long)o * net->hidden1;
+        if(d_z == 0)
+        {
+            continue;
+        }
+        grad->b2[o] += d_z;
+        for(int i = 0; i < net->hidden1; i++)
+        {
+            grad_row[i] += d_z * act->a1[i];
+            d_a1[i] += d_z * row[i];
+        }
+    }
+    for(int o = 0; o < net->hidden1; o++)
+    {
+        float d_z = act->z1[o] > 0 && act->z1[o] < 1 ? d_a1[o] : 0;
+        float* grad_row = grad->w1 + (long)o * NET_INPUTS;
+        if(d_z == 0)
+        {
+            continue;
+        }
+        grad->b1[o] += d_z;
+        for(int k = 0; k < act->no_of_nonzero; k++)
+        {
+            grad_row[act->nonzero[k]] += d_z * act->x[k];
+        }
+    }
+    return loss;
+}
+
+// Root mean square error of the value, in points
+static double value_error(const Float_net* net, const float* input_scale, const Sample* samples, long n)
+{
+    Activations act;
+    double error = 0;
+    for(long s = 0; s < n; s++)
+    {
+        forward(net, input_scale, &samples[s], &act);
+        error += (act.value * VALUE_NORM - samples[s].target) * (act.value * VALUE_NORM - samples[s].target);
+    }
+    return n > 0 ? sqrt(error / n) : 0;
+}
+
+// Error of the plain evaluate_lead(), what a network must beat
+static double no_correction_error(const Sample* samples, long n)
+{
+    double error = 0;
+    for(long s = 0; s < n; s++)
+    {
+        error += samples[s].target * samples[s].target;
+    }
+    return n > 0 ? sqrt(error / n) : 0;
+}
+
+static void adam_step(Float_net* net, const float* grad, float* m, float* v, long step, float rate, int minibatch)
+{
+    float correction1 = 1 - powf(ADAM_BETA1, step);
+    float correction2 = 1 - powf(ADAM_BETA2, step);
+    for(long i = 0; i < net->size; i++)
+    {
+        float g = grad[i] / minibatch;
+        m[i] = ADAM_BETA1 * m[i] + (1 - ADAM_BETA1) * g;
+        v[i] = ADAM_BETA2 * v[i] + (1 - ADAM_BETA2) * g * g;
+        net->params[i] -= rate * (m[i] / correction1) / (sqrtf(v[i] / correction2) + ADAM_EPSILON);
+    }
+}
+
+/* Quantization */
+
+static float largest_magnitude(const float* values, long n, const float* column_scale, int columns)
+{
+    float top = 0;
+    for(long i = 0; i < n; i++)
+    {
+        float value = fabsf(values[i] * (column_scale != NULL ? column_scale[i % columns] : 1.0f));
+        top = value > top ? value : top;
+    }
+    return top > 0 ? top : 1;
+}
+
+static int8_t quantize_weight(float value)
+{
+    long q = lroundf(value);
+    return q < -127 ? -127 : (q > 127 ? 127 : (int8_t)q);
+}
+
+// Weights times `scale`, biases times `bias_scale`; hidden layers get the
+// multiplier that maps a sum to 127 per 1.0 of activation
+static void quantize_layer(Net_layer* layer, const float* weights, const float* biases, const float* column_scale,
+                           float scale, float bias_scale, int is_head)
+{
+    for(int o = 0; o < layer->outputs; o++)
+    {
+        for(int i = 0; i < layer->inputs; i++)
+        {
+            float w = weights[(long)o * layer->inputs + i] * (column_scale != NULL ? column_scale[i] : 1.0f);
+            layer->weights[(long)o * layer->inputs + i] = quantize_weight(w * scale);
+        }
+        layer->biases[o] = (int32_t)lroundf(biases[o] * bias_scale);
+    }
+    if(!is_head)
+    {
+        // 1.0 of activation is bias_scale / 127 * 127 in the sums
+        layer->multiplier = (int32_t)lround(127.0 * (1 << NET_REQUANT_SHIFT) / bias_scale);
+        // Half an output step, so the shift rounds to the nearest value
+        for(int o = 0; o < layer->outputs && layer->multiplier > 0; o++)
+        {
+            layer->biases[o] += (1 << NET_REQUANT_SHIFT) / (2 * layer->multiplier);
+        }
+    }
+}
+
+static void quantize(const Float_net* source, const float* input_scale, Net* net)
+{
+    float s1 = 127 / largest_magnitude(source->w1, (long)source->hidden1 * NET_INPUTS, input_scale, NET_INPUTS);
+    float s2 = 127 / largest_magnitude(source->w2, (long)source->hidden2 * source->hidden1, NULL, 1);
+    float sv = 127 / largest_magnitude(source->wv, source->hidden2, NULL, 1);
+
+    // The inputs come in as they are, the activations as 127 per 1.0
+    quantize_layer(&net->hidden1, source->w1, source->b1, input_scale, s1, s1, 0);
+    quantize_layer(&net->hidden2, source->w2, source->b2, NULL, s2, s2 * 127, 0);
+    quantize_layer(&net->value, source->wv, source->bv, NULL, sv, sv * 127, 1);
+    net->value.scale = VALUE_NORM / (sv * 127);
+}
+
+/* Report */
+
+static void compare(const Float_net* source, const float* input_scale, Net* net, const Sample* samples, long n)
+{
+    _Alignas(NET_ALIGN) uint8_t inputs[NET_INPUTS];
+    Activations act;
+    double zero_error = 0, float_error = 0, int8_error = 0, difference = 0;
+
+    for(long s = 0; s < n; s++)
+    {
+        float value;
+        forward(source, input_scale, &samples[s], &act);
+        memcpy(inputs, samples[s].inputs, NET_INPUTS);
+        net_evaluate_batch(net, inputs, 1, &value);
+        float float_value = act.value * VALUE_NORM;
+        zero_error += samples[s].target * samples[s].target;
+        float_error += (float_value - samples[s].target) * (float_value - samples[s].target);
+        int8_error += (value - samples[s].target) * (value - samples[s].target);
+        difference += fabsf(value - float_value);
+    }
+    printf("held out: %ld positions\n", n);
+    printf("  value rms error   no correction %.2f  float %.2f  int8 %.2f points, mean |float - int8| %.3f\n",
+           sqrt(zero_error / n), sqrt(float_error / n), sqrt(int8_error / n), difference / n);
+}
+
+static void time_kernels(Net* net, const Sample* samples, long n)
+{
+    static const int batches[] = {1, 12, NET_MAX_BATCH};
+    static const char* const kernel_names[] = {"", "scalar", "avx2"};
+    long count = n < 4096 ? n : 4096;
+    uint8_t* inputs = aligned_alloc(NET_ALIGN, (size_t)count * NET_INPUTS);
+    float values[NET_MAX_BATCH];
+
+    if(inputs == NULL || count == 0)
+    {
+        free(inputs);
+        return;
+    }
+    for(long s = 0; s < count; s++)
+    {
+        memcpy(inputs + s * NET_INPUTS, samples[s].inputs, NET_INPUTS);
+    }
+    for(int kernels = NET_KERNELS_SCALAR; kernels <= NET_KERNELS_AVX2; kernels++)
+    {
+        if(!net_kernels_supported(kernels))
+        {
+            printf("  %-6s not supported here\n", kernel_names[kernels]);
+            continue;
+        }
+        net->kernels = kernels;
+        printf("  %-6s", kernel_names[kernels]);
+        for(size_t k = 0; k < sizeof(batches) / sizeof(batches[0]); k++)
+        {
+            long evaluated = 0;
+            double start = now_in_seconds();
+            for(int pass = 0; pass < 20; pass++)
+            {
+                for(long s = 0; s + batches[k] <= count; s += batches[k])
+                {
+                    net_evaluate_batch(net, inputs + s * NET_INPUTS, batches[k], values);
+                    evaluated += batches[k];
+                }
+            }
+            printf("  batch %2d: %6.0f ns/eval", batches[k], (now_in_seconds() - start) * 1e9 / evaluated);
+        }
+        printf("\n");
+    }
+    free(inputs);
+}
+
+static void print_usage(const char* program)
+{
+    printf("Usage: %s [--games <n>] [--players <n>] [--depth <n>] [--samples <n>] [--hidden1 <n>] [--hidden2 <n>]\n",
+           program);
+    printf("       [--epochs <n>] [--minibatch <n>] [--rate <r>] [--threads <n>] [--seed <n>] [--out <file>]\n");
+    printf("Hidden widths are multiples of %d up to %d.\n", NET_ALIGN, NET_MAX_HIDDEN);
+}
+
+int main(int argc, char* argv[])
+{
+    Train_options options = {3000, 2, 2, 2, 32, 32, 4, 64, 0.001f, 0, 1, "azul.net"};
+    for(int i = 1; i < argc; i++)
+    {
+        int has_value = i + 1 < argc;
+        if(has_value && strcmp(argv[i], "--games") == 0)
+        {
+            options.games = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--players") == 0)
+        {
+            options.no_of_players = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--depth") == 0)
+        {
+            options.depth = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--samples") == 0)
+        {
+            options.samples = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--hidden1") == 0)
+        {
+            options.hidden1 = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--hidden2") == 0)
+        {
+            options.hidden2 = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--epochs") == 0)
+        {
+            options.epochs = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--minibatch") == 0)
+        {
+            options.minibatch = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--rate") == 0)
+        {
+            options.rate = atof(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--threads") == 0)
+        {
+            options.no_of_threads = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--seed") == 0)
+        {
+            options.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if(has_value && strcmp(argv[i], "--out") == 0)
+        {
+            options.out_path = argv[++i];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    Net net;
+    if(options.games < VALIDATION_SHARE || options.no_of_players < 2 || options.no_of_players > MAX_PLAYERS ||
+       options.depth <= 0 || options.epochs <= 0 || options.minibatch <= 0 ||
+       !net_alloc(&net, options.hidden1, options.hidden2))
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Self-play
+    Generation generation;
+    generation.no_of_players = options.no_of_players;
+    generation.seed = options.seed;
+    default_bot(&generation.bot, BOT_EXPECTIMAX);
+    generation.bot.expectimax_depth = options.depth;
+    generation.bot.chance_samples = options.samples;
+    generation.games = calloc(options.games, sizeof(Game_samples));
+    if(generation.games == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    double start = now_in_seconds();
+    int no_of_threads = options.no_of_threads > 0 ? options.no_of_threads : online_core_count();
+    run_parallel_tasks(options.games, no_of_threads, generation_task, &generation);
+
+    int training_games = options.games - options.games / VALIDATION_SHARE;
+    long no_of_samples = 0, no_of_training = 0;
+    for(int g = 0; g < options.games; g++)
+    {
+        no_of_samples += generation.games[g].count;
+        no_of_training += g < training_games ? generation.games[g].count : 0;
+    }
+    Sample* samples = malloc(sizeof(Sample) * (no_of_samples > 0 ? no_of_samples : 1));
+    if(samples == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    long at = 0;
+    for(int g = 0; g < options.games; g++)
+    {
+        memcpy(samples + at, generation.games[g].samples, sizeof(Sample) * generation.games[g].count);
+        at += generation.games[g].count;
+        free(generation.games[g].samples);
+    }
+    free(generation.games);
+    printf("%d games, %ld positions (%.0fs)\n", options.games, no_of_samples, now_in_seconds() - start);
+
+    // Inputs are normalised by the largest value they take
+    float input_scale[NET_INPUTS];
+    for(int i = 0; i < NET_INPUTS; i++)
+    {
+        int top = 1;
+        for(long s = 0; s < no_of_training; s++)
+        {
+            top = samples[s].inputs[i] > top ? samples[s].inputs[i] : top;
+        }
+        input_scale[i] = 1.0f / top;
+    }
+
+    // Training
+    Float_net model, grad;
+    Rng rng;
+    rng_seed(&rng, derive_seed(options.seed, 0));
+    long* order = malloc(sizeof(long) * (no_of_training > 0 ? no_of_training : 1));
+    if(order == NULL || !alloc_float_net(&model, options.hidden1, options.hidden2))
+    {
+        return EXIT_FAILURE;
+    }
+    float* grad_storage = calloc(model.size, sizeof(float));
+    float* m = calloc(model.size, sizeof(float));
+    float* v = calloc(model.size, sizeof(float));
+    float* best = malloc(sizeof(float) * model.size);
+    if(grad_storage == NULL || m == NULL || v == NULL || best == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    view_float_net(&model, &grad, grad_storage);
+    init_float_net(&model, &rng);
+    for(long s = 0; s < no_of_training; s++)
+    {
+        order[s] = s;
+    }
+
+    Activations act;
+    long step = 0;
+    const Sample* held_out = samples + no_of_training;
+    long no_of_held_out = no_of_samples - no_of_training;
+    // An epoch is kept only if it corrects evaluate_lead() for the better
+    double zero_error = no_correction_error(held_out, no_of_held_out);
+    double best_error = zero_error;
+    int best_epoch = 0;
+    for(int epoch = 0; epoch < options.epochs; epoch++)
+    {
+        for(long s = no_of_training - 1; s > 0; s--)
+        {
+            long j = rng_below(&rng, s + 1);
+            long swap = order[s];
+            order[s] = order[j];
+            order[j] = swap;
+        }
+        double loss = 0;
+        for(long first = 0; first < no_of_training; first += options.minibatch)
+        {
+            long last = first + options.minibatch < no_of_training ? first + options.minibatch : no_of_training;
+            memset(grad_storage, 0, sizeof(float) * model.size);
+            for(long s = first; s < last; s++)
+            {
+                forward(&model, input_scale, &samples[order[s]], &act);
+                loss += backward(&model, &samples[order[s]], &act, &grad);
+            }
+            adam_step(&model, grad_storage, m, v, ++step, options.rate, last - first);
+        }
+        double error = value_error(&model, input_scale, held_out, no_of_held_out);
+        printf("epoch %d: loss %.4f, held out value error %.2f (%.0fs)\n", epoch + 1, loss / no_of_training, error,
+               now_in_seconds() - start);
+        fflush(stdout);
+        if(error < best_error)
+        {
+            best_error = error;
+            best_epoch = epoch + 1;
+            memcpy(best, model.params, sizeof(float) * model.size);
+        }
+    }
+    if(best_epoch == 0)
+    {
+        printf("no epoch beats no correction (held out value error %.2f), %s not written\n", zero_error,
+               options.out_path);
+        return EXIT_FAILURE;
+    }
+    // The epoch that did best on the held out games is kept
+    memcpy(model.params, best, sizeof(float) * model.size);
+    printf("kept epoch %d\n", best_epoch);
+
+    quantize(&model, input_scale, &net);
+    if(!net_save(&net, options.out_path))
+    {
+        printf("Cannot write %s\n", options.out_path);
+        return EXIT_FAILURE;
+    }
+    printf("wrote %s\n", options.out_path);
+    compare(&model, input_scale, &net, held_out, no_of_held_out);
+    time_kernels(&net, held_out, no_of_held_out);
+
+    net_free(&net);
+    free(model.params);
+    free(grad_storage);
+    free(m);
+    free(v);
+    free(best);
+    free(order);
+    free(samples);
+    return 0;
+}
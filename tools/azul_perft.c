@@ -0,0 +1,398 @@
+/*AZUL BOARD GAME - Move path counter (perft)
+
+Counts every legal move sequence from a position, to a fixed depth or to
+the end of the round. A sequence that ends the round early counts as one
+path. The root moves are spread over a thread pool and the counts below
+a position are cached in a lock-free table keyed by Game.hash and the
+depth left, so positions reached by several orders of moves are counted
+once. The counts check the move generator; the time measures it.
+
+    gcc -O2 -pthread tools/azul_perft.c azul_*.c -o azul_perft -lm
+    ./azul_perft --players 2 --seed 1 --depth 4 [--moves "F1 blue L1,M red floor"]
+    ./azul_perft --check tools/perft_fixtures.txt
+
+A depth of 0 counts to the end of the round. --moves plays moves in game
+notation (see azul_notation.h) after the round is set up; --divide prints
+the count below every root move; --no-hash counts without the cache.
+Fixture lines are "<players> <seed> <depth> <count> [<move>,<move>,...]".
+--check also sends every position it counts through Packed_game
+(azul_packed.h): unpacked, it must have the same hash, pack to the same
+bytes and have the same legal moves.
+*/
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../azul_notation.h"
+#include "../azul_packed.h"
+#include "../azul_pool.h"
+#include "../azul_rules.h"
+
+#define TO_ROUND_END 0xFF
+#define DEFAULT_HASH_MB 256
+
+typedef struct
+{
+    _Atomic uint64_t key_xor_count;
+    _Atomic uint64_t count;
+}Perft_slot;
+
+typedef struct
+{
+    Perft_slot* slots;           // NULL counts without a cache
+    size_t mask;
+}Perft_cache;
+
+typedef struct
+{
+    const Game* root;
+    Move root_moves[MAX_LEGAL_MOVES];
+    uint64_t counts[MAX_LEGAL_MOVES];
+    int depth;                   // below the root moves, TO_ROUND_END for all
+    Perft_cache cache;
+    int check_packing;
+    _Atomic long packing_failures;
+}Perft;
+
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cache_init(Perft_cache* cache, size_t size_in_mb)
+{
+    size_t no_of_slots = 1;
+    while(no_of_slots * 2 * sizeof(Perft_slot) <= size_in_mb * 1024 * 1024)
+    {
+        no_of_slots *= 2;
+    }
+    cache->slots = calloc(no_of_slots, sizeof(Perft_slot));
+    cache->mask = no_of_slots - 1;
+    return cache->slots != NULL;
+}
+
+static uint64_t cache_key(uint64_t hash, int depth)
+{
+    return hash ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(depth + 1));
+}
+
+// A slot torn by two writers no longer matches its key and reads as a miss
+static int cache_probe(const Perft_cache* cache, uint64_t key, uint64_t* count)
+{
+    Perft_slot* slot = &cache->slots[key & cache->mask];
+    uint64_t stored = atomic_load_explicit(&slot->count, memory_order_relaxed);
+    uint64_t check = atomic_load_explicit(&slot->key_xor_count, memory_order_relaxed);
+    if((check ^ stored) != key || stored == 0)
+    {
+        return 0;
+    }
+    *count = stored;
+    return 1;
+}
+
+static void cache_store(const Perft_cache* cache, uint64_t key, uint64_t count)
+{
+    Perft_slot* slot = &cache->slots[key & cache->mask];
+    atomic_store_explicit(&slot->key_xor_count, key ^ count, memory_order_relaxed);
+    atomic_store_explicit(&slot->count, count, memory_order_relaxed);
+}
+
+// Returns 1 if `info` comes back from pack_game() and unpack_game() as
+// the same position
+static int packs_back(const Game* info)
+{
+    Packed_game packed, repacked;
+    Move moves[MAX_LEGAL_MOVES], unpacked_moves[MAX_LEGAL_MOVES];
+    Game unpacked = *info;
+
+    pack_game(info, &packed);
+    unpack_game(&packed, &unpacked);
+    pack_game(&unpacked, &repacked);
+    int no_of_moves = is_round_over(info) ? 0 : generate_legal_moves(info, moves);
+    int no_of_unpacked_moves = is_round_over(&unpacked) ? 0 : generate_legal_moves(&unpacked, unpacked_moves);
+    return unpacked.hash == info->hash && memcmp(&packed, &repacked, sizeof(packed)) == 0 &&
+           no_of_unpacked_moves == no_of_moves && memcmp(moves, unpacked_moves, sizeof(Move) * no_of_moves) == 0;
+}
+
+static uint64_t perft(Game* info, int depth, Perft* run)
+{
+    Move moves[MAX_LEGAL_MOVES];
+    Undo_record undo;
+    const Perft_cache* cache = &run->cache;
+
+    if(run->check_packing && !packs_back(info))
+    {
+        atomic_fetch_add_explicit(&run->packing_failures, 1, memory_order_relaxed);
+    }
+    if(depth == 0 || is_round_over(info))
+    {
+        return 1;
+    }
+    int no_of_moves = generate_legal_moves(info, moves);
+    if(depth == 1)
+    {
+        return no_of_moves;
+    }
+
+    uint64_t key = cache_key(info->hash, depth);
+    uint64_t count = 0;
+    if(cache->slots != NULL && cache_probe(cache, key, &count))
+    {
+        return count;
+    }
+    int next_depth = depth == TO_ROUND_END ? TO_ROUND_END : depth - 1;
+    for(int i = 0; i < no_of_moves; i++)
+    {
+        apply_move_with_undo(info, moves[i], &undo);
+        count += perft(info, next_depth, run);
+        undo_move(info, &undo);
+    }
+    if(cache->slots != NULL)
+    {
+        cache_store(cache, key, count);
+    }
+    return count;
+}
+
+static void perft_task(long task_idx, int worker_idx, void* arg)
+{
+    Perft* run = arg;
+    Game info = *run->root;
+    (void)worker_idx;
+
+    apply_move(&info, run->root_moves[task_idx]);
+    run->counts[task_idx] = perft(&info, run->depth, run);
+}
+
+// Counts the paths of `depth` moves (0 = to the end of the round), with
+// `divide` the count below every root move is printed as well. Unless
+// `packing_failures` is NULL it gets the positions that did not come back
+// the same through Packed_game.
+static uint64_t run_perft(const Game* info, int depth, int no_of_threads, size_t hash_mb,
+                          int divide, long* packing_failures, double* seconds)
+{
+    Perft* run = malloc(sizeof(Perft));
+    if(run == NULL)
+    {
+        return 0;
+    }
+    run->root = info;
+    run->depth = depth == 0 ? TO_ROUND_END : depth - 1;
+    run->cache.slots = NULL;
+    run->check_packing = packing_failures != NULL;
+    atomic_init(&run->packing_failures, 0);
+    if(run->check_packing && !packs_back(info))
+    {
+        atomic_fetch_add_explicit(&run->packing_failures, 1, memory_order_relaxed);
+    }
+    if(hash_mb > 0 && !cache_init(&run->cache, hash_mb))
+    {
+        printf("Not enough memory for a %zu MB cache, counting without it\n", hash_mb);
+    }
+
+    double start = now_in_seconds();
+    int no_of_moves = is_round_over(info) ? 0 : generate_legal_moves(info, run->root_moves);
+    run_parallel_tasks(no_of_moves, no_of_threads, perft_task, run);
+    *seconds = now_in_seconds() - start;
+
+    uint64_t total = no_of_moves == 0 ? 1 : 0;
+    for(int i = 0; i < no_of_moves; i++)
+    {
+        total += run->counts[i];
+        if(divide)
+        {
+            char text[MAX_MOVE_TEXT];
+            format_move(run->root_moves[i], text);
+            printf("  %-16s %llu\n", text, (unsigned long long)run->counts[i]);
+        }
+    }
+    if(packing_failures != NULL)
+    {
+        *packing_failures = atomic_load(&run->packing_failures);
+    }
+    free(run->cache.slots);
+    free(run);
+    return total;
+}
+
+// Starts the first round of a game and plays the comma separated moves
+static int set_up_position(Game* info, int no_of_players, uint64_t seed, char* moves)
+{
+    memset(info, 0, sizeof(*info));
+    init_game(info, no_of_players, seed);
+    start_round(info);
+    if(moves == NULL)
+    {
+        return 1;
+    }
+    for(char* text = strtok(moves, ","); text != NULL; text = strtok(NULL, ","))
+    {
+        Move move;
+        while(*text == ' ')
+        {
+            text++;
+        }
+        if(!parse_move(text, (int)strlen(text), &move) || !apply_move(info, move))
+        {
+            printf("Not a legal move here: %s\n", text);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Runs every line of a fixture file, returns the number of wrong counts
+static int check_fixtures(const char* path, int no_of_threads, size_t hash_mb)
+{
+    FILE* in = fopen(path, "r");
+    char line[256];
+    int failures = 0, checked = 0;
+
+    if(in == NULL)
+    {
+        printf("Cannot read %s\n", path);
+        return 1;
+    }
+    while(fgets(line, sizeof(line), in) != NULL)
+    {
+        int no_of_players, depth, used;
+        unsigned long long seed, expected;
+        double seconds;
+        Game info;
+
+        if(line[0] == '#' || sscanf(line, "%d %llu %d %llu%n", &no_of_players, &seed, &depth, &expected, &used) != 4)
+        {
+            continue;
+        }
+        // The rest of the line, if any, are the moves to play first
+        char* moves = line + used;
+        moves[strcspn(moves, "\r\n")] = '\0';
+        while(*moves == ' ')
+        {
+            moves++;
+        }
+        if(no_of_players < 2 || no_of_players > MAX_PLAYERS ||
+           !set_up_position(&info, no_of_players, seed, *moves != '\0' ? moves : NULL))
+        {
+            printf("Bad fixture: %s\n", line);
+            failures++;
+            continue;
+        }
+        long packing_failures;
+        uint64_t count = run_perft(&info, depth, no_of_threads, hash_mb, 0, &packing_failures, &seconds);
+        checked++;
+        printf("%s players %d seed %llu depth %d: %llu (%.2fs)\n",
+               count == expected && packing_failures == 0 ? "ok  " : "FAIL", no_of_players, seed, depth,
+               (unsigned long long)count, seconds);
+        if(count != expected)
+        {
+            printf("     expected %llu\n", expected);
+        }
+        if(packing_failures > 0)
+        {
+            printf("     %ld positions did not come back the same from Packed_game\n", packing_failures);
+        }
+        failures += count != expected || packing_failures > 0;
+    }
+    fclose(in);
+    printf("%d of %d fixtures passed\n", checked - failures, checked);
+    return failures;
+}
+
+static void print_usage(const char* program)
+{
+    printf("Usage: %s [--players <2-4>] [--seed <n>] [--depth <n>] [--moves <move,move,...>]\n", program);
+    printf("       [--threads <n>] [--hash-mb <n>] [--no-hash] [--divide] [--check <fixtures>]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int no_of_players = 2, depth = 3, no_of_threads = 0, divide = 0;
+    uint64_t seed = 1;
+    size_t hash_mb = DEFAULT_HASH_MB;
+    char* moves = NULL;
+    const char* fixtures = NULL;
+
+    for(int i = 1; i < argc; i++)
+    {
+        int has_value = i + 1 < argc;
+        if(strcmp(argv[i], "--divide") == 0)
+        {
+            divide = 1;
+        }
+        else if(strcmp(argv[i], "--no-hash") == 0)
+        {
+            hash_mb = 0;
+        }
+        else if(has_value && strcmp(argv[i], "--players") == 0)
+        {
+            no_of_players = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--seed") == 0)
+        {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if(has_value && strcmp(argv[i], "--depth") == 0)
+        {
+            depth = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--moves") == 0)
+        {
+            moves = argv[++i];
+        }
+        else if(has_value && strcmp(argv[i], "--threads") == 0)
+        {
+            no_of_threads = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--hash-mb") == 0)
+        {
+            hash_mb = strtoul(argv[++i], NULL, 10);
+        }
+        else if(has_value && strcmp(argv[i], "--check") == 0)
+        {
+            fixtures = argv[++i];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(no_of_threads <= 0)
+    {
+        no_of_threads = online_core_count();
+    }
+    if(fixtures != NULL)
+    {
+        return check_fixtures(fixtures, no_of_threads, hash_mb) == 0 ? 0 : EXIT_FAILURE;
+    }
+    if(no_of_players < 2 || no_of_players > MAX_PLAYERS || depth < 0 || depth >= TO_ROUND_END)
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Game info;
+    double seconds;
+    if(!set_up_position(&info, no_of_players, seed, moves))
+    {
+        return EXIT_FAILURE;
+    }
+    uint64_t count = run_perft(&info, depth, no_of_threads, hash_mb, divide, NULL, &seconds);
+    if(depth == 0)
+    {
+        printf("perft to the end of the round");
+    }
+    else
+    {
+        printf("perft depth %d", depth);
+    }
+    printf(": %llu paths in %.3fs (%.0f paths/sec)\n", (unsigned long long)count, seconds,
+           seconds > 0 ? count / seconds : 0.0);
+    return 0;
+}
@@ -0,0 +1,235 @@
+/*AZUL BOARD GAME - SPSA tuning of the evaluation weights
+
+Tunes the weights of azul_eval.h by self-play, with simultaneous
+perturbation stochastic approximation: every iteration moves all the
+weights at once by +c or -c (a random sign each), plays expectimax bots
+with the two weight sets against each other, and steps the weights
+along the gradient that the score difference of those games estimates.
+
+    gcc -O2 -pthread tools/azul_tune.c azul_*.c -o azul_tune -lm
+    ./azul_tune --iterations 200 --pairs 32 --out weights.txt
+    ./Azul --weights weights.txt --seats expectimax,search
+
+Each pair is one fill seed played twice with the seats swapped, so the
+luck of the draw cancels out; the games of an iteration run on every
+core. Steps shrink as a_k = a / (k + 1 + A)^0.602 and perturbations as
+c_k = c / (k + 1)^0.101. The weights are written to --out after every
+report, an interrupted run keeps what it learned.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../azul_eval.h"
+#include "../azul_pool.h"
+#include "../azul_selfplay.h"
+
+#define MIN_WEIGHT 0.0
+#define MAX_WEIGHT 4.0
+
+typedef struct
+{
+    Selfplay_config plus_first;    // seat 1 plays the + weights
+    Selfplay_config minus_first;   // the same games with the seats swapped
+    double* leads;                 // of the + weights, one per game
+}Tune_iteration;
+
+typedef struct
+{
+    int iterations;
+    int pairs;
+    int depth;
+    int samples;
+    int no_of_threads;
+    int report_every;
+    double a;
+    double c;
+    uint64_t seed;
+    const char* start_path;
+    const char* out_path;
+}Tune_options;
+
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void tune_task(long task_idx, int worker_idx, void* arg)
+{
+    (void)worker_idx;
+    Tune_iteration* iteration = arg;
+    int swapped = task_idx & 1;
+    const Selfplay_config* config = swapped ? &iteration->minus_first : &iteration->plus_first;
+    Game_result result;
+    long moves;
+
+    play_selfplay_game(config, task_idx / 2, &result, NULL, &moves);
+    int plus_seat = swapped ? 1 : 0;
+    iteration->leads[task_idx] = (double)result.scores[plus_seat] - (double)result.scores[1 - plus_seat];
+}
+
+static void init_seat(Bot* bot, const Tune_options* options, const Eval_weights* weights)
+{
+    default_bot(bot, BOT_EXPECTIMAX);
+    bot->expectimax_depth = options->depth;
+    bot->chance_samples = options->samples;
+    bot->eval_weights = weights;
+}
+
+static void print_weights(const char* label, const Eval_weights* weights)
+{
+    printf("%s", label);
+    for(int i = 0; i < NO_OF_EVAL_FEATURES; i++)
+    {
+        printf(" %s=%.3f", eval_feature_name(i), weights->weights[i]);
+    }
+    printf("\n");
+}
+
+static void print_usage(const char* program)
+{
+    printf("Usage: %s [--iterations <n>] [--pairs <n>] [--depth <n>] [--samples <n>] [--threads <n>]\n", program);
+    printf("       [--a <step>] [--c <perturbation>] [--seed <n>] [--start <weights>] [--out <weights>]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    Tune_options options = {200, 32, 2, 2, 0, 10, 0.002, 0.1, 1, NULL, "weights.txt"};
+    for(int i = 1; i < argc; i++)
+    {
+        int has_value = i + 1 < argc;
+        if(has_value && strcmp(argv[i], "--iterations") == 0)
+        {
+            options.iterations = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--pairs") == 0)
+        {
+            options.pairs = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--depth") == 0)
+        {
+            options.depth = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--samples") == 0)
+        {
+            options.samples = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--threads") == 0)
+        {
+            options.no_of_threads = atoi(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--a") == 0)
+        {
+            options.a = atof(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--c") == 0)
+        {
+            options.c = atof(argv[++i]);
+        }
+        else if(has_value && strcmp(argv[i], "--seed") == 0)
+        {
+            options.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if(has_value && strcmp(argv[i], "--start") == 0)
+        {
+            options.start_path = argv[++i];
+        }
+        else if(has_value && strcmp(argv[i], "--out") == 0)
+        {
+            options.out_path = argv[++i];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(options.iterations <= 0 || options.pairs <= 0 || options.depth <= 0)
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Eval_weights theta = default_eval_weights;
+    if(options.start_path != NULL && !load_eval_weights(options.start_path, &theta))
+    {
+        printf("Cannot read %s\n", options.start_path);
+        return EXIT_FAILURE;
+    }
+    int no_of_threads = options.no_of_threads > 0 ? options.no_of_threads : online_core_count();
+    long no_of_games = 2L * options.pairs;
+    double* leads = malloc(sizeof(double) * no_of_games);
+    if(leads == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    Rng rng;
+    rng_seed(&rng, derive_seed(options.seed, 0));
+    double stability = options.iterations / 10.0;
+    double start = now_in_seconds();
+    print_weights("start", &theta);
+
+    for(int k = 0; k < options.iterations; k++)
+    {
+        double a_k = options.a / pow(k + 1 + stability, 0.602);
+        double c_k = options.c / pow(k + 1, 0.101);
+        double delta[NO_OF_EVAL_FEATURES];
+        Eval_weights plus = theta, minus = theta;
+        for(int i = 0; i < NO_OF_EVAL_FEATURES; i++)
+        {
+            delta[i] = rng_below(&rng, 2) ? 1.0 : -1.0;
+            plus.weights[i] += c_k * delta[i];
+            minus.weights[i] -= c_k * delta[i];
+        }
+
+        Tune_iteration iteration;
+        memset(&iteration, 0, sizeof(iteration));
+        iteration.plus_first.no_of_players = 2;
+        iteration.plus_first.seed = derive_seed(options.seed, k + 1);
+        init_seat(&iteration.plus_first.seats[0], &options, &plus);
+        init_seat(&iteration.plus_first.seats[1], &options, &minus);
+        iteration.minus_first = iteration.plus_first;
+        iteration.minus_first.seats[0] = iteration.plus_first.seats[1];
+        iteration.minus_first.seats[1] = iteration.plus_first.seats[0];
+        iteration.leads = leads;
+        run_parallel_tasks(no_of_games, no_of_threads, tune_task, &iteration);
+
+        double lead = 0;
+        for(long g = 0; g < no_of_games; g++)
+        {
+            lead += leads[g];
+        }
+        lead /= no_of_games;
+
+        // The + and - sets play each other, the lead is f(+) - f(-)
+        for(int i = 0; i < NO_OF_EVAL_FEATURES; i++)
+        {
+            double gradient = lead / (2.0 * c_k * delta[i]);
+            double weight = theta.weights[i] + a_k * gradient;
+            theta.weights[i] = weight < MIN_WEIGHT ? MIN_WEIGHT : (weight > MAX_WEIGHT ? MAX_WEIGHT : weight);
+        }
+
+        if((k + 1) % options.report_every == 0 || k + 1 == options.iterations)
+        {
+            char label[32];
+            snprintf(label, sizeof(label), "%d (%.0fs)", k + 1, now_in_seconds() - start);
+            print_weights(label, &theta);
+            fflush(stdout);
+            if(!save_eval_weights(options.out_path, &theta))
+            {
+                printf("Cannot write %s\n", options.out_path);
+                free(leads);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    free(leads);
+    return 0;
+}